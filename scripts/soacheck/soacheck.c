@@ -0,0 +1,131 @@
+/*subfile:  soacheck.c  ******************************************************/
+/*                                                                           */
+/*  Check that View2AIsoa() agrees with the scalar View2AI() to round-off    */
+/*  for a few fixed surface pairs and every nDiv of SubSrf().  Also times    */
+/*  the two kernels.  See README.md to build and run it.                     */
+/*                                                                           */
+/*  The exit code is 1 if any pair differs by more than 1e-5 * area, the     */
+/*  tolerance of SoaCheck() in DEBUG builds of View3D.                       */
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <math.h>  /* prototypes: fabs, sqrt */
+#include <time.h>  /* prototype: clock */
+#include "types.h"
+#include "view3d.h"
+#include "prtyp.h"
+
+/* globals of v3main.c used by the View3D functions */
+FILE *_unxt; /* input file */
+FILE *_ulog; /* log file */
+IX _echo=0;  /* true = echo input file */
+IX _list=0;  /* output control */
+I1 _string[LINELEN];  /* buffer for a character string */
+I1 *methods[9]={"2AI","1AI","2LI","1LI","ALI","RCT","EXA","Adapt","Blocked"};
+
+#define NPAIR 4
+#define NREP 200000  /* repetitions for timing */
+
+typedef struct testsrf   /* surface of a test pair */
+  {
+  IX nv;           /* number of vertices: 3 or 4 */
+  VERTEX3D v[4];   /* vertices, counterclockwise seen from the front */
+  } TESTSRF;
+
+static const TESTSRF pairs[NPAIR][2] = {
+  { { 4, { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0} } },     /* parallel squares */
+    { 4, { {0,0,1}, {0,1,1}, {1,1,1}, {1,0,1} } } },
+  { { 4, { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0} } },     /* perpendicular */
+    { 4, { {0,0,0.1f}, {0,0,1.1f}, {1,0,1.1f}, {1,0,0.1f} } } },
+  { { 3, { {0,0,0}, {2,0,0}, {0,1,0} } },              /* tilted triangle */
+    { 4, { {0.5f,-0.5f,0.5f}, {0.5f,1.5f,0.5f},       /* and parallelogram */
+           {1.5f,1.5f,1.2f}, {1.5f,-0.5f,1.2f} } } },
+  { { 3, { {0,0,0}, {0.1f,0,0}, {0,0.1f,0} } },        /* distant triangles */
+    { 3, { {5,5,4}, {5,5.1f,4}, {5.1f,5,4} } } } };
+
+/***  SetSrf.c  **************************************************************/
+
+/*  Set direction cosines DC and return area of test surface S.  */
+
+R4 SetSrf( const TESTSRF *s, DIRCOS *dc )
+  {
+  VECTOR3D a, b, c;
+  R8 len;
+
+  VECTOR( (s->v+0), (s->v+1), (&a) );
+  VECTOR( (s->v+0), (s->v+s->nv-1), (&b) );
+  VCROSS( (&a), (&b), (&c) );
+  len = VLEN( (&c) );
+  dc->x = (R4)(c.x / len);
+  dc->y = (R4)(c.y / len);
+  dc->z = (R4)(c.z / len);
+  dc->w = -VDOT( dc, s->v );
+
+  return (R4)( s->nv == 3 ? 0.5 * len : len );  /* triangle or parallelogram */
+
+  }  /* end SetSrf */
+
+/***  main.c  ****************************************************************/
+
+int main( void )
+  {
+  VERTEX3D pt1[16], pt2[16];
+  R4 wt1[16], wt2[16];
+  R8 x2[16], y2[16], z2[16], w2[16];
+  DIRCOS dc1, dc2;
+  R4 area1, area2;
+  R8 AF, AFs, d, dMax=0.0;
+  IX n, nDiv, n1, n2, ns, k;
+  IX fail=0;
+  clock_t t0;
+  R8 tScalar=0.0, tSoa=0.0;
+
+  _ulog = stderr;
+  printf( "pair nDiv       View2AI    View2AIsoa  |diff|/area\n" );
+  for( n=0; n<NPAIR; n++ )
+    {
+    area1 = SetSrf( &pairs[n][0], &dc1 );
+    area2 = SetSrf( &pairs[n][1], &dc2 );
+    for( nDiv=1; nDiv<=4; nDiv++ )
+      {
+      n1 = SubSrf( nDiv, pairs[n][0].nv, pairs[n][0].v, area1, pt1, wt1 );
+      n2 = SubSrf( nDiv, pairs[n][1].nv, pairs[n][1].v, area2, pt2, wt2 );
+      ns = PointsSoa( n2, pt2, wt2, x2, y2, z2, w2 );
+      AFs = View2AI( n1, &dc1, pt1, wt1, n2, &dc2, pt2, wt2 );
+      AF = View2AIsoa( n1, &dc1, pt1, wt1, ns, &dc2, x2, y2, z2, w2 );
+      d = fabs(AF - AFs) / area1;
+      if( d > dMax ) dMax = d;
+      if( d > 1.0e-5 ) fail = 1;
+      printf( "%4d %4d %13.8g %13.8g %12.3g\n", n+1, nDiv, AFs, AF, d );
+      }
+    }
+
+  area1 = SetSrf( &pairs[0][0], &dc1 );   /* time parallel squares */
+  area2 = SetSrf( &pairs[0][1], &dc2 );
+  n1 = SubSrf( 4, pairs[0][0].nv, pairs[0][0].v, area1, pt1, wt1 );
+  n2 = SubSrf( 4, pairs[0][1].nv, pairs[0][1].v, area2, pt2, wt2 );
+  ns = PointsSoa( n2, pt2, wt2, x2, y2, z2, w2 );
+  AF = AFs = 0.0;
+  t0 = clock();
+  for( k=0; k<NREP; k++ )
+    {
+    pt1[0].x = (R4)(k & 1) * 1.0e-3f;   /* keep calls from being merged */
+    AFs += View2AI( n1, &dc1, pt1, wt1, n2, &dc2, pt2, wt2 );
+    }
+  tScalar = (R8)(clock() - t0) / CLOCKS_PER_SEC;
+  t0 = clock();
+  for( k=0; k<NREP; k++ )
+    {
+    pt1[0].x = (R4)(k & 1) * 1.0e-3f;
+    AF += View2AIsoa( n1, &dc1, pt1, wt1, ns, &dc2, x2, y2, z2, w2 );
+    }
+  tSoa = (R8)(clock() - t0) / CLOCKS_PER_SEC;
+
+  printf( "max |diff|/area %.3g: %s\n", dMax, fail ? "FAILED" : "passed" );
+  printf( "%d calls with 16 x 16 points:  View2AI %.3f s,  View2AIsoa %.3f s"
+    "  (sums %g %g)\n", NREP, tScalar, tSoa, AFs, AF );
+
+  return fail;
+
+  }  /* end main */
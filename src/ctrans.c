@@ -309,6 +309,99 @@ void CoordTrans3D( SRFDAT3D *srf, SRFDATNM *srf1, SRFDATNM *srf2,
 
   }  /*  end of CoordTrans3D  */
 
+/***  MergeObstr.c  **********************************************************/
+
+/*  Merge coplanar obstructions which share an edge into single convex 
+ *  obstructions.  This reduces the number of shadow polygons projected by 
+ *  ViewObsPoint() without changing the shaded area.  Surfaces are merged
+ *  only if they face the same way, the union is convex, and it has at 
+ *  most MAXNV1 vertices.  Return the new number of obstructions.  */
+
+IX MergeObstr( VFCTRL *vfCtrl )
+  {
+  SRFDAT3X *srfOT=vfCtrl->srfOT;  /* transformed obstructions */
+  VERTEX3D v[2*MAXNV1];  /* vertices of union */
+  VECTOR3D e0, e1, c;    /* vectors */
+  R4 len, dot, eps;
+  IX nObs=vfCtrl->nProbObstr;  /* number of obstructions */
+  IX merged;  /* true if a merge was made in this pass */
+  IX i, j, k, n, ia, ib, nv, sign;
+
+  do{
+    merged = 0;
+    for( i=0; i<nObs; i++ )
+      for( j=i+1; j<nObs; j++ )
+        {
+        SRFDAT3X *sa=srfOT+i, *sb=srfOT+j;
+        if( sa->nv < 3 || sb->nv < 3 ) continue;
+        if( VDOT( (&sa->dc), (&sb->dc) ) <= 0.0 ) continue;
+        for( ia=0; ia<sa->nv; ia++ )   /* find common edge */
+          {
+          VERTEX3D *a0=sa->v+ia, *a1=sa->v+(ia+1)%sa->nv;
+          VECTOR( a0, a1, (&e0) );
+          eps = 1.0e-5f * VLEN( (&e0) );
+          for( ib=0; ib<sb->nv; ib++ )
+            {
+            VERTEX3D *b0=sb->v+ib, *b1=sb->v+(ib+1)%sb->nv;
+            if( fabs(a0->x - b1->x) + fabs(a0->y - b1->y) 
+              + fabs(a0->z - b1->z) > eps ) continue;
+            if( fabs(a1->x - b0->x) + fabs(a1->y - b0->y) 
+              + fabs(a1->z - b0->z) > eps ) continue;
+            break;
+            }
+          if( ib < sb->nv ) break;
+          }
+        if( ia == sa->nv ) continue;
+
+        for( nv=0,n=1; n<=sa->nv; n++ )   /* A from end of common edge */
+          v[nv++] = sa->v[(ia+n)%sa->nv];
+        for( n=2; n<sb->nv; n++ )         /* B less the common edge */
+          v[nv++] = sb->v[(ib+n)%sb->nv];
+        for( n=0; n<nv; n++ )             /* B in plane of A */
+          if( fabs( VDOTW( (v+n), (&sa->dc) ) ) > eps ) break;
+        if( n < nv ) continue;
+
+        for( sign=0,n=0; n<nv && nv>=3; )  /* drop collinear vertices */
+          {
+          VECTOR( (v+(n+nv-1)%nv), (v+n), (&e0) );
+          VECTOR( (v+n), (v+(n+1)%nv), (&e1) );
+          VCROSS( (&e0), (&e1), (&c) );
+          dot = VDOT( (&c), (&sa->dc) );
+          len = 1.0e-5f * VLEN( (&e0) ) * VLEN( (&e1) );
+          if( fabs(dot) <= len )
+            {
+            for( k=n+1; k<nv; k++ )
+              v[k-1] = v[k];
+            nv--;
+            n = 0;                     /* recheck from start */
+            sign = 0;
+            continue;
+            }
+          if( sign == 0 )
+            sign = dot > 0.0 ? 1 : -1;
+          else if( sign * dot < 0.0 )
+            break;                     /* union not convex */
+          n++;
+          }
+        if( n < nv || nv < 3 || nv > MAXNV1 ) continue;
+
+        memcpy( sa->v, v, nv*sizeof(VERTEX3D) );
+        sa->nv = nv;
+        if( sb->ztmax > sa->ztmax )
+          sa->ztmax = sb->ztmax;
+        SetCentroid( nv, sa->v, &sa->ctd );
+        for( k=j+1; k<nObs; k++ )   /* keep the order of the others */
+          srfOT[k-1] = srfOT[k];
+        nObs--;
+        j = i;                      /* try A against all others again */
+        merged = 1;
+        }
+    } while( merged );
+
+  return nObs;
+
+  }  /*  end of MergeObstr  */
+
 /***  Dump3X.c  **************************************************************/
 
 /*  Dump SRFDAT3X structure.  */
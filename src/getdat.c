@@ -17,7 +17,7 @@
 /*****************************************************************************/
 
 #include <stdio.h>
-#include <string.h> /* prototype: memcpy, strcpy, strncpy */
+#include <string.h> /* prototype: memcpy, memset, strchr, strcpy, strncpy */
 #include <stdlib.h> /* prototype: atoi, atof */
 #include <math.h>   /* prototype: sqrt */
 #include <ctype.h>  /* prototype: toupper */
@@ -153,8 +153,26 @@ void GetCtrl( I1 *str, VFCTRL *vfCtrl )
       }
     else if( strcmpi( p, "row" ) == 0 )
       {
+      I1 *q;
       p = strtok( NULL, "= ," );
-      if( IntCon( p, &i ) )
+      q = p ? strchr( p+1, '-' ) : NULL;  /* range of rows: row=a-b */
+      if( q )
+        {
+        I2 j;
+        *q++ = '\0';
+        if( IntCon( p, &i ) )
+          error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+        else if( IntCon( q, &j ) )
+          error( 2, __FILE__, __LINE__, "Bad integer value: ", q, "" );
+        else if( i < 1 || j < i )
+          error( 2, __FILE__, __LINE__, "Invalid range of rows", "" );
+        else
+          {
+          vfCtrl->row = i;
+          vfCtrl->rowEnd = j;
+          }
+        }
+      else if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else
         {
@@ -183,6 +201,40 @@ void GetCtrl( I1 *str, VFCTRL *vfCtrl )
       else
         if( i ) vfCtrl->prjReverse = 1;
       }
+    else if( strcmpi( p, "visT" ) == 0 )
+      {
+      p = strtok( NULL, "= ," );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else
+        vfCtrl->visTest = i ? 1 : 0;
+      }
+    else if( strcmpi( p, "far" ) == 0 )
+      {
+      p = strtok( NULL, "= ," );
+      if( FltCon( p, &r ) )
+        error( 2, __FILE__, __LINE__, "Bad float value: ", p, "" );
+      else
+        {
+        if( r < 0.0 )
+          r = 0.0;
+        vfCtrl->epsFar = r;
+        if( r > 1.0e-2 )
+          error( 1, __FILE__, __LINE__, "Far-field error limit > 1.0e-2", "" );
+        }
+      }
+    else if( strcmpi( p, "threads" ) == 0 )
+      {
+      p = strtok( NULL, "= ," );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else
+        {
+        if( i < 0 )
+          i = 0;
+        vfCtrl->nThreads = i;   // 0 = one thread per processor
+        }
+      }
 
     else
       {
@@ -195,6 +247,8 @@ void GetCtrl( I1 *str, VFCTRL *vfCtrl )
 
   if( vfCtrl->col && !vfCtrl->row )
     error( 2, __FILE__, __LINE__, "Must set row before setting column", "" );
+  if( vfCtrl->col && vfCtrl->rowEnd )
+    error( 2, __FILE__, __LINE__, "Cannot set column for a range of rows", "" );
 
   }  /* end GetCtrl */
 
@@ -694,7 +748,9 @@ void TestSubSrf( SRFDAT3D *srf, const IX *baseSrf, VFCTRL *vfCtrl )
   VERTEX2D vN[MAXNV1], vM[MAXNV1]; /* 2D vertices */
   POLY *base;  /* pointer to base polygon */
   POLY *subs;  /* pointer to subsurface polygon */
+  POLYMEM polyMem;  /* polygon processing memory */
 
+  memset( &polyMem, 0, sizeof(POLYMEM) );
   for( n=1; n<=vfCtrl->nRadSrf; n++ )
     {
     if( !baseSrf[n] ) continue;
@@ -758,12 +814,12 @@ void TestSubSrf( SRFDAT3D *srf, const IX *baseSrf, VFCTRL *vfCtrl )
       vM[j].y = srfT->v[srfT->nv-1-j].y;
       }
                                 /* begin with cleared small structures area */
-    InitPolygonMem( eps, eps );
-    base = SetPolygonHC( srfM.nv, vM, 1.0 );  /* convert to HC */
-    subs = SetPolygonHC( srfN.nv, vN, 1.0 );
+    InitPolygonMem( &polyMem, eps, eps );
+    base = SetPolygonHC( &polyMem, srfM.nv, vM, 1.0 );  /* convert to HC */
+    subs = SetPolygonHC( &polyMem, srfN.nv, vN, 1.0 );
     if( subs && base )
       {
-      if( PolygonOverlap( base, subs, 3, 0 ) != 1 )  /* 1 = enclosed */
+      if( PolygonOverlap( &polyMem, base, subs, 3, 0 ) != 1 )  /* 1 = enclosed */
         error( 2, __FILE__, __LINE__, " Subsurface ",
           IntStr(n), " is not (entirely?) within its base", "" );
       }
@@ -773,6 +829,7 @@ void TestSubSrf( SRFDAT3D *srf, const IX *baseSrf, VFCTRL *vfCtrl )
       error( 3, __FILE__, __LINE__, " Enclosure test failure", "" );
       }
     }  /* end surface loop */
+  FreePolygonMem( &polyMem );
 
   }  /* end of TestSubSrf */
 
@@ -1,5 +1,43 @@
 /*subfile:  polygn.c  ********************************************************/
 /*                                                                           */
+/*  View3D, Copyright (c) 2018 Alliance for Sustainable Energy, LLC          */
+/*  All rights reserved.                                                     */
+/*                                                                           */
+/*  Redistribution and use in source and binary forms, with or without       */
+/*  modification, are permitted provided that the following conditions are   */
+/*  met:                                                                     */
+/*                                                                           */
+/*  1. Redistributions of source code must retain the above copyright        */
+/*     notice, this list of conditions and the following disclaimer.         */
+/*                                                                           */
+/*  2. Redistributions in binary form must reproduce the above copyright     */
+/*     notice, this list of conditions and the following disclaimer in the   */
+/*     documentation and/or other materials provided with the distribution.  */
+/*                                                                           */
+/*  3. The name of the copyright holder(s), any contributors, the United     */
+/*     States Government, the United States Department of Energy, or any of  */
+/*     their employees may not be used to endorse or promote products        */
+/*     derived from this software without specific prior written permission  */
+/*     from the respective party.                                            */
+/*                                                                           */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) AND ANY             */
+/*  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,   */
+/*  BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND        */
+/*  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE   */
+/*  COPYRIGHT HOLDER(S), ANY CONTRIBUTORS, THE UNITED STATES GOVERNMENT, OR  */
+/*  THE UNITED STATES DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE   */
+/*  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR      */
+/*  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF     */
+/*  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR          */
+/*  BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,    */
+/*  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR  */
+/*  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF   */
+/*  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                               */
+/*                                                                           */
+/*  This file has been modified from the original public domain version.     */
+/*                                                                           */
+/*  Original NIST Disclaimer:                                                */
+/*                                                                           */
 /*  This software was developed at the National Institute of Standards       */
 /*  and Technology by employees of the Federal Government in the             */
 /*  course of their official duties. Pursuant to title 17 Section 105        */
@@ -21,7 +59,9 @@
  *   a stack of free polygon structures, and
  *   one or more stacks of defined polygon structures.
  * Only one defined polygon stack may be created at a time.
- * However, multiple stacks may be saved by using external pointers. */
+ * However, multiple stacks may be saved by using external pointers.
+ * All of this is held in a POLYMEM structure passed to each function
+ * so that each thread of the view factor calculation has its own. */
 
 #include <stdio.h>
 #include <string.h> /* prototype: memset, memcpy */
@@ -36,14 +76,8 @@ typedef struct memblock   /* block of memory for small structure allocation */
   struct memblock *priorBlock;  /* pointer to previous block */
   struct memblock *nextBlock;   /* pointer to next block */
   }  MEMBLOCK;
-IX TransferVrt( VERTEX2D *toVrt, const VERTEX2D *fromVrt, IX nFromVrt );
-
-I1 *_memPoly=NULL; /* memory block for polygon descriptions; must start NULL */
-HCVE *_nextFreeVE; /* pointer to next free vertex/edge */
-POLY *_nextFreePD; /* pointer to next free polygon descripton */
-POLY *_nextUsedPD; /* pointer to top-of-stack used polygon */
-R4 _epsDist;   /* minimum distance between vertices */
-R4 _epsArea;   /* minimum surface area */
+IX TransferVrt( POLYMEM *pm, VERTEX2D *toVrt, const VERTEX2D *fromVrt,
+  IX nFromVrt );
 
 extern FILE *_ulog; /* log file */
 
@@ -80,7 +114,8 @@ extern FILE *_ulog; /* log file */
  *  Return 0 if P2 outside P1, 1 if P2 inside P1, 2 for partial overlap.
  */
 
-IX PolygonOverlap( const POLY *p1, POLY *p2, const IX savePD, IX freeP2 )
+IX PolygonOverlap( POLYMEM *pm, const POLY *p1, POLY *p2, const IX savePD,
+  IX freeP2 )
   {
   POLY *pp;     /* pointer to polygon */
   POLY *initUsedPD;  /* initial top-of-stack pointer */
@@ -102,7 +137,7 @@ IX PolygonOverlap( const POLY *p1, POLY *p2, const IX savePD, IX freeP2 )
     p1, p2, savePD );
 #endif
 
-  initUsedPD = _nextUsedPD;
+  initUsedPD = pm->nextUsedPD;
   nTempVrt = GetPolygonVrt2D( p2, tempVrt );
 
 #if( DEBUG > 1 )
@@ -126,9 +161,9 @@ IX PolygonOverlap( const POLY *p1, POLY *p2, const IX savePD, IX freeP2 )
     for( j=0; j<nTempVrt; j++ )
       {
       R8 dot = tempVrt[j].x * a1 + tempVrt[j].y * b1 + c1;
-      if( dot > _epsArea )
+      if( dot > pm->epsArea )
         { u[j] = 1; right = 0; }
-      else if( dot < -_epsArea )
+      else if( dot < -pm->epsArea )
         { u[j] = -1; left = 0; }
       else
         u[j] = 0;
@@ -156,7 +191,7 @@ IX PolygonOverlap( const POLY *p1, POLY *p2, const IX savePD, IX freeP2 )
         c = tempVrt[j].y * tempVrt[jm1].x - tempVrt[jm1].y * tempVrt[j].x;
         w = b * a1 - a * b1;
 #if( DEBUG > 1 )
-        if( fabs(w) < _epsArea*(a+b+c) )
+        if( fabs(w) < pm->epsArea*(a+b+c) )
           {
           error( 1, __FILE__, __LINE__, "small W", "" );
           DumpHC( "P1:", p1, p1 );
@@ -194,19 +229,19 @@ IX PolygonOverlap( const POLY *p1, POLY *p2, const IX savePD, IX freeP2 )
 
     if( savePD > 1 )  /* transfer left vertices to outside polygon */
       {
-      nTempVrt = TransferVrt( tempVrt, leftVrt, nLeftVrt );
+      nTempVrt = TransferVrt( pm, tempVrt, leftVrt, nLeftVrt );
 #if( DEBUG > 1 )
       DumpP2D( "Outside polygon:", nTempVrt, tempVrt );
 #endif
       if( nTempVrt > 2 )
         {
-        SetPolygonHC( nTempVrt, tempVrt, p2->trns );
+        SetPolygonHC( pm, nTempVrt, tempVrt, p2->trns );
         overlap = 1;
         }
       }
 
                       /* transfer right side vertices to tempVrt */
-    nTempVrt = TransferVrt( tempVrt, rightVrt, nRightVrt );
+    nTempVrt = TransferVrt( pm, tempVrt, rightVrt, nRightVrt );
 #if( DEBUG > 1 )
     DumpP2D( "Inside polygon:", nTempVrt, tempVrt );
 #endif
@@ -222,7 +257,7 @@ IX PolygonOverlap( const POLY *p1, POLY *p2, const IX savePD, IX freeP2 )
 #if( DEBUG > 1 )
     DumpP2D( "Overlap polygon:", nTempVrt, tempVrt );
 #endif
-    pp = SetPolygonHC( nTempVrt, tempVrt, p2->trns * p1->trns );
+    pp = SetPolygonHC( pm, nTempVrt, tempVrt, p2->trns * p1->trns );
     if( pp==NULL && savePD==2 )   /* overlap area too small */
       goto p2_outside_p1;
     }
@@ -236,8 +271,8 @@ p2_outside_p1:     /* no overlap between P1 and P2 */
 #endif
   if( savePD > 1 )    /* save outside polygon - P2 */
     {
-    if( initUsedPD != _nextUsedPD )  /* remove previous outside polygons */
-      FreePolygons( _nextUsedPD, initUsedPD );
+    if( initUsedPD != pm->nextUsedPD )  /* remove previous outside polygons */
+      FreePolygons( pm, pm->nextUsedPD, initUsedPD );
 
     if( freeP2 )         /* transfer P2 to new stack */
       {
@@ -247,15 +282,15 @@ p2_outside_p1:     /* no overlap between P1 and P2 */
     else                 /* copy P2 to new stack */
       {
       HCVE *pv, *pv2;
-      pp = GetPolygonHC();      /* get cleared polygon data area */
+      pp = GetPolygonHC( pm );      /* get cleared polygon data area */
       pp->area = p2->area;      /* copy P2 data */
       pp->trns = p2->trns;
       pv2 = p2->firstVE;
       do{
         if( pp->firstVE )
-          pv = pv->next = GetVrtEdgeHC();
+          pv = pv->next = GetVrtEdgeHC( pm );
         else
-          pv = pp->firstVE = GetVrtEdgeHC();
+          pv = pp->firstVE = GetVrtEdgeHC( pm );
         memcpy( pv, pv2, sizeof(HCVE) );   /* copy vertex/edge data */
         pv2 = pv2->next;
         } while( pv2 != p2->firstVE );
@@ -265,7 +300,7 @@ p2_outside_p1:     /* no overlap between P1 and P2 */
 #endif
       }
     pp->next = initUsedPD;   /* link PP to stack */
-    _nextUsedPD = pp;
+    pm->nextUsedPD = pp;
     }
 
 finish:
@@ -273,7 +308,7 @@ finish:
   NullPointerTest( __FILE__, __LINE__ );
 #endif
   if( freeP2 )   /* transfer P2 to free space */
-    FreePolygons( p2, p2->next );
+    FreePolygons( pm, p2, p2->next );
 
   return overlap;
 
@@ -282,10 +317,11 @@ finish:
 /***  TransferVrt.c  *********************************************************/
 
 /*  Transfer vertices from polygon fromVrt to polygon toVrt eliminating nearly
- *  duplicate vertices.  Closeness of vertices determined by _epsDist.  
+ *  duplicate vertices.  Closeness of vertices determined by epsDist.  
  *  Return number of vertices in polygon toVrt.  */
 
-IX TransferVrt( VERTEX2D *toVrt, const VERTEX2D *fromVrt, IX nFromVrt )
+IX TransferVrt( POLYMEM *pm, VERTEX2D *toVrt, const VERTEX2D *fromVrt,
+  IX nFromVrt )
   {
   IX j,  /* index to vertex in polygon fromVrt */
     jm1, /* = j - 1 */
@@ -293,8 +329,8 @@ IX TransferVrt( VERTEX2D *toVrt, const VERTEX2D *fromVrt, IX nFromVrt )
 
   jm1 = nFromVrt - 1;
   for( n=j=0; j<nFromVrt; jm1=j++ )
-    if( fabs(fromVrt[j].x - fromVrt[jm1].x) > _epsDist ||
-        fabs(fromVrt[j].y - fromVrt[jm1].y) > _epsDist )
+    if( fabs(fromVrt[j].x - fromVrt[jm1].x) > pm->epsDist ||
+        fabs(fromVrt[j].y - fromVrt[jm1].y) > pm->epsDist )
       {               /* transfer to toVrt */
       toVrt[n].x = fromVrt[j].x;
       toVrt[n++].y = fromVrt[j].y;
@@ -321,7 +357,8 @@ IX TransferVrt( VERTEX2D *toVrt, const VERTEX2D *fromVrt, IX nFromVrt )
  *  Return NULL if polygon area too small; otherwise return pointer to polygon.
  */
 
-POLY *SetPolygonHC( const IX nVrt, const VERTEX2D *polyVrt, const R4 trns )
+POLY *SetPolygonHC( POLYMEM *pm, const IX nVrt, const VERTEX2D *polyVrt,
+  const R4 trns )
 /* nVrt    - number of vertices (vertices in clockwise sequence);
  * polyVrt - X,Y coordinates of vertices (1st vertex not repeated at end),
              index from 0 to nVrt-1. */
@@ -331,7 +368,7 @@ POLY *SetPolygonHC( const IX nVrt, const VERTEX2D *polyVrt, const R4 trns )
   R8 area=0.0; /* polygon area */
   IX j, jm1;   /* vertex indices;  jm1 = j - 1 */
 
-  pp = GetPolygonHC();      /* get cleared polygon data area */
+  pp = GetPolygonHC( pm );      /* get cleared polygon data area */
 #if( DEBUG > 1 )
   fprintf( _ulog, " SetPolygonHC:  pp [%p]  nv %d\n", pp, nVrt );
 #endif
@@ -340,9 +377,9 @@ POLY *SetPolygonHC( const IX nVrt, const VERTEX2D *polyVrt, const R4 trns )
   for( j=0; j<nVrt; jm1=j++ )  /* loop through vertices */
     {
     if( pp->firstVE )
-      pv = pv->next = GetVrtEdgeHC();
+      pv = pv->next = GetVrtEdgeHC( pm );
     else
-      pv = pp->firstVE = GetVrtEdgeHC();
+      pv = pp->firstVE = GetVrtEdgeHC( pm );
     pv->x = polyVrt[j].x;
     pv->y = polyVrt[j].y;
     pv->a = polyVrt[jm1].y - polyVrt[j].y; /* compute HC values */
@@ -356,19 +393,19 @@ POLY *SetPolygonHC( const IX nVrt, const VERTEX2D *polyVrt, const R4 trns )
   pp->trns = trns;
 #if( DEBUG > 1 )
   fprintf( _ulog, "  areas:  %f  %f,  trns:  %f\n",
-             pp->area, _epsArea, pp->trns );
+             pp->area, pm->epsArea, pp->trns );
   fflush( _ulog );
 #endif
 
-  if( pp->area < _epsArea )  /* polygon too small to save */
+  if( pp->area < pm->epsArea )  /* polygon too small to save */
     {
-    FreePolygons( pp, NULL );
+    FreePolygons( pm, pp, NULL );
     pp = NULL;
     }
   else
     {
-    pp->next = _nextUsedPD;     /* link polygon to current list */
-    _nextUsedPD = pp;           /* prepare for next linked polygon */
+    pp->next = pm->nextUsedPD;     /* link polygon to current list */
+    pm->nextUsedPD = pp;           /* prepare for next linked polygon */
     }
 
   return pp;
@@ -381,18 +418,18 @@ POLY *SetPolygonHC( const IX nVrt, const VERTEX2D *polyVrt, const R4 trns )
  *  This is taken from the list of unused structures if possible.  
  *  Otherwise, a new structure will be allocated.  */
 
-POLY *GetPolygonHC( void )
+POLY *GetPolygonHC( POLYMEM *pm )
   {
   POLY *pp;  /* pointer to polygon structure */
 
-  if( _nextFreePD )
+  if( pm->nextFreePD )
     {
-    pp = _nextFreePD;
-    _nextFreePD = _nextFreePD->next;
+    pp = pm->nextFreePD;
+    pm->nextFreePD = pm->nextFreePD->next;
     memset( pp, 0, sizeof(POLY) );  /* clear pointers */
     }
   else
-    pp = Alc_EC( &_memPoly, sizeof(POLY), "nextPD" );
+    pp = Alc_EC( &pm->memPoly, sizeof(POLY), "nextPD" );
 
   return pp;
 
@@ -404,17 +441,17 @@ POLY *GetPolygonHC( void )
  *  This is taken from the list of unused structures if possible.  
  *  Otherwise, a new structure will be allocated.  */
 
-HCVE *GetVrtEdgeHC( void )
+HCVE *GetVrtEdgeHC( POLYMEM *pm )
   {
   HCVE *pv;  /* pointer to vertex/edge structure */
 
-  if( _nextFreeVE )
+  if( pm->nextFreeVE )
     {
-    pv = _nextFreeVE;
-    _nextFreeVE = _nextFreeVE->next;
+    pv = pm->nextFreeVE;
+    pm->nextFreeVE = pm->nextFreeVE->next;
     }
   else
-    pv = Alc_EC( &_memPoly, sizeof(HCVE), "nextVE" );
+    pv = Alc_EC( &pm->memPoly, sizeof(HCVE), "nextVE" );
 
   return pv;
 
@@ -477,7 +514,7 @@ void *Alc_EC( I1 **block, UX size, I1 *name )
 
 /*  Restore list of polygon descriptions to free space.  */
 
-void FreePolygons( POLY *first, POLY *last )
+void FreePolygons( POLYMEM *pm, POLY *first, POLY *last )
 /* first;  - pointer to first polygon in linked list (not NULL).
  * last;   - pointer to polygon AFTER last one freed (NULL = complete list). */
   {
@@ -493,12 +530,12 @@ void FreePolygons( POLY *first, POLY *last )
     pv = pp->firstVE->next;           /* free vertices (circular list) */
     while( pv->next != pp->firstVE )  /* find "end" of vertex list */
       pv = pv->next;
-    pv->next = _nextFreeVE;           /* reset vertex links */
-    _nextFreeVE = pp->firstVE;
+    pv->next = pm->nextFreeVE;           /* reset vertex links */
+    pm->nextFreeVE = pp->firstVE;
     if( pp->next == last ) break;
     }
-  pp->next = _nextFreePD;       /* reset polygon links */
-  _nextFreePD = first;
+  pp->next = pm->nextFreePD;       /* reset polygon links */
+  pm->nextFreePD = first;
 
 #if( DEBUG > 0 )
   NullPointerTest( __FILE__, __LINE__ );
@@ -510,9 +547,9 @@ void FreePolygons( POLY *first, POLY *last )
 
 /*  Start a new stack (linked list) of polygons.  */
 
-void NewPolygonStack( void )
+void NewPolygonStack( POLYMEM *pm )
   {
-  _nextUsedPD = NULL;  /* define bottom of stack */
+  pm->nextUsedPD = NULL;  /* define bottom of stack */
 
   }  /* end NewPolygonStack */
 
@@ -520,9 +557,9 @@ void NewPolygonStack( void )
 
 /*  Return pointer to top of active polygon stack.  */
 
-POLY *TopOfPolygonStack( void )
+POLY *TopOfPolygonStack( POLYMEM *pm )
   {
-  return _nextUsedPD;
+  return pm->nextUsedPD;
 
   }  /* end TopOfPolygonStack */
 
@@ -571,23 +608,23 @@ IX GetPolygonVrt3D( const POLY *pp, VERTEX3D *polyVrt )
 
 /***  InitPolygonMem.c  ******************************************************/
 
-/*  Initialize polygon processing memory and globals.  */
+/*  Initialize polygon processing memory and tolerances.  */
 
-void InitPolygonMem( const R4 epsdist, const R4 epsarea )
+void InitPolygonMem( POLYMEM *pm, const R4 epsdist, const R4 epsarea )
   {
-  if( _memPoly )  /* clear existing polygon structures data */
-    _memPoly = Clr_EC( _memPoly );
+  if( pm->memPoly )  /* clear existing polygon structures data */
+    pm->memPoly = Clr_EC( pm->memPoly );
   else            /* allocate polygon structures heap pointer */
-    _memPoly = Alc_ECI( 2000, "memPoly" );
+    pm->memPoly = Alc_ECI( 2000, "memPoly" );
 
-  _epsDist = epsdist;
-  _epsArea = epsarea;
-  _nextFreeVE = NULL;
-  _nextFreePD = NULL;
-  _nextUsedPD = NULL;
+  pm->epsDist = epsdist;
+  pm->epsArea = epsarea;
+  pm->nextFreeVE = NULL;
+  pm->nextFreePD = NULL;
+  pm->nextUsedPD = NULL;
 #if( DEBUG > 1 )
   fprintf( _ulog, "InitPolygonMem: epsDist %g epsArea %g\n",
-    _epsDist, _epsArea );
+    pm->epsDist, pm->epsArea );
 #endif
 
   }  /* end InitPolygonMem */
@@ -596,10 +633,10 @@ void InitPolygonMem( const R4 epsdist, const R4 epsarea )
 
 /*  Free polygon processing memory.  */
 
-void FreePolygonMem( void )
+void FreePolygonMem( POLYMEM *pm )
   {
-  if( _memPoly )
-    _memPoly = (I1 *)Fre_EC( _memPoly, "memPoly" );
+  if( pm->memPoly )
+    pm->memPoly = (I1 *)Fre_EC( pm->memPoly, "memPoly" );
 
   }  /* end FreePolygonMem */
 
@@ -875,12 +912,12 @@ void DumpHC( I1 *title, const POLY *pfp, const POLY *plp )
 
 /*** DumpFreePolygons.c  *****************************************************/
 
-void DumpFreePolygons( void )
+void DumpFreePolygons( POLYMEM *pm )
   {
   POLY *pp;
 
   fprintf( _ulog, "FREE POLYGONS:" );
-  for( pp=_nextFreePD; pp; pp=pp->next )
+  for( pp=pm->nextFreePD; pp; pp=pp->next )
     fprintf( _ulog, " [%p]", pp );
   fprintf( _ulog, "\n" );
 
@@ -888,12 +925,12 @@ void DumpFreePolygons( void )
 
 /*** DumpFreeVertices.c  *****************************************************/
 
-void DumpFreeVertices( void )
+void DumpFreeVertices( POLYMEM *pm )
   {
   HCVE *pv;
 
   fprintf( _ulog, "FREE VERTICES:" );
-  for( pv=_nextFreeVE; pv; pv=pv->next )
+  for( pv=pm->nextFreeVE; pv; pv=pv->next )
     fprintf( _ulog, " [%p]", pv );
   fprintf( _ulog, "\n" );
 
@@ -37,12 +37,30 @@ IX ProjectionDirection( SRFDAT3D *srf, SRFDATNM *srfn, SRFDATNM *srfm,
 IX errorf( IX severity, I1 *file, IX line, ... );
 
 R8 ViewUnobstructed( VFCTRL *vfCtrl, IX row, IX col );
+IX Converged( IX nDiv, R8 AF0, R8 AF1, R8 *dAF, R8 eps );
 R8 View2AI( const IX nss1, const DIRCOS *dc1, const VERTEX3D *pt1, const R4 *area1,
             const IX nss2, const DIRCOS *dc2, const VERTEX3D *pt2, const R4 *area2 );
+R8 View2AIsoa( const IX nss1, const DIRCOS *dc1, const VERTEX3D *pt1,
+  const R4 *area1, const IX nss2, const DIRCOS *dc2, const R8 *x2,
+  const R8 *y2, const R8 *z2, const R8 *w2 );
+IX PointsSoa( const IX n, const VERTEX3D *pt, const R4 *wt,
+  R8 *x, R8 *y, R8 *z, R8 *w );
+void SoaCheck( R8 AF, R8 AFs, R8 area, I1 *name );
+IX RectPair( const SRFDAT3X *srf1, const SRFDAT3X *srf2 );
+R8 ViewRect( const SRFDAT3X *srf1, const SRFDAT3X *srf2 );
+R8 RectEdges( R8 u, R8 h2 );
+R8 ViewExact( const IX nv1, const VERTEX3D *v1,
+  const IX nv2, const VERTEX3D *v2 );
+R8 ExactEdges( const R8 *a, const R8 la, const R8 *b, const R8 lb,
+  const R8 *p, const R8 cosA, const R8 sinA );
+R8 ExactSide( const R8 lA, const R8 lB, const R8 h, const R8 d );
+CPLX CLi2( CPLX z );
+CPLX CLog( CPLX z );
 R8 View2LI( const IX nd1, const IX nv1, const EDGEDCS *rc1, const EDGEDIV **dv1,
   const IX nd2, const IX nv2, const EDGEDCS *rc2, const EDGEDIV **dv2 );
-R8 View1LI( const IX nd1, const IX nv1, const EDGEDCS *rc1,
-  const EDGEDIV **dv1, const VERTEX3D *v1, const IX nv2, const VERTEX3D *v2 );
+R8 View1LI( const IX level, const IX nv1, const EDGEDCS *rc1,
+  const EDGEDIV **dv1, const VERTEX3D *v1, const IX nv2, const VERTEX3D *v2,
+  R8 *part );
 R8 V1LIpart( const VERTEX3D *pp, const VERTEX3D *b0, const VERTEX3D *b1,
   const VECTOR3D *B, const R8 b2, IX *flag );
 R8 V1LIxact( const VERTEX3D *a0, const VERTEX3D *a1, const R8 a, 
@@ -51,15 +69,27 @@ R8 V1LIadapt( VERTEX3D Pold[3], R8 dFold[3], R8 h, const VERTEX3D *b0,
   const VERTEX3D *b1, const VECTOR3D *B, const R8 b2, IX level, VFCTRL *vfCtrl );
 R8 ViewALI( const IX nv1, const VERTEX3D *v1,
   const IX nv2, const VERTEX3D *v2, VFCTRL *vfCtrl );
-void ViewsInit( IX maxDiv, IX init );
+void ViewsInit( IX maxDiv, IX init, VFCTRL *vfCtrl );
 IX DivideEdges( IX nd, IX nv, VERTEX3D *vs, EDGEDCS *rc, EDGEDIV **dv );
+void DivideEdgesNested( IX nv, VERTEX3D *vs, EDGEDCS *rc, EDGEDIV **dv );
+QUADCACHE *SrfQuadInit( IX nAllSrf, IX nThreads );
+QUADCACHE *SrfQuadFree( QUADCACHE *qc, IX nAllSrf );
+SRFQUAD *SrfQuad( QUADCACHE *qc, SRFDAT3X *srf );
+IX QuadPoints( SRFQUAD *q, IX nDiv, VERTEX3D **pt, R4 **wt );
+IX QuadPointsSoa( SRFQUAD *q, IX nDiv, R8 **x, R8 **y, R8 **z, R8 **w );
 IX GQParallelogram( const IX nDiv, const VERTEX3D *vp, VERTEX3D *p, R4 *w );
 IX GQTriangle( const IX nDiv, const VERTEX3D *vt, VERTEX3D *p, R4 *w );
 IX SubSrf( const IX nDiv, const IX nv, const VERTEX3D *v, const R4 area,
   VERTEX3D *pt, R4 *wt );
+IX GQParallelogramNested( const VERTEX3D *vp, VERTEX3D *p, R4 *w, R4 *wl );
+IX GQTriangleNested( const VERTEX3D *vt, VERTEX3D *p, R4 *w, R4 *wl );
+IX SubSrfNested( const IX nv, const VERTEX3D *v, const R4 area,
+  VERTEX3D *pt, R4 *wt, R4 *wl );
 
-R8 ViewObstructed( VFCTRL *vfCtrl, IX nv1, VERTEX3D v1[], R4 area, IX nDiv );
+R8 ViewObstructed( VFCTRL *vfCtrl, IX nv1, VERTEX3D v1[], R4 area, R8 *AFl );
 R8 View1AI( IX nss, VERTEX3D *p1, R4 *area1, DIRCOS *dc1, SRFDAT3X *srf2 );
+R8 View1AInested( IX level, IX nss, VERTEX3D *p1, R4 *wt, R4 *wl, R4 area,
+  R8 *dF, DIRCOS *dc1, SRFDAT3X *srf2 );
 R8 V1AIpart( const IX nv, const VERTEX3D p2[],
             const VERTEX3D *p1, const DIRCOS *u1 );
 IX Subsurface( SRFDAT3X *srf, SRFDAT3X sub[] );
@@ -72,8 +102,11 @@ R8 ViewRP( VERTEX3D v1[], R4 area, IX level, VFCTRL *vfCtrl );
      /* 3-D view test functions */
 IX AddMaskSrf( SRFDAT3D *srf, const SRFDATNM *srfN, const SRFDATNM *srfM,
   const IX *maskSrf, const IX *baseSrf, VFCTRL *vfCtrl, IX *los, IX nPoss );
-IX BoxTest( SRFDAT3D *srf, SRFDATNM *srfn, SRFDATNM *srfm, VFCTRL *vfCtrl,
-  IX *los, IX nProb );
+IX BoxTest( SRFDATNM *srfn, SRFDATNM *srfm, VFCTRL *vfCtrl,
+  BOXTREE *tree, IX *los );
+BOXTREE *BoxTreeInit( SRFDAT3D *srf, IX *possibleObstr, IX nPossObstr );
+IX BoxTreeFind( BOXTREE *tree, const R4 *box, IX *list );
+BOXTREE *BoxTreeFree( BOXTREE *tree );
 IX ClipPolygon( const R4 flag, const IX nv, VERTEX3D *v,
   R4 *dot, VERTEX3D *vc );
 IX ConeRadiusTest( SRFDAT3D *srf, SRFDATNM *srfn, SRFDATNM *srfm,
@@ -84,6 +117,14 @@ IX OrientationTest( SRFDAT3D *srf, SRFDATNM *srfn, SRFDATNM *srfm,
   VFCTRL *vfCtrl, IX *los, IX nProb );
 IX OrientationTestN( SRFDAT3D *srf, IX N, VFCTRL *vfCtrl,
   IX *possibleObstr, IX nPossObstr );
+IX SeparationTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
+  VFCTRL *vfCtrl, IX *possibleObstr, IX nPossObstr );
+IX VisibilityTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
+  VFCTRL *vfCtrl, IX *los, IX nProb );
+IX HullPlanes( SRFDATNM *srfN, SRFDATNM *srfM, DIRCOS *side, R4 eps );
+ORIENT *OrientInit( SRFDAT3D *srf, IX nRadSrf, IX nAllSrf,
+  IX *possibleObstr, IX nPossObstr );
+ORIENT *OrientFree( ORIENT *ot, IX nAllSrf );
 void SelfObstructionClip( SRFDATNM *srfn );
 IX SetShape( const IX nv, VERTEX3D *v, R4 *area );
 IX SelfObstructionTest3D( SRFDAT3D *srf1, SRFDAT3D *srf2, SRFDATNM *srfn );
@@ -92,28 +133,31 @@ void DumpOS( I1 *title, const IX nos, IX *los );
 IX SetPosObstr3D( IX nSrf, SRFDAT3D *srf, IX *lpos );
 
      /* polygon processing */
-IX PolygonOverlap( const POLY *p1, POLY *p2, const IX flagOP, IX freeP2 );
-void FreePolygons( POLY *first, POLY *last );
-POLY *SetPolygonHC( const IX nVrt, const VERTEX2D *polyVrt, const R4 trns );
+IX PolygonOverlap( POLYMEM *pm, const POLY *p1, POLY *p2, const IX flagOP,
+  IX freeP2 );
+void FreePolygons( POLYMEM *pm, POLY *first, POLY *last );
+POLY *SetPolygonHC( POLYMEM *pm, const IX nVrt, const VERTEX2D *polyVrt,
+  const R4 trns );
 IX GetPolygonVrt2D( const POLY *pp, VERTEX2D *polyVrt );
 IX GetPolygonVrt3D( const POLY *pp, VERTEX3D *srfVrt );
-POLY *GetPolygonHC( void );
-HCVE *GetVrtEdgeHC( void );
-void NewPolygonStack( void );
-POLY *TopOfPolygonStack( void );
-void InitPolygonMem( const R4 epsDist, const R4 epsArea );
-void FreePolygonMem( void );
+POLY *GetPolygonHC( POLYMEM *pm );
+HCVE *GetVrtEdgeHC( POLYMEM *pm );
+void NewPolygonStack( POLYMEM *pm );
+POLY *TopOfPolygonStack( POLYMEM *pm );
+void InitPolygonMem( POLYMEM *pm, const R4 epsDist, const R4 epsArea );
+void FreePolygonMem( POLYMEM *pm );
 IX LimitPolygon( IX nVrt, VERTEX2D polyVrt[],
   const R4 maxX, const R4 minX, const R4 maxY, const R4 minY );
 void DumpHC( I1 *title, const POLY *pfp, const POLY *plp );
-void DumpFreePolygons( void );
-void DumpFreeVertices( void );
+void DumpFreePolygons( POLYMEM *pm );
+void DumpFreeVertices( POLYMEM *pm );
 void DumpP2D( I1 *title, const IX nvs, VERTEX2D *vs );
 void DumpP3D( I1 *title, const IX nvs, VERTEX3D *vs );
 
      /* vector functions */
 void CoordTrans3D( SRFDAT3D *srfAll, SRFDATNM *srf1, SRFDATNM *srf2,
   IX *probableObstr, VFCTRL *vfCtrl );
+IX MergeObstr( VFCTRL *vfCtrl );
 void Dump3X( I1 *tittle, SRFDAT3X *srfT );
 void DumpVA( I1 *title, const IX rows, const IX cols, R4 *a );
 
@@ -125,6 +169,8 @@ void NormAF( const nSrf, const R4 *emit, const R4 *area, R8 **AF,
 IX Combine( const IX nSrf, const IX *cmbn, R4 *area, I1 **name, R8 **AF );
 void Separate( const IX nSrf, const IX *base, R4 *area, R8 **AF );
 void IntFac( const IX nSrf, const R4 *emit, const R4 *area, R8 **AF );
+void LDLFactor( const IX neq, R8 **a );
+void LDLInverse( const IX neq, R8 **a );
 void LUFactorSymm( const IX neq, R8 **a );
 void LUSolveSymm( const IX neq, const R8 **a, R8 *b );
 void DAXpY( const IX n, const R8 a, const R8 *x, R8 *y );
@@ -151,6 +197,21 @@ I2 ReadI2( IX flag );
 IX FltCon( I1 *s, R4 *f );
 R4 ReadR4( IX flag );
 
+     /* multiple thread processing */
+void ThrdInit( IX nThreads );
+void ThrdFree( void );
+IX ThrdCount( void );
+IX ThrdIndex( void );
+IX ThrdProcessors( void );
+void ThrdRun( void (*func)( void *arg, IX index ), void *arg );
+void ThrdTasks( void (*func)( void *arg, IX task ), void *arg, IX nTask );
+void *ThrdLockAlc( void );
+void ThrdLock( void *lock );
+void ThrdUnlock( void *lock );
+void *ThrdLockFre( void *lock );
+void *ThrdLoadPtr( void **p );
+void ThrdStorePtr( void **p, void *v );
+
      /* heap processing */
 void *Alc_E( UX length, I1 *name );
 IX Chk_E( void *pm, UX length, I1 *name );
@@ -1,5 +1,43 @@
 /*subfile:  SaveVF.c  ********************************************************/
 /*                                                                           */
+/*  View3D, Copyright (c) 2018 Alliance for Sustainable Energy, LLC          */
+/*  All rights reserved.                                                     */
+/*                                                                           */
+/*  Redistribution and use in source and binary forms, with or without       */
+/*  modification, are permitted provided that the following conditions are   */
+/*  met:                                                                     */
+/*                                                                           */
+/*  1. Redistributions of source code must retain the above copyright        */
+/*     notice, this list of conditions and the following disclaimer.         */
+/*                                                                           */
+/*  2. Redistributions in binary form must reproduce the above copyright     */
+/*     notice, this list of conditions and the following disclaimer in the   */
+/*     documentation and/or other materials provided with the distribution.  */
+/*                                                                           */
+/*  3. The name of the copyright holder(s), any contributors, the United     */
+/*     States Government, the United States Department of Energy, or any of  */
+/*     their employees may not be used to endorse or promote products        */
+/*     derived from this software without specific prior written permission  */
+/*     from the respective party.                                            */
+/*                                                                           */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) AND ANY             */
+/*  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,   */
+/*  BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND        */
+/*  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE   */
+/*  COPYRIGHT HOLDER(S), ANY CONTRIBUTORS, THE UNITED STATES GOVERNMENT, OR  */
+/*  THE UNITED STATES DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE   */
+/*  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR      */
+/*  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF     */
+/*  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR          */
+/*  BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,    */
+/*  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR  */
+/*  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF   */
+/*  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                               */
+/*                                                                           */
+/*  This file has been modified from the original public domain version.     */
+/*                                                                           */
+/*  Original NIST Disclaimer:                                                */
+/*                                                                           */
 /*  This software was developed at the National Institute of Standards       */
 /*  and Technology by employees of the Federal Government in the             */
 /*  course of their official duties. Pursuant to title 17 Section 105        */
@@ -24,6 +62,8 @@
 #include "view3d.h"
 #include "prtyp.h"
 
+extern IX _list;    /* output control, higher value = more output */
+
 /***  SaveF0.c  **************************************************************/
 
 /*  Save view factors as square array; + area + emit; text format.  */
@@ -172,3 +212,129 @@ void SaveVF( I1 *fileName, I1 *program, I1 *version,
 
   }  /* end SaveVF */
 
+
+/***  SaveShard.c  ***********************************************************/
+
+/*  Save a range of rows of the AF array with the surface data needed 
+ *  by MergeAF() to complete the calculations; text format.  
+ *  AF values are written with enough digits to be read back exactly.  */
+
+void SaveShard( I1 *fileName, I1 *program, I1 *version, I1 *title,
+                VFCTRL *vfCtrl, IX nSrf, SRFDAT3D *srf, I1 **name,
+                R4 *area, R4 *emit, IX *base, IX *cmbn, R8 **AF )
+/* fileName - name of shard file.
+ * title  - project title.
+ * vfCtrl - control values; rows row to rowEnd are saved.
+ * nSrf   - number of radiating surfaces.
+ * srf    - surface data; only the surface type is saved.
+ */
+  {
+  FILE *vfout;
+  IX n;    /* row */
+  IX m;    /* column */
+
+  vfout = fopen( fileName, "w" );
+  if( !vfout )
+    error( 3, __FILE__, __LINE__, "Failed to open shard file: ", fileName, "" );
+  fprintf( vfout, "%s %s shard %d %d %d %d %d %d %d %d\n", program, version,
+    nSrf, vfCtrl->row, vfCtrl->rowEnd, vfCtrl->enclosure,
+    vfCtrl->emittances, vfCtrl->outFormat, _list, vfCtrl->failConverge );
+  fprintf( vfout, "T %s\n", title );
+
+  for( n=1; n<=nSrf; n++ )      /* surface data */
+    fprintf( vfout, "%4d %.9g %.9g %d %d %d %s\n", n, area[n], emit[n],
+      srf[n].type, base[n], cmbn[n], name[n] );
+
+  for( n=vfCtrl->row; n<=vfCtrl->rowEnd; n++ )  /* AF values for row n */
+    {
+    fprintf( vfout, "R %d\n", n );
+    for( m=1; m<=n; m++ )  /* process column values */
+      {
+      fprintf( vfout, "%.17g", AF[n][m] );
+      if( m%5 && m<n )
+        fputc( ' ', vfout );
+      else
+        fputc( '\n', vfout );
+      }
+    }
+  fclose( vfout );
+
+  }  /* end of SaveShard */
+
+/***  ReadShard.c  ***********************************************************/
+
+/*  Read a file written by SaveShard().  With init = 1 only the header 
+ *  is read to set the title, control values, and number of surfaces.
+ *  With init = 0 the surface data and the AF rows are read; rowDone[n] 
+ *  is set for each row and a row found in two shards is an error.  */
+
+void ReadShard( I1 *fileName, IX init, I1 *title, VFCTRL *vfCtrl,
+                IX *nSrf, SRFDAT3D *srf, I1 **name, R4 *area, R4 *emit,
+                IX *base, IX *cmbn, R8 **AF, IX *rowDone )
+  {
+  FILE *vfin;
+  I1 line[LINELEN];
+  I1 word[3][16];  /* program, version, "shard" */
+  IX ns, n1, nn, encl, didemit, format, list, fail;
+  IX j, n, m;
+
+  vfin = fopen( fileName, "r" );
+  if( !vfin )
+    error( 3, __FILE__, __LINE__, "Failed to open shard file: ", fileName, "" );
+  if( !fgets( line, LINELEN, vfin ) || sscanf( line,
+      "%15s %15s %15s %d %d %d %d %d %d %d %d", word[0], word[1], word[2],
+      &ns, &n1, &nn, &encl, &didemit, &format, &list, &fail ) != 11 ||
+      strcmp( word[2], "shard" ) )
+    error( 3, __FILE__, __LINE__, "Not a shard file: ", fileName, "" );
+
+  if( init )
+    {
+    if( !fgets( line, LINELEN, vfin ) || line[0] != 'T' )
+      error( 3, __FILE__, __LINE__, "Missing title: ", fileName, "" );
+    for( j=strlen(line); j>0 && (line[j-1] == '\n' || line[j-1] == '\r'); )
+      line[--j] = '\0';
+    strcpy( title, line+2 );
+    *nSrf = ns;
+    vfCtrl->enclosure = encl;
+    vfCtrl->emittances = didemit;
+    vfCtrl->outFormat = format;
+    _list = list;
+    }
+
+  else
+    {
+    if( ns != *nSrf || encl != vfCtrl->enclosure ||
+        didemit != vfCtrl->emittances )
+      error( 3, __FILE__, __LINE__, "Shard does not match first shard: ",
+        fileName, "" );
+    if( fail )
+      vfCtrl->failConverge = 1;
+    fgets( line, LINELEN, vfin );   /* title */
+    for( n=1; n<=ns; n++ )      /* surface data */
+      {
+      IX k, type;
+      if( !fgets( line, LINELEN, vfin ) || sscanf( line, "%d %f %f %d %d %d %n",
+          &k, &area[n], &emit[n], &type, &base[n], &cmbn[n], &j ) < 6 || k != n )
+        error( 3, __FILE__, __LINE__, "Bad surface data: ", fileName, "" );
+      srf[n].type = type;
+      for( k=0; line[j] && line[j] != '\n' && line[j] != '\r' && k<NAMELEN; )
+        name[n][k++] = line[j++];
+      name[n][k] = '\0';
+      }
+    for( n=n1; n<=nn; n++ )  /* AF values for row n */
+      {
+      if( fscanf( vfin, " R %d", &j ) != 1 || j != n || n > ns )
+        error( 3, __FILE__, __LINE__, "Bad row in shard: ", fileName, "" );
+      if( rowDone[n] )
+        error( 3, __FILE__, __LINE__, "Row ", IntStr(n),
+          " is in more than one shard", "" );
+      for( m=1; m<=n; m++ )
+        if( fscanf( vfin, "%lf", &AF[n][m] ) != 1 )
+          error( 3, __FILE__, __LINE__, "Bad AF value in shard: ",
+            fileName, "" );
+      rowDone[n] = 1;
+      }
+    }
+  fclose( vfin );
+
+  }  /* end of ReadShard */
@@ -1,5 +1,43 @@
 /*subfile:  test3d.c  ********************************************************/
 /*                                                                           */
+/*  View3D, Copyright (c) 2018 Alliance for Sustainable Energy, LLC          */
+/*  All rights reserved.                                                     */
+/*                                                                           */
+/*  Redistribution and use in source and binary forms, with or without       */
+/*  modification, are permitted provided that the following conditions are   */
+/*  met:                                                                     */
+/*                                                                           */
+/*  1. Redistributions of source code must retain the above copyright        */
+/*     notice, this list of conditions and the following disclaimer.         */
+/*                                                                           */
+/*  2. Redistributions in binary form must reproduce the above copyright     */
+/*     notice, this list of conditions and the following disclaimer in the   */
+/*     documentation and/or other materials provided with the distribution.  */
+/*                                                                           */
+/*  3. The name of the copyright holder(s), any contributors, the United     */
+/*     States Government, the United States Department of Energy, or any of  */
+/*     their employees may not be used to endorse or promote products        */
+/*     derived from this software without specific prior written permission  */
+/*     from the respective party.                                            */
+/*                                                                           */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) AND ANY             */
+/*  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,   */
+/*  BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND        */
+/*  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE   */
+/*  COPYRIGHT HOLDER(S), ANY CONTRIBUTORS, THE UNITED STATES GOVERNMENT, OR  */
+/*  THE UNITED STATES DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE   */
+/*  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR      */
+/*  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF     */
+/*  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR          */
+/*  BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,    */
+/*  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR  */
+/*  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF   */
+/*  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                               */
+/*                                                                           */
+/*  This file has been modified from the original public domain version.     */
+/*                                                                           */
+/*  Original NIST Disclaimer:                                                */
+/*                                                                           */
 /*  This software was developed at the National Institute of Standards       */
 /*  and Technology by employees of the Federal Government in the             */
 /*  course of their official duties. Pursuant to title 17 Section 105        */
@@ -17,6 +55,7 @@
 /*****************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h> /* prototype: qsort */
 #include <string.h> /* prototype: memcpy */
 #include <math.h>   /* prototype: fabs */
 #include "types.h" 
@@ -32,6 +71,45 @@
 extern IX _list;    /* output control, higher value = more output */
 extern FILE *_ulog; /* log file */
 
+#define POSLEAF 32  /* vertices per leaf of the tree in SetPosObstr3D() */
+
+typedef struct posjob   /* data shared by threads of SetPosObstr3D() */
+  {
+  IX nSrf;      /* total number of surfaces */
+  SRFDAT3D *srf; /* vector of surface data [1:nSrf] */
+  IX nVrt;      /* number of surface vertices */
+  BOXTREE *tree; /* bounding box tree of the vertices */
+  R4 *x, *y, *z; /* coordinates of vertices in tree order [0:nVrt-1] */
+  I1 *possible; /* 1 = possible view obstruction [1:nSrf] */
+  } POSJOB;
+
+typedef struct possrt   /* sort key of a possible view obstruction */
+  {
+  R4 area;      /* surface area */
+  IX ns;        /* surface number */
+  } POSSRT;
+
+#define BOXLEAF 4   /* maximum number of surfaces in a box tree leaf */
+
+#define ORIENTMAX 1.0e8  /* maximum size of the orientation table, bytes */
+
+typedef struct orientjob  /* data shared by threads of OrientInit() */
+  {
+  SRFDAT3D *srf;  /* vector of surface data */
+  IX *possibleObstr;  /* list of possible obstructing surfaces */
+  ORIENT *ot;     /* orientation table */
+  } ORIENTJOB;
+
+     /* local functions */
+IX BlockTest( SRFDAT3D *srfK, SRFDATNM *srfN, SRFDATNM *srfM, R4 eps );
+BOXTREE *BoxTreeAlc( IX nItem, IX leaf );
+void BoxTreeSplit( BOXTREE *tree, IX node, IX first, IX count );
+R4 BoxTreeCtr( BOXTREE *tree, IX i, IX axis );
+int BoxTreeCmp( const void *p1, const void *p2 );
+void SetPosObstrThrd( void *arg, IX index );
+int SetPosObstrCmp( const void *p1, const void *p2 );
+void OrientThrd( void *arg, IX index );
+
 /***  AddMaskSrf.c  **********************************************************/
 
 /*  Add mask/null surfaces to list of possible obstructions.
@@ -70,8 +148,8 @@ IX AddMaskSrf( SRFDAT3D *srf, const SRFDATNM *srfN, const SRFDATNM *srfM,
           if( VDOTW( (ps->v[n]), (&srfM->dc) ) > eps ) break;
         if( n==nv ) continue;
         possibleObstr[++nPoss] = maskSrf[j];
-        ps->NrelS = 1;
-        ps->MrelS = -1;
+        vfCtrl->NrelS[maskSrf[j]] = 1;
+        vfCtrl->MrelS[maskSrf[j]] = -1;
         }
 
   nv = srfN->nv;
@@ -84,8 +162,8 @@ IX AddMaskSrf( SRFDAT3D *srf, const SRFDATNM *srfN, const SRFDATNM *srfM,
           if( VDOTW( (ps->v[n]), (&srfN->dc) ) > eps ) break;
         if( n==nv ) continue;
         possibleObstr[++nPoss] = maskSrf[j];
-        ps->MrelS = 1;
-        ps->NrelS = -1;
+        vfCtrl->MrelS[maskSrf[j]] = 1;
+        vfCtrl->NrelS[maskSrf[j]] = -1;
         }
 
   if( vfCtrl->col && nPoss && _list>3 )
@@ -98,76 +176,49 @@ IX AddMaskSrf( SRFDAT3D *srf, const SRFDATNM *srfN, const SRFDATNM *srfM,
 /***  BoxTest.c  *************************************************************/
 
 /*  Box test to reduce the list of possible obstructing surfaces:
- *  obstruction may not lie outside box containing surfaces N and M.  */
+ *  obstruction may not lie outside box containing surfaces N and M.
+ *  The surfaces which have some vertices inside the box in each direction
+ *  are found with the bounding box tree of the possible obstructions and 
+ *  are returned in the order of the list of possible obstructions.  */
 
-IX BoxTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
-     VFCTRL *vfCtrl, IX *possibleObstr, IX nPossObstr )
-/* srf  - data for all surfaces.
- * srfN - data for surface N.
+IX BoxTest( SRFDATNM *srfN, SRFDATNM *srfM, VFCTRL *vfCtrl,
+     BOXTREE *tree, IX *possibleObstr )
+/* srfN - data for surface N.
  * srfM - data for surface M.
+ * tree - bounding box tree of possible obstructing surfaces.
  * possibleObstr  - list of possible obstructing surfaces (output).
- * nPossObsrt  - number of possible obstructing surfaces
  */
   {
-  R4 xmax, xmin, ymax, ymin, zmax, zmin;  /* limits of box enclosing N & M */
-  IX nv;     /* number of vertices */
-  IX n;      /* vertex number */
-  IX i, k;   /* surface number */
-  IX nPoss;  /* number of possible obstructing surfaces */
+  R4 box[6];   /* limits of box enclosing N & M, as in BOXNODE */
+  IX n;        /* vertex number */
+  IX nPoss;    /* number of possible obstructing surfaces */
 
 #if( DEBUG > 1 )
-  fprintf( _ulog, "BoxTest: %d\n", nPossObstr );
+  fprintf( _ulog, "BoxTest: %d\n", tree->nItem );
 #endif
-  xmax = xmin = srfN->v[0].x;
-  ymax = ymin = srfN->v[0].y;
-  zmax = zmin = srfN->v[0].z;
+  box[1] = box[0] = srfN->v[0].x;
+  box[3] = box[2] = srfN->v[0].y;
+  box[5] = box[4] = srfN->v[0].z;
   for( n=1; n<srfN->nv; n++ )
     {
-    if( srfN->v[n].x > xmax ) xmax = srfN->v[n].x;
-    if( srfN->v[n].x < xmin ) xmin = srfN->v[n].x;
-    if( srfN->v[n].y > ymax ) ymax = srfN->v[n].y;
-    if( srfN->v[n].y < ymin ) ymin = srfN->v[n].y;
-    if( srfN->v[n].z > zmax ) zmax = srfN->v[n].z;
-    if( srfN->v[n].z < zmin ) zmin = srfN->v[n].z;
+    if( srfN->v[n].x > box[1] ) box[1] = srfN->v[n].x;
+    if( srfN->v[n].x < box[0] ) box[0] = srfN->v[n].x;
+    if( srfN->v[n].y > box[3] ) box[3] = srfN->v[n].y;
+    if( srfN->v[n].y < box[2] ) box[2] = srfN->v[n].y;
+    if( srfN->v[n].z > box[5] ) box[5] = srfN->v[n].z;
+    if( srfN->v[n].z < box[4] ) box[4] = srfN->v[n].z;
     }
   for( n=0; n<srfM->nv; n++ )
     {
-    if( srfM->v[n].x > xmax ) xmax = srfM->v[n].x;
-    if( srfM->v[n].x < xmin ) xmin = srfM->v[n].x;
-    if( srfM->v[n].y > ymax ) ymax = srfM->v[n].y;
-    if( srfM->v[n].y < ymin ) ymin = srfM->v[n].y;
-    if( srfM->v[n].z > zmax ) zmax = srfM->v[n].z;
-    if( srfM->v[n].z < zmin ) zmin = srfM->v[n].z;
+    if( srfM->v[n].x > box[1] ) box[1] = srfM->v[n].x;
+    if( srfM->v[n].x < box[0] ) box[0] = srfM->v[n].x;
+    if( srfM->v[n].y > box[3] ) box[3] = srfM->v[n].y;
+    if( srfM->v[n].y < box[2] ) box[2] = srfM->v[n].y;
+    if( srfM->v[n].z > box[5] ) box[5] = srfM->v[n].z;
+    if( srfM->v[n].z < box[4] ) box[4] = srfM->v[n].z;
     }
-        /* process possible view obstructing surfaces */
-  for( nPoss=0,i=1; i<=nPossObstr; i++ )
-    {
-    k = possibleObstr[i];
-    nv = srf[k].nv;
 
-    for( n=0; n<nv; n++ )
-      if( srf[k].v[n]->x < xmax ) break;
-    if( n==nv ) continue;    /* all vertices > xmax; no obstruction */
-    for( n=0; n<nv; n++ )
-      if( srf[k].v[n]->x > xmin ) break;
-    if( n==nv ) continue;    /* all vertices < xmin; no obstruction */
-
-    for( n=0; n<nv; n++ )
-      if( srf[k].v[n]->y < ymax ) break;
-    if( n==nv ) continue;
-    for( n=0; n<nv; n++ )
-      if( srf[k].v[n]->y > ymin ) break;
-    if( n==nv ) continue;
-
-    for( n=0; n<nv; n++ )
-      if( srf[k].v[n]->z < zmax ) break;
-    if( n==nv ) continue;
-    for( n=0; n<nv; n++ )
-      if( srf[k].v[n]->z > zmin ) break;
-    if( n==nv ) continue;
-                           /* K may be an obstruction */
-    possibleObstr[++nPoss] = k;
-    }
+  nPoss = BoxTreeFind( tree, box, possibleObstr );
 
   if( vfCtrl->col && nPoss && _list>3 )
     DumpOS( "BoxTest LOS:", nPoss, possibleObstr );
@@ -176,6 +227,238 @@ IX BoxTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
 
   }  /*  end of BoxTest  */
 
+/***  BoxTreeFind.c  *********************************************************/
+
+/*  Find the surfaces of the bounding box tree which have some vertices
+ *  inside BOX in each direction.  Return their number; the surface numbers
+ *  are in list[1:n] in the order of the tree's list.  */
+
+IX BoxTreeFind( BOXTREE *tree, const R4 *box, IX *list )
+/* tree - bounding box tree of surfaces.
+ * box  - limits of the search box, as in BOXNODE.
+ * list - list of surfaces found (output).
+ */
+  {
+  IX stack[64];  /* nodes to be tested */
+  IX nStack=0;
+  BOXNODE *node;
+  R4 *lim;   /* limits of a node or surface */
+  IX i;      /* item number */
+  IX nFound=0;  /* number of surfaces found */
+
+  if( tree->nItem > 0 )
+    stack[nStack++] = 0;
+  while( nStack )
+    {
+    node = tree->node + stack[--nStack];
+    lim = node->lim;           /* no overlap if all vertices > xmax, */
+    if( lim[0] >= box[1] || lim[1] <= box[0] ||  /* all vertices < xmin, */
+        lim[2] >= box[3] || lim[3] <= box[2] ||  /* etc. */
+        lim[4] >= box[5] || lim[5] <= box[4] ) continue;
+    if( node->count == 0 )
+      {
+      stack[nStack++] = node->first + 1;
+      stack[nStack++] = node->first;
+      continue;
+      }
+    for( i=node->first; i<node->first+node->count; i++ )
+      {
+      lim = tree->lim + 6*tree->item[i];
+      if( lim[0] >= box[1] || lim[1] <= box[0] ||
+          lim[2] >= box[3] || lim[3] <= box[2] ||
+          lim[4] >= box[5] || lim[5] <= box[4] ) continue;
+      list[++nFound] = tree->item[i];
+      }
+    }
+
+  qsort( list+1, nFound, sizeof(IX), BoxTreeCmp );
+  for( i=1; i<=nFound; i++ )
+    list[i] = tree->list[list[i]+1];
+
+  return nFound;
+
+  }  /*  end of BoxTreeFind  */
+
+/***  BoxTreeInit.c  *********************************************************/
+
+/*  Build the bounding box tree of the possible obstructing surfaces.
+ *  Each node is split at the median of the surface centroids along the 
+ *  longest side of its box; a leaf holds up to BOXLEAF surfaces.  */
+
+BOXTREE *BoxTreeInit( SRFDAT3D *srf, IX *possibleObstr, IX nPossObstr )
+/* srf  - data for all surfaces.
+ * possibleObstr  - list of possible obstructing surfaces.
+ * nPossObsrt  - number of possible obstructing surfaces
+ */
+  {
+  BOXTREE *tree;
+  R4 *lim;   /* limits of a surface */
+  IX i, k, n;
+
+  tree = BoxTreeAlc( nPossObstr, BOXLEAF );
+  if( nPossObstr < 1 ) return tree;
+  tree->list = possibleObstr;
+  for( i=0; i<nPossObstr; i++ )
+    {
+    tree->item[i] = i;
+    k = possibleObstr[i+1];
+    lim = tree->lim + 6*i;
+    lim[0] = lim[1] = srf[k].v[0]->x;
+    lim[2] = lim[3] = srf[k].v[0]->y;
+    lim[4] = lim[5] = srf[k].v[0]->z;
+    for( n=1; n<srf[k].nv; n++ )
+      {
+      if( srf[k].v[n]->x < lim[0] ) lim[0] = srf[k].v[n]->x;
+      if( srf[k].v[n]->x > lim[1] ) lim[1] = srf[k].v[n]->x;
+      if( srf[k].v[n]->y < lim[2] ) lim[2] = srf[k].v[n]->y;
+      if( srf[k].v[n]->y > lim[3] ) lim[3] = srf[k].v[n]->y;
+      if( srf[k].v[n]->z < lim[4] ) lim[4] = srf[k].v[n]->z;
+      if( srf[k].v[n]->z > lim[5] ) lim[5] = srf[k].v[n]->z;
+      }
+    }
+  BoxTreeSplit( tree, 0, 0, nPossObstr );
+
+  return tree;
+
+  }  /*  end of BoxTreeInit  */
+
+/***  BoxTreeAlc.c  **********************************************************/
+
+/*  Allocate a bounding box tree of NITEM items, LEAF items per leaf.  */
+
+BOXTREE *BoxTreeAlc( IX nItem, IX leaf )
+  {
+  BOXTREE *tree;
+
+  tree = Alc_V( 0, 0, sizeof(BOXTREE), "boxTree" );
+  tree->nItem = nItem;
+  tree->leaf = leaf;
+  tree->nNode = 1;
+  if( nItem > 0 )
+    {
+    tree->item = Alc_V( 0, nItem-1, sizeof(IX), "boxItem" );
+    tree->lim = Alc_V( 0, 6*nItem-1, sizeof(R4), "boxLim" );
+    tree->node = Alc_V( 0, 2*nItem-1, sizeof(BOXNODE), "boxNode" );
+    }
+
+  return tree;
+
+  }  /*  end of BoxTreeAlc  */
+
+/***  BoxTreeSplit.c  ********************************************************/
+
+/*  Set the limits of node NODE holding COUNT items from FIRST; split it
+ *  into two new nodes if it holds more than tree->leaf items.  */
+
+void BoxTreeSplit( BOXTREE *tree, IX node, IX first, IX count )
+  {
+  BOXNODE *pn=tree->node + node;
+  R4 *lim, cmin[3], cmax[3];  /* limits of centroids */
+  IX axis;   /* 0 = x, 1 = y, 2 = z */
+  IX i, j, k, lo, hi, mid, tmp;
+  R4 c, pivot;
+
+  for( j=0; j<3; j++ )
+    {
+    pn->lim[2*j] = cmin[j] = 1.0e30f;
+    pn->lim[2*j+1] = cmax[j] = -1.0e30f;
+    }
+  for( i=first; i<first+count; i++ )
+    {
+    lim = tree->lim + 6*tree->item[i];
+    for( j=0; j<3; j++ )
+      {
+      if( lim[2*j] < pn->lim[2*j] ) pn->lim[2*j] = lim[2*j];
+      if( lim[2*j+1] > pn->lim[2*j+1] ) pn->lim[2*j+1] = lim[2*j+1];
+      c = lim[2*j] + lim[2*j+1];
+      if( c < cmin[j] ) cmin[j] = c;
+      if( c > cmax[j] ) cmax[j] = c;
+      }
+    }
+  pn->first = first;
+  pn->count = count;
+  if( count <= tree->leaf ) return;
+
+  axis = 0;
+  if( cmax[1] - cmin[1] > cmax[axis] - cmin[axis] ) axis = 1;
+  if( cmax[2] - cmin[2] > cmax[axis] - cmin[axis] ) axis = 2;
+
+  mid = first + count / 2;   /* partition items about the median */
+  lo = first;
+  hi = first + count - 1;
+  while( lo < hi )
+    {
+    lim = tree->lim + 6*tree->item[(lo+hi)/2];
+    pivot = lim[2*axis] + lim[2*axis+1];
+    i = lo;
+    k = hi;
+    while( i <= k )
+      {
+      while( BoxTreeCtr( tree, i, axis ) < pivot ) i++;
+      while( BoxTreeCtr( tree, k, axis ) > pivot ) k--;
+      if( i <= k )
+        {
+        tmp = tree->item[i];
+        tree->item[i++] = tree->item[k];
+        tree->item[k--] = tmp;
+        }
+      }
+    if( mid <= k )
+      hi = k;
+    else if( mid >= i )
+      lo = i;
+    else
+      break;
+    }
+
+  pn->first = tree->nNode;
+  pn->count = 0;
+  tree->nNode += 2;
+  BoxTreeSplit( tree, pn->first, first, mid - first );
+  BoxTreeSplit( tree, pn->first + 1, mid, first + count - mid );
+
+  }  /*  end of BoxTreeSplit  */
+
+/***  BoxTreeCtr.c  **********************************************************/
+
+/*  Return twice the centroid coordinate of the box of item I along AXIS. */
+
+R4 BoxTreeCtr( BOXTREE *tree, IX i, IX axis )
+  {
+  R4 *lim=tree->lim + 6*tree->item[i];
+
+  return lim[2*axis] + lim[2*axis+1];
+
+  }  /*  end of BoxTreeCtr  */
+
+/***  BoxTreeCmp.c  **********************************************************/
+
+/*  Compare two list positions for qsort().  */
+
+int BoxTreeCmp( const void *p1, const void *p2 )
+  {
+  return *(const IX *)p1 - *(const IX *)p2;
+
+  }  /*  end of BoxTreeCmp  */
+
+/***  BoxTreeFree.c  *********************************************************/
+
+/*  Free the bounding box tree; return NULL.  */
+
+BOXTREE *BoxTreeFree( BOXTREE *tree )
+  {
+  if( tree->nItem > 0 )
+    {
+    Fre_V( tree->node, 0, 2*tree->nItem-1, sizeof(BOXNODE), "boxNode" );
+    Fre_V( tree->lim, 0, 6*tree->nItem-1, sizeof(R4), "boxLim" );
+    Fre_V( tree->item, 0, tree->nItem-1, sizeof(IX), "boxItem" );
+    }
+  Fre_V( tree, 0, 0, sizeof(BOXTREE), "boxTree" );
+
+  return NULL;
+
+  }  /*  end of BoxTreeFree  */
+
 /***  ConeRadiusTest.c  ******************************************************/
 
 /*  Cone (or cylinder) radius test to reduce the list
@@ -296,7 +579,8 @@ IX ConeRadiusTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
 
 /***  OrientationTest.c  *****************************************************/
 
-/*  Orientation tests to reduce the list of possible obstructs  */
+/*  Orientation tests to reduce the list of possible obstructs.  Use the
+ *  orientation table where its relation holds for this test value.  */
 
 IX OrientationTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM, 
      VFCTRL *vfCtrl, IX *possibleObstr, IX nPossObstr )
@@ -314,6 +598,10 @@ IX OrientationTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
   IX n;       /* vertex number */
   IX i, k;    /* surface number */
   IX nPoss;   /* number of possible obstructing surfaces */
+  ORIENT *ot=vfCtrl->orient;  /* orientation table */
+  U1 *relN=NULL, *relM=NULL;  /* table rows of N and M */
+  IX useN=0, useM=0, useK=0;  /* 1 = use table relations */
+  U1 cN=0, cM=0;  /* relations of N and M to K */
 
 #if( DEBUG > 1 )
   fprintf( _ulog, "OrientationTest: %d\n", nPossObstr );
@@ -322,6 +610,14 @@ IX OrientationTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
     eps = 1.0e-5f * srfN->rc;
   else
     eps = 1.0e-5f * srfM->rc;
+  if( ot )
+    {
+    relN = ot->rel + (srfN->nr - 1) * ot->nCol;
+    relM = ot->rel + (srfM->nr - 1) * ot->nCol;
+    useN = !srfN->clip;
+    useM = !srfM->clip;
+    useK = eps <= 1.0e-5f * srf[srfM->nr].rc;
+    }
 
         /* process possible view obstructing surfaces */
   for( nPoss=0,i=1; i<=nPossObstr; i++ )
@@ -331,40 +627,69 @@ IX OrientationTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
     fprintf(_ulog, "K: %d\n", k );
 #endif
     nv = srf[k].nv;
+    if( ot )
+      {
+      cN = relN[ot->col[k]];
+      cM = relM[ot->col[k]];
+      }
       /* no obstruction if K totally behind N - ==> OrientationTestN() */
       /* no obstruction if K totally behind M */
-    for( n=0; n<nv; n++ )
-      if( VDOTW( (srf[k].v[n]), (&srfM->dc) ) > eps ) break;
-    if( n==nv ) continue;
+    if( useK && KFRONT(cM) != ORTST )
+      {
+      if( KFRONT(cM) == ORNO ) continue;
+      }
+    else
+      {
+      for( n=0; n<nv; n++ )
+        if( VDOTW( (srf[k].v[n]), (&srfM->dc) ) > eps ) break;
+      if( n==nv ) continue;
+      }
 #if( DEBUG > 1 )
     fprintf(_ulog, "K in front of srfM\n" );
 #endif
 
-    infront = behind = 0;  /* check vertices of N relative to K */
-    for( n=srfN->nv; n; n-- )
+    if( useN && SFRONT(cN) != ORTST && SBEHIND(cN) != ORTST )
       {
-      dot = VDOTW( (srfN->v+n-1), (&srf[k].dc) );
-      if( dot >  eps ) infront = 1;
-      if( dot < -eps ) behind = 1;
+      infront = SFRONT(cN);
+      behind = SBEHIND(cN);
       }
-    srf[k].NrelS = infront - behind;
+    else
+      {
+      infront = behind = 0;  /* check vertices of N relative to K */
+      for( n=srfN->nv; n; n-- )
+        {
+        dot = VDOTW( (srfN->v+n-1), (&srf[k].dc) );
+        if( dot >  eps ) infront = 1;
+        if( dot < -eps ) behind = 1;
+        }
+      }
+    vfCtrl->NrelS[k] = infront - behind;
     if( infront + behind == 0 ) continue;   /* coplanar surfaces */
 
-    infront = behind = 0;  /* check vertices of M relative to K */
-    for( n=srfM->nv; n; n-- )
+    if( useM && SFRONT(cM) != ORTST && SBEHIND(cM) != ORTST )
       {
-      dot = VDOTW( (srfM->v+n-1), (&srf[k].dc) );
-      if( dot >  eps ) infront = 1;
-      if( dot < -eps ) behind = 1;
+      infront = SFRONT(cM);
+      behind = SBEHIND(cM);
       }
-    srf[k].MrelS = infront - behind;
+    else
+      {
+      infront = behind = 0;  /* check vertices of M relative to K */
+      for( n=srfM->nv; n; n-- )
+        {
+        dot = VDOTW( (srfM->v+n-1), (&srf[k].dc) );
+        if( dot >  eps ) infront = 1;
+        if( dot < -eps ) behind = 1;
+        }
+      }
+    vfCtrl->MrelS[k] = infront - behind;
     if( infront + behind == 0 ) continue;   /* coplanar surfaces */
 #if( DEBUG > 1 )
-    fprintf(_ulog, "NrelS %d, MrelS %d\n", srf[k].NrelS, srf[k].MrelS );
+    fprintf(_ulog, "NrelS %d, MrelS %d\n",
+      vfCtrl->NrelS[k], vfCtrl->MrelS[k] );
 #endif
                              /* no obstruction if N & M in front of K */
                              /* no obstruction if N & M behind K */
-    if( srf[k].NrelS * srf[k].MrelS > 0 ) continue;
+    if( vfCtrl->NrelS[k] * vfCtrl->MrelS[k] > 0 ) continue;
 
                              /* K may be an obstruction */
     possibleObstr[++nPoss] = k;
@@ -393,6 +718,7 @@ IX OrientationTestN( SRFDAT3D *srf, IX N, VFCTRL *vfCtrl,
   IX i, k;    /* surface number */
   IX nPoss;   /* number of possible obstructing surfaces */
   R4 eps = 1.0e-5f * srf[N].rc;
+  ORIENT *ot=vfCtrl->orient;  /* orientation table */
 
 #if( DEBUG > 1 )
   fprintf( _ulog, "OrientationTestN: %d\n", nPossObstr );
@@ -401,9 +727,11 @@ IX OrientationTestN( SRFDAT3D *srf, IX N, VFCTRL *vfCtrl,
   for( nPoss=0,i=1; i<=nPossObstr; i++ )
     {
     k = possibleObstr[i];
-                             /* no obstruction if K totally behind N */
-    for( j=srf[k].nv; j; j-- )
-      if( VDOTW( (srf[k].v[j-1]), (&srf[N].dc) ) > eps ) break;
+    if( ot )                 /* eps is the table limit: ORTST is behind */
+      j = KFRONT( ot->rel[(N-1)*ot->nCol + ot->col[k]] ) == ORYES;
+    else                     /* no obstruction if K totally behind N */
+      for( j=srf[k].nv; j; j-- )
+        if( VDOTW( (srf[k].v[j-1]), (&srf[N].dc) ) > eps ) break;
     if( j )                  /* K may be an obstruction */
       possibleObstr[++nPoss] = k;
     }  /* end i loop */
@@ -415,6 +743,326 @@ IX OrientationTestN( SRFDAT3D *srf, IX N, VFCTRL *vfCtrl,
 
   }  /*  end of OrientationTestN  */
 
+/***  OrientInit.c  **********************************************************/
+
+/*  Build the orientation table of surfaces 1 to nRadSrf and the possible
+ *  obstructions.  Return NULL if the table would be too large.  */
+
+ORIENT *OrientInit( SRFDAT3D *srf, IX nRadSrf, IX nAllSrf,
+     IX *possibleObstr, IX nPossObstr )
+/* srf  - data for all surfaces.
+ * nRadSrf - number of radiating surfaces: the rows of the table.
+ * nAllSrf - total number of surfaces.
+ * possibleObstr  - list of possible obstructing surfaces: the columns.
+ * nPossObsrt  - number of possible obstructing surfaces.
+ */
+  {
+  ORIENTJOB job;
+  ORIENT *ot;
+  IX i;
+
+  if( nPossObstr < 1 || (R8)nRadSrf * nPossObstr > ORIENTMAX )
+    return NULL;
+  ot = Alc_V( 0, 0, sizeof(ORIENT), "orient" );
+  ot->nRow = nRadSrf;
+  ot->nCol = nPossObstr;
+  ot->col = Alc_V( 1, nAllSrf, sizeof(IX), "orientCol" );
+  ot->rel = Alc_V( 0, nRadSrf*nPossObstr-1, sizeof(U1), "orientRel" );
+  for( i=1; i<=nPossObstr; i++ )
+    ot->col[possibleObstr[i]] = i - 1;
+  job.srf = srf;
+  job.possibleObstr = possibleObstr;
+  job.ot = ot;
+  ThrdRun( OrientThrd, &job );
+
+  return ot;
+
+  }  /*  end of OrientInit  */
+
+/***  OrientThrd.c  **********************************************************/
+
+/*  Thread function:  set the rows of the orientation table.  A relation 
+ *  is ORYES or ORNO when it is the same for every test value up to 
+ *  1.0e-5 times the radius of surface S, as used by OrientationTest().  */
+
+void OrientThrd( void *arg, IX index )
+  {
+  ORIENTJOB *job=(ORIENTJOB *)arg;
+  SRFDAT3D *srf=job->srf;
+  ORIENT *ot=job->ot;
+  U1 *rel;     /* table row of surface S */
+  R4 dot, eps; /* dot product and table limit of S */
+  R4 dmin, dmax;  /* range of distances */
+  IX s, i, k, n;
+
+  for( s=1+index; s<=ot->nRow; s+=ThrdCount() )
+    {
+    rel = ot->rel + (s - 1) * ot->nCol;
+    eps = 1.0e-5f * srf[s].rc;
+    for( i=0; i<ot->nCol; i++ )
+      {
+      k = job->possibleObstr[i+1];
+      dmin = dmax = VDOTW( (srf[s].v[0]), (&srf[k].dc) );
+      for( n=1; n<srf[s].nv; n++ )   /* S relative to K */
+        {
+        dot = VDOTW( (srf[s].v[n]), (&srf[k].dc) );
+        if( dot < dmin ) dmin = dot;
+        if( dot > dmax ) dmax = dot;
+        }
+      rel[i] = (U1)( dmax > eps ? ORYES : ( dmax <= 0.0 ? ORNO : ORTST ) );
+      rel[i] |= (U1)( ( dmin < -eps ? ORYES : ( dmin >= 0.0 ? ORNO : ORTST ) ) << 2 );
+      dmax = VDOTW( (srf[k].v[0]), (&srf[s].dc) );
+      for( n=1; n<srf[k].nv; n++ )   /* K relative to S */
+        {
+        dot = VDOTW( (srf[k].v[n]), (&srf[s].dc) );
+        if( dot > dmax ) dmax = dot;
+        }
+      rel[i] |= (U1)( ( dmax > eps ? ORYES : ( dmax <= 0.0 ? ORNO : ORTST ) ) << 4 );
+      }
+    }
+
+  }  /*  end of OrientThrd  */
+
+/***  OrientFree.c  **********************************************************/
+
+/*  Free the orientation table; return NULL.  */
+
+ORIENT *OrientFree( ORIENT *ot, IX nAllSrf )
+  {
+  if( ot )
+    {
+    Fre_V( ot->rel, 0, ot->nRow*ot->nCol-1, sizeof(U1), "orientRel" );
+    Fre_V( ot->col, 1, nAllSrf, sizeof(IX), "orientCol" );
+    Fre_V( ot, 0, 0, sizeof(ORIENT), "orient" );
+    }
+
+  return NULL;
+
+  }  /*  end of OrientFree  */
+
+/***  SeparationTest.c  ******************************************************/
+
+/*  Remove the possible obstructions which are separated from the convex
+ *  hull of N and M:  K cannot intersect any line between N and M.  The hull
+ *  is bounded by the planes of HullPlanes() and of N and M.  K is clipped
+ *  by each plane in turn; it is separated when nothing remains more than
+ *  the OrientationTest() tolerance inside the hull.  Return the new number
+ *  of obstructions.  */
+
+IX SeparationTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
+     VFCTRL *vfCtrl, IX *possibleObstr, IX nPossObstr )
+/* srf  - data for all surfaces.
+ * srfN - data for surface N.
+ * srfM - data for surface M.
+ * possibleObstr  - list of possible obstructing surfaces (input/output).
+ * nPossObsrt  - number of possible obstructing surfaces.
+ */
+  {
+  DIRCOS side[2*MAXNV1*MAXNV1+2];  /* planes bounding hull of N & M */
+  VERTEX3D v0[2*MAXNV1*MAXNV1+MAXNV1+2],  /* vertices of clipped K */
+           v1[2*MAXNV1*MAXNV1+MAXNV1+2];
+  R4 dist[2*MAXNV1*MAXNV1+MAXNV1+2];  /* distances of vertices above plane */
+  IX nSide;   /* number of hull planes */
+  IX nv;      /* number of vertices */
+  IX inside;  /* true if a vertex is inside the plane */
+  R4 eps;     /* test value */
+  IX i, j, k, n, nPoss;
+
+  if( srfN->rc < srfM->rc )
+    eps = 1.0e-5f * srfN->rc;
+  else
+    eps = 1.0e-5f * srfM->rc;
+
+  nSide = HullPlanes( srfN, srfM, side, eps );
+  for( n=0; n<2; n++ )      /* hull is in front of N and M */
+    {
+    DIRCOS *dc = n ? &srfM->dc : &srfN->dc;
+    side[nSide].x = -dc->x;
+    side[nSide].y = -dc->y;
+    side[nSide].z = -dc->z;
+    side[nSide++].w = -dc->w;
+    }
+
+  for( nPoss=0,i=1; i<=nPossObstr; i++ )
+    {
+    k = possibleObstr[i];
+    nv = srf[k].nv;
+    for( n=0; n<nv; n++ )
+      memcpy( v0+n, srf[k].v[n], sizeof(VERTEX3D) );
+    for( j=0; j<nSide; j++ )   /* clip K to hull planes */
+      {
+      for( inside=0,n=0; n<nv; n++ )
+        {
+        dist[n] = VDOTW( (v0+n), (side+j) ) + eps;
+        if( dist[n] < 0.0 ) inside = 1;
+        }
+      if( !inside ) break;         /* K outside plane J */
+      nv = ClipPolygon( -1.0, nv, v0, dist, v1 );
+      memcpy( v0, v1, nv * sizeof(VERTEX3D) );
+      }
+    if( j < nSide ) continue;
+
+    possibleObstr[++nPoss] = k;    /* K may obstruct */
+    }  /* end i loop */
+
+  if( vfCtrl->col && nPoss && _list>3 )
+    DumpOS( "SeparationTest LOS:", nPoss, possibleObstr );
+
+  return nPoss;
+
+  }  /*  end of SeparationTest  */
+
+/***  VisibilityTest.c  ******************************************************/
+
+/*  Return -1 if the view between surfaces N and M is proven blocked: the
+ *  plane of one obstruction separates N from M and the lines between all
+ *  vertices of N and M pass through that obstruction.  Otherwise return 0.
+ *  Obstructions outside the convex hull of N and M have been removed by
+ *  SeparationTest().  Tests use the tolerance of OrientationTest().  */
+
+IX VisibilityTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
+     VFCTRL *vfCtrl, IX *probableObstr, IX nProbObstr )
+/* srf  - data for all surfaces.
+ * srfN - data for surface N.
+ * srfM - data for surface M.
+ * probableObstr  - list of probable obstructing surfaces.
+ * nProbObstr  - number of probable obstructing surfaces.
+ */
+  {
+  R4 eps;     /* test value */
+  IX i;
+
+  if( srfN->rc < srfM->rc )
+    eps = 1.0e-5f * srfN->rc;
+  else
+    eps = 1.0e-5f * srfM->rc;
+
+  for( i=1; i<=nProbObstr; i++ )   /* blocking obstruction */
+    if( BlockTest( srf+probableObstr[i], srfN, srfM, eps ) )
+      {
+      if( vfCtrl->col && _list>3 )
+        fprintf( _ulog, "VisibilityTest: blocked by %d\n", probableObstr[i] );
+      return -1;
+      }
+
+  return 0;
+
+  }  /*  end of VisibilityTest  */
+
+/***  HullPlanes.c  **********************************************************/
+
+/*  Set the planes through an edge of N and a vertex of M, or an edge of M
+ *  and a vertex of N, which bound the convex hull of N and M.  The hull is
+ *  on the negative side of each plane.  Return the number of planes.  */
+
+IX HullPlanes( SRFDATNM *srfN, SRFDATNM *srfM, DIRCOS *side, R4 eps )
+  {
+  SRFDATNM *s1, *s2;   /* edge of s1, vertex of s2 */
+  VECTOR3D a, b;       /* vectors */
+  DIRCOS *pn;          /* current plane */
+  R4 dot, dmin, dmax, len;
+  IX i, j, k, n;
+  IX nSide=0;
+
+  for( k=0; k<2; k++ )
+    {
+    s1 = k ? srfM : srfN;
+    s2 = k ? srfN : srfM;
+    for( i=0; i<s1->nv; i++ )
+      {
+      VECTOR( (s1->v+i), (s1->v+(i+1)%s1->nv), (&a) );
+      for( j=0; j<s2->nv; j++ )
+        {
+        pn = side + nSide;
+        VECTOR( (s1->v+i), (s2->v+j), (&b) );
+        VCROSS( (&a), (&b), pn );
+        len = VLEN( pn );
+        if( len <= 1.0e-5f * VLEN( (&a) ) * VLEN( (&b) ) ) continue;
+        len = 1.0f / len;
+        VSCALE( len, pn, pn );
+        pn->w = -VDOT( pn, (s1->v+i) );
+        dmin = dmax = 0.0;     /* test all vertices of N and M */
+        for( n=0; n<s1->nv; n++ )
+          {
+          dot = VDOTW( (s1->v+n), pn );
+          if( dot < dmin ) dmin = dot;
+          if( dot > dmax ) dmax = dot;
+          }
+        for( n=0; n<s2->nv; n++ )
+          {
+          dot = VDOTW( (s2->v+n), pn );
+          if( dot < dmin ) dmin = dot;
+          if( dot > dmax ) dmax = dot;
+          }
+        if( dmax <= eps )
+          nSide++;
+        else if( dmin >= -eps )
+          {
+          pn->x = -pn->x;
+          pn->y = -pn->y;
+          pn->z = -pn->z;
+          pn->w = -pn->w;
+          nSide++;
+          }
+        }
+      }
+    }
+
+  return nSide;
+
+  }  /*  end of HullPlanes  */
+
+/***  BlockTest.c  ***********************************************************/
+
+/*  Return 1 if obstruction K blocks all views between N and M:  N and M
+ *  are on opposite sides of K, and the lines between the vertices of N and
+ *  the vertices of M all pass inside convex polygon K.  The intersections
+ *  of those lines with the plane of K bound the intersections of all lines
+ *  between N and M.  */
+
+IX BlockTest( SRFDAT3D *srfK, SRFDATNM *srfN, SRFDATNM *srfM, R4 eps )
+  {
+  R4 dN[MAXNV1], dM[MAXNV1];  /* distances of vertices above K */
+  VERTEX3D p;    /* intersection of line with plane of K */
+  VECTOR3D a, b, c;  /* vectors */
+  R4 t, dot, sign;
+  IX i, j, n;
+
+  if( srfN->nv < 3 || srfM->nv < 3 ) return 0;
+  for( i=0; i<srfN->nv; i++ )
+    dN[i] = VDOTW( (srfN->v+i), (&srfK->dc) );
+  for( j=0; j<srfM->nv; j++ )
+    dM[j] = VDOTW( (srfM->v+j), (&srfK->dc) );
+  if( dN[0] < 0.0 )
+    sign = -1.0;
+  else
+    sign = 1.0;
+  for( i=0; i<srfN->nv; i++ )
+    if( sign * dN[i] <= eps ) return 0;
+  for( j=0; j<srfM->nv; j++ )
+    if( sign * dM[j] >= -eps ) return 0;
+
+  for( i=0; i<srfN->nv; i++ )
+    for( j=0; j<srfM->nv; j++ )
+      {
+      t = dN[i] / (dN[i] - dM[j]);
+      p.x = srfN->v[i].x + t * (srfM->v[j].x - srfN->v[i].x);
+      p.y = srfN->v[i].y + t * (srfM->v[j].y - srfN->v[i].y);
+      p.z = srfN->v[i].z + t * (srfM->v[j].z - srfN->v[i].z);
+      for( n=0; n<srfK->nv; n++ )   /* P inside every edge of K */
+        {
+        VECTOR( (srfK->v[n]), (srfK->v[(n+1)%srfK->nv]), (&a) );
+        VECTOR( (srfK->v[n]), (&p), (&b) );
+        VCROSS( (&a), (&b), (&c) );
+        dot = VDOT( (&c), (&srfK->dc) );
+        if( dot <= eps * VLEN( (&a) ) ) return 0;
+        }
+      }
+
+  return 1;
+
+  }  /*  end of BlockTest  */
+
 /***  ClipPolygon.c  *********************************************************/
 
 /*  Clip polygon according to FLAG and DIST vector.
@@ -473,6 +1121,8 @@ void SelfObstructionClip( SRFDATNM *srfN )
 
   srfN->shape = SetShape( srfN->nv, v, &srfN->area);  /* shape and area */
 
+  srfN->clip = 1;
+
   }  /*  end of SelfObstructionClip  */
 
 /***  SetShape.c  ************************************************************/
@@ -567,6 +1217,7 @@ IX SelfObstructionTest3D( SRFDAT3D *srf1, SRFDAT3D *srf2, SRFDATNM *srfN )
     memcpy( srfN, srf2, size );
     for( n=0; n<nv; n++ )
       memcpy( srfN->v+n, srf2->v[n], sizeof(VERTEX3D) );
+    srfN->clip = 0;
     if( behind )
       srfN->area = 0.0;   /* flag for clipping calculation */
     return 1;
@@ -702,7 +1353,9 @@ void DumpOS( I1 *title, const IX nos, IX *listObstr )
 
 /***  SetPosObstr3D.c  *******************************************************/
 
-/*  Set list of possible view obstructing surfaces.
+/*  Set list of possible view obstructing surfaces, largest first.
+ *  The vertices of all surfaces are put in a bounding box tree;
+ *  the surfaces are tested by all threads and then sorted.
  *  Return number of possible view obstructing surfaces.  */
 
 IX SetPosObstr3D( IX nSrf, SRFDAT3D *srf, IX *possibleObstr )
@@ -711,48 +1364,164 @@ IX SetPosObstr3D( IX nSrf, SRFDAT3D *srf, IX *possibleObstr )
  * possibleObstr;  vector of possible view obtructions [1:nSrf]
  */
   {
+  POSJOB job;  /* data for threads */
+  POSSRT *key; /* sort keys of possible obstructions [0:npos-1] */
+  R4 *lim;     /* limits of a vertex */
   IX ns;       /* surface number */
   IX n;        /* surface number */
-  IX j;        /* vertex number */
+  IX j, k;     /* vertex numbers */
+  IX npos=0;   /* number of possible view obstructing surfaces */
+
+  job.nSrf = nSrf;
+  job.srf = srf;
+  for( job.nVrt=0,n=nSrf; n; n-- )
+    job.nVrt += srf[n].nv;
+  job.tree = BoxTreeAlc( job.nVrt, POSLEAF );
+  for( j=0,n=nSrf; n; n-- )  /* vertices of all surfaces */
+    for( k=0; k<srf[n].nv; k++,j++ )
+      {
+      job.tree->item[j] = j;
+      lim = job.tree->lim + 6*j;
+      lim[0] = lim[1] = srf[n].v[k]->x;
+      lim[2] = lim[3] = srf[n].v[k]->y;
+      lim[4] = lim[5] = srf[n].v[k]->z;
+      }
+  BoxTreeSplit( job.tree, 0, 0, job.nVrt );
+  job.x = Alc_V( 0, job.nVrt-1, sizeof(R4), "posX" );
+  job.y = Alc_V( 0, job.nVrt-1, sizeof(R4), "posY" );
+  job.z = Alc_V( 0, job.nVrt-1, sizeof(R4), "posZ" );
+  for( j=0; j<job.nVrt; j++ )   /* coordinates in tree order */
+    {
+    lim = job.tree->lim + 6*job.tree->item[j];
+    job.x[j] = lim[0];
+    job.y[j] = lim[2];
+    job.z[j] = lim[4];
+    }
+  job.possible = Alc_V( 1, nSrf, sizeof(I1), "possible" );
+
+  ThrdRun( SetPosObstrThrd, &job );
+
+  key = Alc_V( 0, nSrf-1, sizeof(POSSRT), "posKey" );
+  for( ns=nSrf; ns; ns-- )  /* reverse order for obstruction surfaces first */
+    if( job.possible[ns] )
+      {
+      key[npos].area = srf[ns].area;
+      key[npos++].ns = ns;
+      }
+  qsort( key, npos, sizeof(POSSRT), SetPosObstrCmp );
+  for( n=0; n<npos; n++ )
+    possibleObstr[n+1] = key[n].ns;
+
+  Fre_V( key, 0, nSrf-1, sizeof(POSSRT), "posKey" );
+  Fre_V( job.possible, 1, nSrf, sizeof(I1), "possible" );
+  Fre_V( job.z, 0, job.nVrt-1, sizeof(R4), "posZ" );
+  Fre_V( job.y, 0, job.nVrt-1, sizeof(R4), "posY" );
+  Fre_V( job.x, 0, job.nVrt-1, sizeof(R4), "posX" );
+  job.tree = BoxTreeFree( job.tree );
+
+  return npos;
+
+  }  /*  end of SetPosObstr3D  */
+
+/***  SetPosObstrThrd.c  *****************************************************/
+
+/*  Thread function:  a surface may obstruct a view if some vertices of the
+ *  surfaces are in front of it and some are behind it.  A node of the
+ *  vertex tree is skipped when the range of distances over its box shows
+ *  that its vertices cannot change the result; the range is widened to
+ *  cover rounding of the vertex distances.  The vertices of the other
+ *  nodes are tested in the loop over a leaf, which has no branches.  */
+
+void SetPosObstrThrd( void *arg, IX index )
+  {
+  POSJOB *job=(POSJOB *)arg;
+  SRFDAT3D *srf=job->srf;
+  BOXNODE *node;
+  IX stack[64];  /* nodes to be tested */
+  IX nStack;
+  IX ns;       /* surface number */
+  IX i, j, j1; /* vertex numbers */
   IX infront;  /* true if a vertex is in front of surface ns */
   IX behind;   /* true if a vertex is behind surface ns */
   R4 dot, eps; /* dot product and test value */
-  IX npos=0;   /* number of possible view obstructing surfaces */
+  R4 dcx, dcy, dcz, dcw;  /* direction cosines of surface ns */
+  R4 dc[3];    /* dcx, dcy, dcz */
+  R4 dmin, dmax, tol;  /* range of distances over a node box */
+  R4 a, b;
 
-  for( ns=nSrf; ns; ns-- )  /* reverse order for obstruction surfaces first */
+  for( ns=job->nSrf-index; ns>0; ns-=ThrdCount() )
     {
     if( srf[ns].type != RSRF &&
         srf[ns].type != OBSO ) continue;
     eps = 1.0e-5f * srf[ns].rc;
+    dc[0] = dcx = srf[ns].dc.x;
+    dc[1] = dcy = srf[ns].dc.y;
+    dc[2] = dcz = srf[ns].dc.z;
+    dcw = srf[ns].dc.w;
     infront = behind = 0;
-    for( n=nSrf; n; n-- )
+    nStack = 0;
+    stack[nStack++] = 0;
+    while( nStack && !(infront && behind) )
       {
-      if( srf[ns].type != RSRF &&
-          srf[ns].type != OBSO ) continue;
-      for( j=0; j<srf[n].nv; j++ )
+      node = job->tree->node + stack[--nStack];
+      dmin = dmax = dcw;
+      tol = (R4)fabs( dcw );
+      for( i=0; i<3; i++ )
         {
-        dot = VDOTW( (srf[n].v[j]), (&srf[ns].dc) );
-        if( dot > eps ) infront = 1;
-        if( dot < -eps ) behind = 1;
-        }
-      if( infront && behind ) break;
-      }  /* end n loop */
-
-    if( n )                    /* some vertices in front and some behind */
-      {                        /* surface ns ==> ns may obstruct a view. */
-      npos += 1;
-      for( n=npos; n>1; n-- )  /* insertion sort: largest surfaces first */
-        if( srf[possibleObstr[n-1]].area < srf[ns].area )
-          possibleObstr[n] = possibleObstr[n-1];
+        a = node->lim[2*i] * dc[i];
+        b = node->lim[2*i+1] * dc[i];
+        if( a < b )
+          { dmin += a; dmax += b; }
         else
-          break;
-      possibleObstr[n] = ns;
+          { dmin += b; dmax += a; }
+        tol += MAX( (R4)fabs( a ), (R4)fabs( b ) );
+        }
+      tol *= 1.0e-6f;
+      dmin -= tol;
+      dmax += tol;
+      if( dmin > eps )                     /* all vertices in front */
+        { infront = 1; continue; }
+      if( dmax < -eps )                    /* all vertices behind */
+        { behind = 1; continue; }
+      if( dmin >= -eps && (infront || dmax <= eps) )
+        continue;                          /* none behind or new in front */
+      if( dmax <= eps && behind )
+        continue;                          /* none in front or new behind */
+      if( node->count == 0 )
+        {
+        stack[nStack++] = node->first + 1;
+        stack[nStack++] = node->first;
+        continue;
+        }
+      j = node->first;
+      j1 = j + node->count;
+      for( ; j<j1; j++ )
+        {
+        dot = dcw + (job->x[j] * dcx + job->y[j] * dcy + job->z[j] * dcz);
+        infront |= ( dot > eps );
+        behind |= ( dot < -eps );
+        }
       }
+    if( infront && behind )  /* some vertices in front and some behind */
+      job->possible[ns] = 1; /* surface ns ==> ns may obstruct a view. */
     }
 
-  return npos;
+  }  /*  end of SetPosObstrThrd  */
 
-  }  /*  end of SetPosObstr3D  */
+/***  SetPosObstrCmp.c  ******************************************************/
+
+/*  Compare possible obstructions for qsort():  largest surfaces first;
+ *  equal areas in reverse order of surface number.  */
+
+int SetPosObstrCmp( const void *p1, const void *p2 )
+  {
+  const POSSRT *k1=(const POSSRT *)p1, *k2=(const POSSRT *)p2;
+
+  if( k1->area > k2->area ) return -1;
+  if( k1->area < k2->area ) return 1;
+  return k2->ns - k1->ns;
+
+  }  /*  end of SetPosObstrCmp  */
 
 #ifdef XXX
 /***  CylinderRadiusTest.c  **************************************************/
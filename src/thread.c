@@ -0,0 +1,462 @@
+/*subfile:  thread.c  ********************************************************/
+/*                                                                           */
+/*  View3D, Copyright (c) 2018 Alliance for Sustainable Energy, LLC          */
+/*  All rights reserved.                                                     */
+/*                                                                           */
+/*  Redistribution and use in source and binary forms, with or without       */
+/*  modification, are permitted provided that the following conditions are   */
+/*  met:                                                                     */
+/*                                                                           */
+/*  1. Redistributions of source code must retain the above copyright        */
+/*     notice, this list of conditions and the following disclaimer.         */
+/*                                                                           */
+/*  2. Redistributions in binary form must reproduce the above copyright     */
+/*     notice, this list of conditions and the following disclaimer in the   */
+/*     documentation and/or other materials provided with the distribution.  */
+/*                                                                           */
+/*  3. The name of the copyright holder(s), any contributors, the United     */
+/*     States Government, the United States Department of Energy, or any of  */
+/*     their employees may not be used to endorse or promote products        */
+/*     derived from this software without specific prior written permission  */
+/*     from the respective party.                                            */
+/*                                                                           */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) AND ANY             */
+/*  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,   */
+/*  BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND        */
+/*  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE   */
+/*  COPYRIGHT HOLDER(S), ANY CONTRIBUTORS, THE UNITED STATES GOVERNMENT, OR  */
+/*  THE UNITED STATES DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE   */
+/*  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR      */
+/*  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF     */
+/*  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR          */
+/*  BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,    */
+/*  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR  */
+/*  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF   */
+/*  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                               */
+/*                                                                           */
+/*****************************************************************************/
+
+/*  Run parts of the view factor calculations on several processors.
+ *  ThrdInit() starts a pool of worker threads which wait until ThrdRun()
+ *  gives them a function to execute.  The calling thread is thread 0 and
+ *  also executes the function; ThrdRun() returns when all threads are done.
+ *  Any thread may call ThrdTasks() to share a small group of independent 
+ *  tasks with the threads which are idle at that time.
+ *  Windows threads are used with the Microsoft compiler; POSIX otherwise.
+ *
+ *  The results must not depend on the number of threads.  Therefore the 
+ *  callers divide the work into parts which do not depend on ThrdCount()
+ *  or on the thread which does them, each part writes its own results, 
+ *  and any sums of the parts are made by one thread in a fixed order. */
+
+#if( _MSC_VER )
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+# include <process.h>  /* prototype: _beginthreadex */
+#else
+# include <pthread.h>
+# include <unistd.h>   /* prototype: sysconf */
+#endif
+#include <stdio.h>
+#include "types.h"
+#include "view3d.h"
+#include "prtyp.h"
+
+#if( _MSC_VER )
+typedef HANDLE THRDID;
+typedef CRITICAL_SECTION THRDMTX;
+typedef CONDITION_VARIABLE THRDCND;
+# define MtxInit(m)   InitializeCriticalSection( m )
+# define MtxFree(m)   DeleteCriticalSection( m )
+# define MtxLock(m)   EnterCriticalSection( m )
+# define MtxUnlock(m) LeaveCriticalSection( m )
+# define CndInit(c)   InitializeConditionVariable( c )
+# define CndFree(c)
+# define CndWait(c,m) SleepConditionVariableCS( c, m, INFINITE )
+# define CndWake(c)   WakeAllConditionVariable( c )
+# define THRDRTN unsigned __stdcall
+#else
+typedef pthread_t THRDID;
+typedef pthread_mutex_t THRDMTX;
+typedef pthread_cond_t THRDCND;
+# define MtxInit(m)   pthread_mutex_init( m, NULL )
+# define MtxFree(m)   pthread_mutex_destroy( m )
+# define MtxLock(m)   pthread_mutex_lock( m )
+# define MtxUnlock(m) pthread_mutex_unlock( m )
+# define CndInit(c)   pthread_cond_init( c, NULL )
+# define CndFree(c)   pthread_cond_destroy( c )
+# define CndWait(c,m) pthread_cond_wait( c, m )
+# define CndWake(c)   pthread_cond_broadcast( c )
+# define THRDRTN void *
+#endif
+
+typedef struct thrdgrp   /* group of tasks; see ThrdTasks() */
+  {
+  struct thrdgrp *next;  /* next group with tasks not yet started */
+  void (*func)( void *arg, IX task );  /* function to execute each task */
+  void *arg;       /* argument to func */
+  IX nTask;        /* number of tasks */
+  IX nNext;        /* next task to be started */
+  IX nDone;        /* number of tasks completed */
+  } THRDGRP;
+
+THRDRTN ThrdMain( void *arg );
+void ThrdHelp( void );
+
+extern FILE *_ulog; /* log file */
+
+/* The following variables are "global" to this file.
+ * They are allocated and freed in ThrdInit() and ThrdFree(). */
+IX _nThrd=1;        /* number of threads, including the main thread */
+THRDID *_thrdId;    /* worker thread identifiers [1:_nThrd-1] */
+THRDMTX _thrdMtx;   /* protects the following values */
+THRDCND _thrdWake;  /* workers wait for a new job or shut down */
+THRDCND _thrdDone;  /* main thread waits for workers to finish job */
+void (*_thrdFunc)( void *arg, IX index );  /* function of current job */
+void *_thrdArg;     /* argument to function of current job */
+U4 _thrdJob=0;      /* job counter; changed for each new job */
+IX _thrdBusy=0;     /* number of workers still running current job */
+IX _thrdQuit=0;     /* true to shut down workers */
+THRDGRP *_thrdGrp=NULL;  /* list of task groups with tasks to start */
+THRDCND _thrdTask;  /* task group owners wait for tasks to finish */
+volatile IX _thrdIdle=0;  /* number of threads waiting for work */
+THRDLOCAL IX _thrdIndex=0;  /* index of the current thread */
+
+/***  ThrdInit.c  ************************************************************/
+
+/*  Start the pool of worker threads.  nThreads includes the calling thread;
+ *  nThreads < 1 uses one thread per processor.  */
+
+void ThrdInit( IX nThreads )
+  {
+  IX n;
+
+  if( nThreads < 1 )
+    nThreads = ThrdProcessors( );
+  if( _nThrd > 1 )
+    ThrdFree( );
+  _nThrd = nThreads;
+  if( _nThrd < 2 ) return;
+
+  MtxInit( &_thrdMtx );
+  CndInit( &_thrdWake );
+  CndInit( &_thrdDone );
+  CndInit( &_thrdTask );
+  _thrdQuit = 0;
+  _thrdId = Alc_V( 1, _nThrd-1, sizeof(THRDID), "thrdId" );
+  for( n=1; n<_nThrd; n++ )
+    {
+#if( _MSC_VER )
+    _thrdId[n] = (HANDLE)_beginthreadex( NULL, 0, ThrdMain,
+      (void *)(size_t)n, 0, NULL );
+    if( !_thrdId[n] )
+#else
+    if( pthread_create( _thrdId+n, NULL, ThrdMain, (void *)(size_t)n ) )
+#endif
+      error( 3, __FILE__, __LINE__, "Unable to start thread ", IntStr(n), "" );
+    }
+
+  }  /* end ThrdInit */
+
+/***  ThrdFree.c  ************************************************************/
+
+/*  Shut down the pool of worker threads.  */
+
+void ThrdFree( void )
+  {
+  IX n;
+
+  if( _nThrd < 2 ) return;
+
+  MtxLock( &_thrdMtx );
+  _thrdQuit = 1;
+  CndWake( &_thrdWake );
+  MtxUnlock( &_thrdMtx );
+  for( n=1; n<_nThrd; n++ )
+    {
+#if( _MSC_VER )
+    WaitForSingleObject( _thrdId[n], INFINITE );
+    CloseHandle( _thrdId[n] );
+#else
+    pthread_join( _thrdId[n], NULL );
+#endif
+    }
+  Fre_V( _thrdId, 1, _nThrd-1, sizeof(THRDID), "thrdId" );
+  CndFree( &_thrdTask );
+  CndFree( &_thrdDone );
+  CndFree( &_thrdWake );
+  MtxFree( &_thrdMtx );
+  _nThrd = 1;
+
+  }  /* end ThrdFree */
+
+/***  ThrdMain.c  ************************************************************/
+
+/*  Main loop of a worker thread:  wait for a job, run it, report done.
+ *  While waiting, help with any tasks from ThrdTasks().  */
+
+THRDRTN ThrdMain( void *arg )
+  {
+  U4 job=0;  /* last job run by this thread */
+  void (*func)( void *arg, IX index );
+
+  _thrdIndex = (IX)(size_t)arg;
+  MtxLock( &_thrdMtx );
+  for(;;)
+    {
+    while( !_thrdQuit && _thrdJob == job && !_thrdGrp )
+      {
+      _thrdIdle += 1;
+      CndWait( &_thrdWake, &_thrdMtx );
+      _thrdIdle -= 1;
+      }
+    if( _thrdQuit ) break;
+    if( _thrdJob == job )  /* tasks of another thread */
+      {
+      ThrdHelp( );
+      continue;
+      }
+    job = _thrdJob;
+    func = _thrdFunc;
+    arg = _thrdArg;
+    MtxUnlock( &_thrdMtx );
+
+    func( arg, _thrdIndex );
+
+    MtxLock( &_thrdMtx );
+    if( --_thrdBusy == 0 )
+      CndWake( &_thrdDone );
+    }
+  MtxUnlock( &_thrdMtx );
+
+  return 0;
+
+  }  /* end ThrdMain */
+
+/***  ThrdRun.c  *************************************************************/
+
+/*  Execute func( arg, index ) on every thread of the pool, index = 0 to 
+ *  ThrdCount()-1, and wait until all have returned.  The calling thread 
+ *  is index 0.  Not to be called from within func.  */
+
+void ThrdRun( void (*func)( void *arg, IX index ), void *arg )
+  {
+  if( _nThrd < 2 )
+    {
+    func( arg, 0 );
+    return;
+    }
+
+  MtxLock( &_thrdMtx );
+  _thrdFunc = func;
+  _thrdArg = arg;
+  _thrdBusy = _nThrd - 1;
+  _thrdJob += 1;
+  CndWake( &_thrdWake );
+  MtxUnlock( &_thrdMtx );
+
+  func( arg, 0 );
+
+  MtxLock( &_thrdMtx );
+  while( _thrdBusy > 0 )
+    if( _thrdGrp )
+      ThrdHelp( );
+    else
+      {
+      _thrdIdle += 1;
+      CndWait( &_thrdDone, &_thrdMtx );
+      _thrdIdle -= 1;
+      }
+  MtxUnlock( &_thrdMtx );
+
+  }  /* end ThrdRun */
+
+/***  ThrdTasks.c  ***********************************************************/
+
+/*  Execute func( arg, task ), task = 0 to nTask-1, and return when all are
+ *  done.  The calling thread executes tasks of this group only; threads 
+ *  which are idle may execute the others.  The tasks are all executed by 
+ *  the caller when no thread is idle.  A task must not depend on the 
+ *  thread that executes it except through ThrdIndex().  */
+
+void ThrdTasks( void (*func)( void *arg, IX task ), void *arg, IX nTask )
+  {
+  THRDGRP grp;
+  IX task;
+
+  if( _nThrd < 2 || _thrdIdle < 1 || nTask < 2 )
+    {
+    for( task=0; task<nTask; task++ )
+      func( arg, task );
+    return;
+    }
+
+  grp.func = func;
+  grp.arg = arg;
+  grp.nTask = nTask;
+  grp.nNext = grp.nDone = 0;
+  MtxLock( &_thrdMtx );
+  grp.next = _thrdGrp;
+  _thrdGrp = &grp;
+  CndWake( &_thrdWake );
+  CndWake( &_thrdDone );
+  while( grp.nNext < grp.nTask )
+    {
+    task = grp.nNext++;
+    if( grp.nNext == grp.nTask )  /* remove group from list */
+      {
+      THRDGRP **pg = &_thrdGrp;
+      while( *pg != &grp )
+        pg = &(*pg)->next;
+      *pg = grp.next;
+      }
+    MtxUnlock( &_thrdMtx );
+    func( arg, task );
+    MtxLock( &_thrdMtx );
+    grp.nDone += 1;
+    }
+  while( grp.nDone < grp.nTask )
+    CndWait( &_thrdTask, &_thrdMtx );
+  MtxUnlock( &_thrdMtx );
+
+  }  /* end ThrdTasks */
+
+/***  ThrdHelp.c  ************************************************************/
+
+/*  Execute one task of the first group in the list.
+ *  Called and returns with _thrdMtx locked.  */
+
+void ThrdHelp( void )
+  {
+  THRDGRP *grp=_thrdGrp;
+  IX task;
+
+  task = grp->nNext++;
+  if( grp->nNext == grp->nTask )  /* no more tasks to start */
+    _thrdGrp = grp->next;
+  MtxUnlock( &_thrdMtx );
+  grp->func( grp->arg, task );
+  MtxLock( &_thrdMtx );
+  if( ++grp->nDone == grp->nTask )
+    CndWake( &_thrdTask );
+
+  }  /* end ThrdHelp */
+
+/***  ThrdCount.c  ***********************************************************/
+
+/*  Return the number of threads in the pool.  */
+
+IX ThrdCount( void )
+  {
+  return _nThrd;
+
+  }  /* end ThrdCount */
+
+/***  ThrdIndex.c  ***********************************************************/
+
+/*  Return the index of the calling thread; 0 = main thread.  */
+
+IX ThrdIndex( void )
+  {
+  return _thrdIndex;
+
+  }  /* end ThrdIndex */
+
+/***  ThrdProcessors.c  ******************************************************/
+
+/*  Return the number of processors available.  */
+
+IX ThrdProcessors( void )
+  {
+  IX n;
+#if( _MSC_VER )
+  SYSTEM_INFO info;
+  GetSystemInfo( &info );
+  n = (IX)info.dwNumberOfProcessors;
+#else
+  n = (IX)sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+  if( n < 1 ) n = 1;
+
+  return n;
+
+  }  /* end ThrdProcessors */
+
+/***  ThrdLockAlc.c  *********************************************************/
+
+/*  Allocate and initialize a lock (mutual exclusion).  */
+
+void *ThrdLockAlc( void )
+  {
+  THRDMTX *lock;
+
+  lock = (THRDMTX *)Alc_E( sizeof(THRDMTX), "lock" );
+  MtxInit( lock );
+
+  return (void *)lock;
+
+  }  /* end ThrdLockAlc */
+
+/***  ThrdLock.c  ************************************************************/
+
+/*  Acquire a lock; wait if another thread holds it.  */
+
+void ThrdLock( void *lock )
+  {
+  MtxLock( (THRDMTX *)lock );
+
+  }  /* end ThrdLock */
+
+/***  ThrdUnlock.c  **********************************************************/
+
+/*  Release a lock.  */
+
+void ThrdUnlock( void *lock )
+  {
+  MtxUnlock( (THRDMTX *)lock );
+
+  }  /* end ThrdUnlock */
+
+/***  ThrdLockFre.c  *********************************************************/
+
+/*  Free a lock allocated by ThrdLockAlc().  */
+
+void *ThrdLockFre( void *lock )
+  {
+  MtxFree( (THRDMTX *)lock );
+  Fre_E( lock, sizeof(THRDMTX), "lock" );
+
+  return NULL;
+
+  }  /* end ThrdLockFre */
+
+/***  ThrdLoadPtr.c  *********************************************************/
+
+/*  Read pointer *P stored by ThrdStorePtr() in another thread (acquire): 
+ *  the data it points to is then also visible to this thread.  */
+
+void *ThrdLoadPtr( void **p )
+  {
+#if( _MSC_VER )
+  return InterlockedCompareExchangePointer( p, NULL, NULL );
+#else
+  return __atomic_load_n( p, __ATOMIC_ACQUIRE );
+#endif
+
+  }  /* end ThrdLoadPtr */
+
+/***  ThrdStorePtr.c  ********************************************************/
+
+/*  Store pointer V in *P after all writes of the data it points to 
+ *  (release), for ThrdLoadPtr() in other threads.  */
+
+void ThrdStorePtr( void **p, void *v )
+  {
+#if( _MSC_VER )
+  InterlockedExchangePointer( p, v );
+#else
+  __atomic_store_n( p, v, __ATOMIC_RELEASE );
+#endif
+
+  }  /* end ThrdStorePtr */
+
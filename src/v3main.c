@@ -75,7 +75,7 @@ IX _list=0;  /* output control, higher value = more output:
                 2 = echo input, note calculations;
                 3 = note obstructions. */
 I1 _string[LINELEN];  /* buffer for a character string */
-I1 *methods[7]={"2AI","1AI","2LI","1LI","ALI","Adapt","Blocked"}; /* abbreviations */
+I1 *methods[9]={"2AI","1AI","2LI","1LI","ALI","RCT","EXA","Adapt","Blocked"}; /* abbreviations */
 
 void FindFile( I1 *msg, I1 *name, I1 *type );
 void ReadVF( I1 *fileName, I1 *program, I1 *version,
@@ -84,6 +84,16 @@ void ReadVF( I1 *fileName, I1 *program, I1 *version,
 void SaveVF( I1 *fileName, I1 *program, I1 *version,
              IX format, IX encl, IX didemit, IX nSrf,
              R4 *area, R4 *emit, R8 **AF, R4 *vtmp );
+void SaveShard( I1 *fileName, I1 *program, I1 *version, I1 *title,
+                VFCTRL *vfCtrl, IX nSrf, SRFDAT3D *srf, I1 **name,
+                R4 *area, R4 *emit, IX *base, IX *cmbn, R8 **AF );
+void ReadShard( I1 *fileName, IX init, I1 *title, VFCTRL *vfCtrl,
+                IX *nSrf, SRFDAT3D *srf, I1 **name, R4 *area, R4 *emit,
+                IX *base, IX *cmbn, R8 **AF, IX *rowDone );
+IX ProcessAF( I1 *outFile, I1 *program, I1 *version, I1 *title,
+              IX nSrf, VFCTRL *vfCtrl, SRFDAT3D *srf, I1 **name,
+              R4 *area, R4 *emit, IX *base, IX *cmbn, R4 *vtmp, R8 **AF );
+IX MergeAF( IX argc, I1 **argv, I1 *program, I1 *version );
 
 IX main( IX argc, I1 **argv )
   {
@@ -114,7 +124,7 @@ IX main( IX argc, I1 **argv )
   IX nSrf;         /* current number of surfaces */
   IX nSrf0;        /* initial number of surfaces */
   IX encl;         /* 1 = surfaces form enclosure */
-  IX n, flag;
+  IX n;
 
 #if( DEBUG > 0 && _MSC_VER == 0 )
   errno = 0;
@@ -125,7 +135,9 @@ IX main( IX argc, I1 **argv )
     fputs("\n\
     VIEW3D - compute view factors for a 3D geometry.\n\n\
        VIEW3D  input_file  output_file\n\n\
-    You may also enter the file names interactively.\n\n", stderr );
+    You may also enter the file names interactively.\n\n\
+    To combine the row=a-b shard files of one model:\n\n\
+       VIEW3D  -m  output_file  shard_file  shard_file ...\n\n", stderr );
     if( argc > 1 )
       exit( 1 );
     }
@@ -154,6 +166,9 @@ IX main( IX argc, I1 **argv )
   fprintf( _ulog, "Program: %s %s\n", program, version );
   fprintf( _ulog, "Executing: %s\n", argv[0] );
 
+  if( argc > 1 && strcmp( argv[1], "-m" ) == 0 )   /* merge shard files */
+    return MergeAF( argc, argv, program, version );
+
   if( argc > 1 ) {
     if( strlen(argv[1]) >= _MAX_PATH ) {
       error(3, __FILE__, __LINE__, "Input file path is too long", "");
@@ -199,10 +214,13 @@ IX main( IX argc, I1 **argv )
   vfCtrl.epsAdap = 1.0e-4f; // convergence for adaptive integration
   vfCtrl.maxRecursALI = 12; // maximum number of recursion levels
   vfCtrl.maxRecursion = 8;  // maximum number of recursion levels
+  vfCtrl.nThreads = 1;      // number of threads; 0 = one per processor
 
                  /* read Vertex/Surface data file */
   NxtOpen( inFile, __FILE__, __LINE__ );
   CountVS3D( title, &vfCtrl );
+  ThrdInit( vfCtrl.nThreads );
+  vfCtrl.nThreads = ThrdCount();
   fprintf( _ulog, "\nTitle: %s\n", title );
   fprintf( _ulog, "Control values for 3-D view factor calculations:\n" );
   if( vfCtrl.enclosure )
@@ -222,7 +240,9 @@ IX main( IX argc, I1 **argv )
   if( vfCtrl.minRecursion )
     fprintf( _ulog, " *" );
   fprintf( _ulog, "\n              solving row:" );
-  if( vfCtrl.row )
+  if( vfCtrl.rowEnd )
+    fprintf( _ulog, " %d-%d *", vfCtrl.row, vfCtrl.rowEnd );
+  else if( vfCtrl.row )
     fprintf( _ulog, " %d *", vfCtrl.row );
   else
     fprintf( _ulog, " all" );
@@ -233,6 +253,13 @@ IX main( IX argc, I1 **argv )
     fprintf( _ulog, " all" );
   if( vfCtrl.prjReverse )
     fprintf( _ulog, "\n      reverse projections. **" );
+  if( vfCtrl.visTest )
+    fprintf( _ulog, "\n      visibility pre-test. *" );
+  if( vfCtrl.epsFar > 0.0 )
+    fprintf( _ulog, "\n    far-field error limit: %g *", vfCtrl.epsFar );
+  fprintf( _ulog, "\n        number of threads: %d", vfCtrl.nThreads );
+  if( vfCtrl.nThreads != 1 )
+    fprintf( _ulog, " *" );
   fprintf( _ulog, "\n output control parameter: %d\n", _list );
 
   fprintf( _ulog, "\n" );
@@ -240,6 +267,8 @@ IX main( IX argc, I1 **argv )
   fprintf( _ulog, "   heat transfer surfaces: %d \n", vfCtrl.nRadSrf );
 
   nSrf = nSrf0 = vfCtrl.nRadSrf;
+  if( vfCtrl.rowEnd > nSrf0 )
+    error( 3, __FILE__, __LINE__, "Last row > number of surfaces", "" );
   encl = vfCtrl.enclosure;
   if( vfCtrl.format == 4 )
     vfCtrl.nVertices = 4 * vfCtrl.nAllSrf;
@@ -306,7 +335,15 @@ IX main( IX argc, I1 **argv )
       }
     }
 
-  if( vfCtrl.row )
+  if( vfCtrl.rowEnd )    /* allocate only rows row to rowEnd */
+    {
+    AF = Alc_V( 1, nSrf0, sizeof(R8 *), "AF" );
+    for( n=vfCtrl.rowEnd; n>=vfCtrl.row; n-- )
+      AF[n] = Alc_V( 1, n, sizeof(R8), "AF" );
+    fprintf( stderr, "\nComputing view factors for rows %d to %d:\n\n",
+      vfCtrl.row, vfCtrl.rowEnd );
+    }
+  else if( vfCtrl.row )
     AF = Alc_MC( vfCtrl.row, vfCtrl.row, 1, nSrf0, sizeof(R8), "AF" );
   else
     {
@@ -328,7 +365,7 @@ IX main( IX argc, I1 **argv )
   View3D( srf, base, possibleObstr, AF, &vfCtrl );
 
   fprintf( _ulog, "\n%7.2f seconds to compute view factors.\n", CPUTime(time1) );
-  if( vfCtrl.row )
+  if( vfCtrl.row && !vfCtrl.rowEnd )
     {
     IX n=vfCtrl.row,
        m=vfCtrl.col;
@@ -348,10 +385,10 @@ IX main( IX argc, I1 **argv )
       fprintf( _ulog, "    sum = %.8f\n\n", sum );
       }
     fflush( _ulog );
+    ThrdFree( );
     exit( 0 );
     }
   Fre_V( xyz, 1, vfCtrl.nVertices, sizeof(VERTEX3D), "xyz" );
-  FreePolygonMem();
   for( n=nSrf; n; n-- )  /* clear base pointers to OBSO & MASK srfs */
     {
     if( srf[base[n]].type == OBSO )  /* Base is used for several things. */
@@ -360,6 +397,78 @@ IX main( IX argc, I1 **argv )
       base[n] = 0;
     }
 
+  if( vfCtrl.rowEnd )     /* save rows for MergeAF() */
+    {
+    SaveShard( outFile, program, version, title, &vfCtrl, nSrf, srf,
+      name, area, emit, base, cmbn, AF );
+    fprintf( _ulog, "\nRows %d to %d saved for merging.\n",
+      vfCtrl.row, vfCtrl.rowEnd );
+    for( n=vfCtrl.row; n<=vfCtrl.rowEnd; n++ )
+      Fre_V( AF[n], 1, n, sizeof(R8), "AF" );
+    Fre_V( AF, 1, nSrf0, sizeof(R8 *), "AF" );
+    }
+  else
+    {
+    nSrf = ProcessAF( outFile, program, version, title, nSrf, &vfCtrl, srf,
+      name, area, emit, base, cmbn, vtmp, AF );
+    Fre_MSR( (void **)AF, 1, nSrf0, sizeof(R8), "AF" );
+    }
+  Fre_V( srf, 1, vfCtrl.nAllSrf, sizeof(SRFDAT3D), "srf" );
+
+  fprintf( _ulog, "\nFinal list of surfaces:\n" );
+  fprintf( _ulog, "   #        name     area  emit\n" );
+  for( n=1; n<=nSrf; n++ )
+    fprintf( _ulog, "%4d %12s %8.3f %5.3f\n", n, name[n], area[n], emit[n] );
+
+  Fre_V( cmbn, 1, nSrf0, sizeof(IX), "cmbn" );
+  Fre_V( base, 1, nSrf0, sizeof(IX), "base" );
+  Fre_V( vtmp, 1, nSrf0, sizeof(R4), "vtmp" );
+  Fre_V( emit, 1, nSrf0, sizeof(R4), "emit" );
+  Fre_V( area, 1, nSrf0, sizeof(R4), "area" );
+  Fre_MC( (void **)name, 1, nSrf0, 0, NAMELEN, sizeof(I1), "name" );
+  ThrdFree( );
+
+#if( DEBUG > 0 )
+# if( _MSC_VER == 0 )
+  fprintf( _ulog, "Final %s", MemRem(_string) );
+  NullPointerTest( __FILE__, __LINE__ );
+# endif
+  MemWalk( );
+#endif
+
+  fprintf( _ulog, "\n%7.2f seconds for all calculations.\n", CPUTime(time0) );
+  time(&bintime);
+  curtime = localtime(&bintime);
+  fprintf( _ulog, "Time:  %s", asctime(curtime) );
+  fprintf( _ulog, "\n**********\n\n" );
+
+  fclose( _ulog );
+
+  fprintf( stderr, "\nDone!\n" );
+
+  return 0;
+
+  }  /* end of main */
+
+/***  ProcessAF.c  ***********************************************************/
+
+/*  Complete the view factor calculations:  remove null surfaces, separate 
+ *  subsurfaces, combine surfaces, normalize enclosure view factors, 
+ *  include emittances, and save the view factors in outFile.
+ *  Return the final number of surfaces.  */
+
+IX ProcessAF( I1 *outFile, I1 *program, I1 *version, I1 *title,
+              IX nSrf, VFCTRL *vfCtrl, SRFDAT3D *srf, I1 **name,
+              R4 *area, R4 *emit, IX *base, IX *cmbn, R4 *vtmp, R8 **AF )
+/* nSrf - number of radiating surfaces.
+ * srf  - surface data; only the surface types are used.
+ * AF   - triangular array of area*view factor values [1:nSrf][].
+ */
+  {
+  R4 time1;        /* elapsed time values */
+  IX encl=vfCtrl->enclosure;  /* 1 = surfaces form enclosure */
+  IX n, flag;
+
   if( _list>1 )
     {
     IX *jtmp = Alc_V( 1, nSrf, sizeof(IX), "jtmp" );
@@ -385,7 +494,6 @@ IX main( IX argc, I1 **argv )
       ReportAF( nSrf, encl, "View factors after removing null surfaces:",
         name, area, vtmp, base, AF, 0 );
     }
-  Fre_V( srf, 1, vfCtrl.nAllSrf, sizeof(SRFDAT3D), "srf" );
 
   for( flag=0,n=nSrf; n; n-- )
     if( base[n]>0 ) flag = 1;
@@ -415,7 +523,7 @@ IX main( IX argc, I1 **argv )
       }
     }
 
-  if( encl || vfCtrl.emittances )    /* intermediate report */
+  if( encl || vfCtrl->emittances )    /* intermediate report */
     if( _list < 2 )
       ReportAF( nSrf, encl, title, name, area, vtmp, base, AF, 1 );
 
@@ -428,7 +536,7 @@ IX main( IX argc, I1 **argv )
     }
   fprintf( _ulog, "%7.2f seconds to adjust view factors.\n", CPUTime(time1) );
 
-  if( vfCtrl.emittances )
+  if( vfCtrl->emittances )
     {
     fprintf( stderr, "\nProcessing surface emissivites\n" );
     time1 = CPUTime( 0.0 );
@@ -442,38 +550,104 @@ IX main( IX argc, I1 **argv )
     }
 
   fprintf( _ulog, "\nFinal view factors:" );
-  if( vfCtrl.emittances )
+  if( vfCtrl->emittances )
     ReportAF( nSrf, encl, title, name, area, emit, base, AF, 0 );
   else
     ReportAF( nSrf, encl, title, name, area, vtmp, base, AF, 0 );
 
   CPUTime(time1);
-  SaveVF( outFile, program, version, vfCtrl.outFormat, vfCtrl.enclosure,
-          vfCtrl.emittances, nSrf, area, emit, AF, vtmp );
+  SaveVF( outFile, program, version, vfCtrl->outFormat, vfCtrl->enclosure,
+          vfCtrl->emittances, nSrf, area, emit, AF, vtmp );
   fprintf( _ulog, "%7.2f seconds to write view factors.\n", CPUTime(time1) );
 
+  return nSrf;
+
+  }  /* end of ProcessAF */
+
+/***  MergeAF.c  *************************************************************/
+
+/*  Combine the shard files written by row=a-b runs into the full AF 
+ *  array, then complete the calculations as for a single run:
+ *     VIEW3D  -m  output_file  shard_file  shard_file ...  */
+
+IX MergeAF( IX argc, I1 **argv, I1 *program, I1 *version )
+  {
+  I1 title[LINELEN];  /* project title */
+  I1 **name;       /* surface names [1:nSrf][0:NAMELEN] */
+  SRFDAT3D *srf;   /* vector of surface data structures [1:nSrf] */
+  VFCTRL vfCtrl;   /* VF calculation control parameters */
+  R8 **AF;         /* triangular array of area*view factor values [1:nSrf][] */
+  R4 *area;        /* vector of surface areas [1:nSrf] */
+  R4 *emit;        /* vector of surface emittances [1:nSrf] */
+  IX *base;        /* vector of base surface numbers [1:nSrf] */
+  IX *cmbn;        /* vector of combine surface numbers [1:nSrf] */
+  R4 *vtmp;        /* temporary vector [1:nSrf] */
+  IX *rowDone;     /* 1 = row has been read [1:nSrf] */
+  struct tm *curtime; /* time structure */
+  time_t bintime;  /* seconds since 00:00:00 GMT, 1/1/70 */
+  R4 time0;        /* elapsed time values */
+  IX nSrf;         /* current number of surfaces */
+  IX nSrf0;        /* initial number of surfaces */
+  IX j, n;
+
+  if( argc < 4 )
+    error( 3, __FILE__, __LINE__,
+      "Merge requires an output file and shard files", "" );
+  time0 = CPUTime( 0.0 );
+  fprintf( _ulog, "Output file:  %s\n", argv[2] );
+  time(&bintime);
+  curtime = localtime(&bintime);
+  fprintf( _ulog, "Time:  %s", asctime(curtime) );
+
+  memset( &vfCtrl, 0, sizeof(VFCTRL) );
+  ReadShard( argv[3], 1, title, &vfCtrl, &nSrf0,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL );
+  fprintf( _ulog, "\nTitle: %s\n", title );
+  fprintf( _ulog, "   heat transfer surfaces: %d \n", nSrf0 );
+
+  nSrf = nSrf0;
+  name = Alc_MC( 1, nSrf0, 0, NAMELEN, sizeof(I1), "name" );
+  area = Alc_V( 1, nSrf0, sizeof(R4), "area" );
+  emit = Alc_V( 1, nSrf0, sizeof(R4), "emit" );
+  vtmp = Alc_V( 1, nSrf0, sizeof(R4), "vtmp" );
+  for( n=nSrf; n; n-- )
+    vtmp[n] = 1.0;
+  base = Alc_V( 1, nSrf0, sizeof(IX), "base" );
+  cmbn = Alc_V( 1, nSrf0, sizeof(IX), "cmbn" );
+  srf = Alc_V( 1, nSrf0, sizeof(SRFDAT3D), "srf" );
+  rowDone = Alc_V( 1, nSrf0, sizeof(IX), "rowDone" );
+  AF = Alc_MSR( 1, nSrf0, sizeof(R8), "AF" );
+
+  for( j=3; j<argc; j++ )
+    {
+    fprintf( _ulog, "Shard file:  %s\n", argv[j] );
+    ReadShard( argv[j], 0, title, &vfCtrl, &nSrf0,
+      srf, name, area, emit, base, cmbn, AF, rowDone );
+    }
+  for( n=1; n<=nSrf0; n++ )
+    if( !rowDone[n] )
+      error( 3, __FILE__, __LINE__, "Row ", IntStr(n), " is in no shard", "" );
+  if( vfCtrl.failConverge ) error( 1, __FILE__, __LINE__,
+    "Some calculations did not converge, see shard logs", "" );
+
+  nSrf = ProcessAF( argv[2], program, version, title, nSrf, &vfCtrl, srf,
+    name, area, emit, base, cmbn, vtmp, AF );
 
   fprintf( _ulog, "\nFinal list of surfaces:\n" );
   fprintf( _ulog, "   #        name     area  emit\n" );
   for( n=1; n<=nSrf; n++ )
     fprintf( _ulog, "%4d %12s %8.3f %5.3f\n", n, name[n], area[n], emit[n] );
 
+  Fre_MSR( (void **)AF, 1, nSrf0, sizeof(R8), "AF" );
+  Fre_V( rowDone, 1, nSrf0, sizeof(IX), "rowDone" );
+  Fre_V( srf, 1, nSrf0, sizeof(SRFDAT3D), "srf" );
   Fre_V( cmbn, 1, nSrf0, sizeof(IX), "cmbn" );
   Fre_V( base, 1, nSrf0, sizeof(IX), "base" );
   Fre_V( vtmp, 1, nSrf0, sizeof(R4), "vtmp" );
   Fre_V( emit, 1, nSrf0, sizeof(R4), "emit" );
   Fre_V( area, 1, nSrf0, sizeof(R4), "area" );
-  Fre_MSR( (void **)AF, 1, nSrf0, sizeof(R8), "AF" );
   Fre_MC( (void **)name, 1, nSrf0, 0, NAMELEN, sizeof(I1), "name" );
 
-#if( DEBUG > 0 )
-# if( _MSC_VER == 0 )
-  fprintf( _ulog, "Final %s", MemRem(_string) );
-  NullPointerTest( __FILE__, __LINE__ );
-# endif
-  MemWalk( );
-#endif
-
   fprintf( _ulog, "\n%7.2f seconds for all calculations.\n", CPUTime(time0) );
   time(&bintime);
   curtime = localtime(&bintime);
@@ -486,7 +660,7 @@ IX main( IX argc, I1 **argv )
 
   return 0;
 
-  }  /* end of main */
+  }  /* end of MergeAF */
 
 /***  VolPrism.c  ************************************************************/
 
@@ -649,4 +823,3 @@ void FindFile( I1 *msg, I1 *fileName, I1 *type )
   fclose( pfile );
 
   }  /*  end of FindFile  */
-
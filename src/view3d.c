@@ -1,5 +1,43 @@
 /*subfile:  view3d.c  ********************************************************/
 /*                                                                           */
+/*  View3D, Copyright (c) 2018 Alliance for Sustainable Energy, LLC          */
+/*  All rights reserved.                                                     */
+/*                                                                           */
+/*  Redistribution and use in source and binary forms, with or without       */
+/*  modification, are permitted provided that the following conditions are   */
+/*  met:                                                                     */
+/*                                                                           */
+/*  1. Redistributions of source code must retain the above copyright        */
+/*     notice, this list of conditions and the following disclaimer.         */
+/*                                                                           */
+/*  2. Redistributions in binary form must reproduce the above copyright     */
+/*     notice, this list of conditions and the following disclaimer in the   */
+/*     documentation and/or other materials provided with the distribution.  */
+/*                                                                           */
+/*  3. The name of the copyright holder(s), any contributors, the United     */
+/*     States Government, the United States Department of Energy, or any of  */
+/*     their employees may not be used to endorse or promote products        */
+/*     derived from this software without specific prior written permission  */
+/*     from the respective party.                                            */
+/*                                                                           */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) AND ANY             */
+/*  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,   */
+/*  BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND        */
+/*  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE   */
+/*  COPYRIGHT HOLDER(S), ANY CONTRIBUTORS, THE UNITED STATES GOVERNMENT, OR  */
+/*  THE UNITED STATES DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE   */
+/*  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR      */
+/*  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF     */
+/*  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR          */
+/*  BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,    */
+/*  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR  */
+/*  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF   */
+/*  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                               */
+/*                                                                           */
+/*  This file has been modified from the original public domain version.     */
+/*                                                                           */
+/*  Original NIST Disclaimer:                                                */
+/*                                                                           */
 /*  This software was developed at the National Institute of Standards       */
 /*  and Technology by employees of the Federal Government in the             */
 /*  course of their official duties. Pursuant to title 17 Section 105        */
@@ -25,16 +63,103 @@
 #include "types.h"
 #include "view3d.h"
 #include "prtyp.h"
+
+#define PIinv    0.318309886183790672   /* 1 / pi */
+
+typedef struct viewpair   /* obstructed view factor deferred for scheduling */
+  {
+  IX n, m;         /* row and column of AF */
+  R4 cost;         /* estimated relative computation time */
+  } VIEWPAIR;
+
+typedef struct viewthrd   /* view factor calculation data for one thread */
+  {
+  VFCTRL vfCtrl;   /* copy of control values; work areas of this thread */
+  IX *probableObstr;   /* list of probable obstructions */
+  I1 *frontN;      /* 1 = possible obstruction not behind N [1:nAllSrf] */
+  IX rowN;         /* row N of frontN[] */
+  UX nAF0,         /* number of AF which must equal 0 */
+     nAFnO,        /* number of AF without obstructing surfaces */
+     nAFwO,        /* number of AF with obstructing surfaces */
+     nObstr,       /* total number of obstructions considered */
+     nVisClear,    /* number of views proven clear by SeparationTest() */
+     nVisBlock,    /* number of views proven blocked */
+     nVisPart;     /* number of views needing ViewObstructed() */
+  UX bins[7][6];   /* for statistical summary */
+  U4 usedV1LIpart; /* number of calls to V1LIpart() */
+  VIEWPAIR *pair;  /* obstructed pairs found by this thread [0:maxPair-1] */
+  IX nPair;        /* number of pairs in pair[] */
+  IX maxPair;      /* allocated length of pair[] */
+  IX head, tail;   /* deque of job pairs: index + k*nThrd, head <= k < tail */
+  void *lock;      /* protects head and tail */
+  } VIEWTHRD;
+
+typedef struct viewjob    /* view factor calculation data for all threads */
+  {
+  SRFDAT3D *srf;   /* surface / vertex data for all surfaces */
+  const IX *base;  /* base surface numbers */
+  BOXTREE *tree;   /* bounding box tree of possible obstructions */
+  IX *maskSrf;     /* list of mask and null surfaces */
+  R8 **AF;         /* array of Area * F values */
+  VIEWTHRD *thrd;  /* data for each thread [0:nThrd-1] */
+  IX nThrd;        /* number of threads */
+  IX n1, nn;       /* first and last rows */
+  IX m1;           /* first column */
+  IX nextRow;      /* next row to be processed */
+  R4 nAFdone;      /* number of view factors started */
+  R4 nAFtot;       /* total number of view factors to compute */
+  void *lock;      /* protects nextRow, nAFdone, and nPairDone */
+  IX defer;        /* 1 = save obstructed pairs for later scheduling */
+  VIEWPAIR *pair;  /* obstructed pairs, most costly first [0:nPair-1] */
+  IX nPair;        /* number of obstructed pairs */
+  IX nPairDone;    /* number of obstructed pairs started */
+  IX preset;       /* 1 = AF values >= 0 are set before the rows */
+  UX nFarPair;     /* number of far-field cluster pairs */
+  UX nAFfar;       /* number of AF set from far-field clusters */
+  } VIEWJOB;
+
+typedef struct viewfar    /* data for the far-field clusters */
+  {
+  VIEWJOB *job;    /* view factor calculation data */
+  BOXTREE *tree;   /* bounding box tree (clusters) of radiating surfaces */
+  IX *list;        /* radiating surfaces [1:tree->nItem] */
+  IX *obstr;       /* possible obstructions near two clusters */
+  I1 *facing;      /* 1 = surface faces the other cluster [1:nRadSrf] */
+  R4 eps;          /* error limit */
+  UX nPair;        /* number of cluster pairs */
+  UX nAF;          /* number of AF set from cluster pairs */
+  } VIEWFAR;
+
 void ViewMethod( SRFDATNM *srfN, SRFDATNM *srfM, R4 distNM, VFCTRL *vfCtrl );
 void InitViewMethod( VFCTRL *vfCtrl );
+void ViewThrdInit( VIEWTHRD *thrd, VFCTRL *vfCtrl, IX init );
+void ViewRows( void *job, IX index );
+IX ViewNextRow( VIEWJOB *job );
+void ViewRow( VIEWJOB *job, VIEWTHRD *thrd, IX n );
+void ViewObstrN( VIEWJOB *job, VIEWTHRD *thrd, IX n );
+void ViewPair( VIEWJOB *job, VIEWTHRD *thrd, IX n, IX m );
+R4 ViewCost( SRFDATNM *srfN, SRFDATNM *srfM, R4 distNM, VFCTRL *vfCtrl );
+void ViewSavePair( VIEWTHRD *thrd, IX n, IX m, R4 cost );
+void ViewSchedule( VIEWJOB *job );
+int ViewPairCmp( const void *p1, const void *p2 );
+void ViewPairs( void *job, IX index );
+IX ViewNextPair( VIEWJOB *job, IX index );
+void ViewFar( VIEWJOB *job, VFCTRL *vfCtrl );
+void ViewFarNodes( VIEWFAR *vf, IX a, IX b );
+IX ViewFarTest( VIEWFAR *vf, BOXNODE *na, BOXNODE *nb );
+IX ViewFarSide( VIEWFAR *vf, BOXNODE *na, BOXNODE *nb, R4 tol );
+void ViewFarSet( VIEWFAR *vf, BOXNODE *na, BOXNODE *nb );
+IX ViewFarItems( BOXTREE *tree, BOXNODE *node, IX *first );
+R4 ViewFarSphere( BOXNODE *node, V3D *ctr );
 
 extern IX _list;    /* output control, higher value = more output */
 extern FILE *_ulog; /* log file */
 extern I1 _string[]; /* buffer for a character string */
 extern I1 *methods[]; /* method abbreviations */
+extern THRDLOCAL U4 _usedV1LIpart;  /* number of calls to V1LIpart() */
 
-IX _row=0;  /* row number; save for errorf() */
-IX _col=0;  /* column number; " */
+THRDLOCAL IX _row=0;  /* row number; save for errorf() */
+THRDLOCAL IX _col=0;  /* column number; " */
 R4 _sli4;   /* use SLI if rcRatio > 4 and relSep > _sli4 */
 R4 _sai4;   /* use SAI if rcRatio > 4 and relSep > _sai4 */
 R4 _sai10;  /* use SAI if rcRatio > 10 and relSep > _sai10 */
@@ -56,6 +181,17 @@ R4 _sli1;   /* use SLI if relSep > _sli1 */
  *  | [4][1] | [4][2] | [4][3] | [4][4] |  - 
  *  +--------+--------+--------+--------+----
  *  |  ...   |  ...   |  ...   |  ...   | ...
+ *
+ *  The rows are distributed over vfCtrl->nThreads threads.  Each thread 
+ *  has its own copy of vfCtrl holding its work areas, so the AF values 
+ *  do not depend on the number of threads.
+ *
+ *  The time for an obstructed view factor can be orders of magnitude 
+ *  greater than for an unobstructed one, so rows are poorly balanced.  
+ *  With several threads the rows are first processed for the zero and 
+ *  unobstructed view factors while the obstructed pairs are saved with 
+ *  an estimate of their cost.  Those pairs are then sorted, most costly 
+ *  first, dealt to the threads, and processed with work stealing.
  */
 
 void View3D( SRFDAT3D *srf, const IX *base, IX *possibleObstr,
@@ -67,70 +203,73 @@ void View3D( SRFDAT3D *srf, const IX *base, IX *possibleObstr,
  * vfCtrl - control values consolitated into structure
  */
   {
+  VIEWJOB job;     /* data shared by all threads */
+  VIEWTHRD *thrd;  /* data for one thread */
   IX n;  /* row */
   IX m;  /* column */
-  IX n1=1, nn;     /* first and last rows */
-  IX m1=1, mm;     /* first and last columns */
-  IX *maskSrf;     /* list of mask and null surfaces */
-  IX *possibleObstrN;  /* list of possible obstructions rel. to N */
-  IX *probableObstr;   /* list of probable obstructions */
-  IX nPossN;       /* number of possible obstructions rel. to N */
-  IX nProb;        /* number of probable obstructions */
-  IX mayView;      /* true if surfaces may view each other */
-  SRFDATNM srfN,   /* row N surface */
-           srfM,   /* column M surface */
-          *srf1,   /* view from srf1 to srf2 -- */
-          *srf2;   /*   one is srfN, the other is srfM. */
-  VECTOR3D vNM;    /* vector between centroids of srfN and srfM */
-  R4 distNM;       /* distance between centroids of srfN and srfM */
-  R4 minArea;      /* area of smaller surface */
+  IX t;  /* thread */
+  IX mm;           /* last column */
+  IX i, j;
   UX nAF0=0,       /* number of AF which must equal 0 */
      nAFnO=0,      /* number of AF without obstructing surfaces */
      nAFwO=0,      /* number of AF with obstructing surfaces */
-     nObstr=0;     /* total number of obstructions considered */
-  UX **bins;       /* for statistical summary */
-  R4 nAFtot=1;     /* total number of view factors to compute */
-  IX maxSrfT=4;    /* max number of participating (transformed) surfaces */
+     nObstr=0,     /* total number of obstructions considered */
+     nVisClear=0,  /* number of views proven clear */
+     nVisBlock=0,  /* number of views proven blocked */
+     nVisPart=0;   /* number of views needing ViewObstructed() */
+  UX bins[7][6];   /* for statistical summary */
+  U4 usedV1LIpart=0;  /* number of calls to V1LIpart() */
 
 #if( DEBUG > 0 && _MSC_VER == 0 )
   fprintf( _ulog, "At start of View3D - %s", MemRem( _string ) );
 #endif
 
-  nn = vfCtrl->nRadSrf;
-  if( nn>1 )
-    nAFtot = (R4)((nn-1)*nn);
-  if( vfCtrl->row > 0 )
+  memset( &job, 0, sizeof(VIEWJOB) );
+  job.srf = srf;
+  job.base = base;
+  job.tree = BoxTreeInit( srf, possibleObstr, vfCtrl->nPossObstr );
+  vfCtrl->orient = OrientInit( srf, vfCtrl->nRadSrf, vfCtrl->nAllSrf,
+    possibleObstr, vfCtrl->nPossObstr );
+  job.AF = AF;
+  job.n1 = job.m1 = 1;
+  job.nn = vfCtrl->nRadSrf;
+  if( vfCtrl->rowEnd > 0 )
+    {
+    job.n1 = vfCtrl->row;        /* can process a range of rows, */
+    job.nn = vfCtrl->rowEnd;
+    }
+  job.nAFtot = (R4)(job.nn-1)*job.nn - (R4)(job.n1-2)*(job.n1-1);
+  if( job.nAFtot < 1 )
+    job.nAFtot = 1;
+  if( vfCtrl->row > 0 && vfCtrl->rowEnd == 0 )
     {
-    n1 = nn = vfCtrl->row;   /* can process a single row of view factors, */
+    job.n1 = job.nn = vfCtrl->row;   /* can process a single row of view factors, */
     if( vfCtrl->col > 0 )
-      m1 = vfCtrl->col;      /* or a single view factor, */
+      job.m1 = vfCtrl->col;      /* or a single view factor, */
     }
 
-  ViewsInit( 4, 1 );  /* initialize Gaussian integration coefficients */ 
+  job.nThrd = ThrdCount();
+  if( (vfCtrl->row > 0 && vfCtrl->rowEnd == 0) || _list > 2 )  /* detailed output */
+    job.nThrd = 1;
+  vfCtrl->nThreads = job.nThrd;
   InitViewMethod( vfCtrl );
-
-  possibleObstrN = Alc_V( 1, vfCtrl->nAllSrf, sizeof(IX), "possibleObstrN" );
-  probableObstr = Alc_V( 1, vfCtrl->nAllSrf, sizeof(IX), "probableObstr" );
-
-  vfCtrl->srfOT = Alc_V( 0, maxSrfT, sizeof(SRFDAT3X), "srfOT" );
-  bins = Alc_MC( 0, 4, 1, 5, sizeof(UX), "bins" );
   vfCtrl->failConverge = 0;
   
   if( vfCtrl->nMaskSrf ) /* pre-process view masking surfaces */
     {
-    maskSrf = Alc_V( 1, vfCtrl->nMaskSrf, sizeof(IX), "mask" );
+    job.maskSrf = Alc_V( 1, vfCtrl->nMaskSrf, sizeof(IX), "mask" );
     for( m=1,n=vfCtrl->nRadSrf; n; n-- )   /* set mask list */
       if( srf[n].type == MASK || srf[n].type == NULS )
-        maskSrf[m++] = n;
-    DumpOS( "Mask and Null surfaces:", vfCtrl->nMaskSrf, maskSrf );
+        job.maskSrf[m++] = n;
+    DumpOS( "Mask and Null surfaces:", vfCtrl->nMaskSrf, job.maskSrf );
 
-    for( n=n1; n<=nn; n++ )
+    for( n=job.n1; n<=job.nn; n++ )
       {
       if( vfCtrl->col )
-        mm = m1 + 1;
+        mm = job.m1 + 1;
       else
         mm = n;
-      for( m=m1; m<mm; m++ )   /* set all AF involving mask/null */
+      for( m=job.m1; m<mm; m++ )   /* set all AF involving mask/null */
         if( srf[n].type == MASK || srf[n].type == NULS )
           if( base[n] == m )
             AF[n][m] = srf[n].area;
@@ -141,214 +280,99 @@ void View3D( SRFDAT3D *srf, const IX *base, IX *possibleObstr,
         else
           AF[n][m] = -1.0;     /* set AF flag values */
       }
+    job.preset = 1;
+    }
+
+  if( vfCtrl->epsFar > 0.0 )  /* pre-process far-field clusters */
+    {
+    if( vfCtrl->row > 0 || vfCtrl->nMaskSrf )
+      error( 1, __FILE__, __LINE__,
+        "Far-field clusters need all rows and no mask surfaces", "" );
+    else
+      ViewFar( &job, vfCtrl );
     }
 
+  vfCtrl->quad = SrfQuadInit( vfCtrl->nAllSrf, job.nThrd );
+  vfCtrl->polyMem = Alc_V( 0, ThrdCount()-1, sizeof(POLYMEM), "polyMem" );
+  job.thrd = Alc_V( 0, job.nThrd-1, sizeof(VIEWTHRD), "thrd" );
+  for( t=0; t<job.nThrd; t++ )  /* allocate work areas of each thread */
+    ViewThrdInit( job.thrd+t, vfCtrl, 1 );
+
 #if( DEBUG > 0 && _MSC_VER == 0 )
   fprintf( _ulog, "After View3D allocations - %s", MemRem( _string ) );
   MemWalk();
 #endif
 
-  for( n=n1; n<=nn; n++ )  /* process AF values for row N */
+  if( job.nThrd > 1 )      /* process rows, longest rows first */
     {
-    _row = n;
-    if( nn == vfCtrl->nRadSrf )  /* progress display */
+    job.lock = ThrdLockAlc( );
+    job.nextRow = job.nn;
+    job.defer = 1;
+    ThrdRun( ViewRows, &job );
+    job.defer = 0;
+    ViewSchedule( &job );
+    if( job.nPair > 0 )    /* process obstructed pairs */
       {
-      R4 pctDone = 100 * (R4)((n-1)*n) / nAFtot;
-      fprintf( stderr, "\rSurface: %d; ~ %.1f %% complete", n, pctDone );
+      ThrdRun( ViewPairs, &job );
+      Fre_V( job.pair, 0, job.nPair-1, sizeof(VIEWPAIR), "pair" );
       }
-    AF[n][n] = 0.0;
-    nPossN = vfCtrl->nPossObstr;  /* remove obstructions behind N */
-    memcpy( possibleObstrN+1, possibleObstr+1, nPossN*sizeof(IX) );
-    nPossN = OrientationTestN( srf, n, vfCtrl, possibleObstrN, nPossN );
-    if( vfCtrl->col )  /* set column limits */
-      mm = m1 + 1;
-    else if( vfCtrl->row > 0 )
-      mm = vfCtrl->nRadSrf + 1;
-    else
-      mm = n;
-
-    for( m=m1; m<mm; m++ )   /* compute view factor: row N, columns M */
-      {
-      if( vfCtrl->nMaskSrf && AF[n][m] >= 0.0 ) continue;
-      _col = m;
-      if( _list>2 )
-        fprintf( _ulog, "*ROW %d, COL %d\n", _row, _col );
-
-      mayView = SelfObstructionTest3D( srf+n, srf+m, &srfM );
-      if( mayView )
-        mayView = SelfObstructionTest3D( srf+m, srf+n, &srfN );
-      if( mayView )
-        {
-        if( srfN.area * srfM.area == 0.0 )  /* must clip one or both surfces */
-          {
-          if( srfN.area + srfM.area == 0.0 )
-            {
-            IntersectionTest( &srfN, &srfM );  /* check invalid geometry */
-            SelfObstructionClip( &srfN );
-            SelfObstructionClip( &srfM );
-            }
-          else if( srfN.area == 0.0 )
-            SelfObstructionClip( &srfN );
-          else if( srfM.area == 0.0 )
-            SelfObstructionClip( &srfM );
-          }
-        if( vfCtrl->col && _list>3 )
-          {
-          IX j;
-          fprintf( _ulog, "Surface centroid, radius, area:\n" );
-          fprintf( _ulog, "    ctd:  x       y       z     radius    area\n" );
-          fprintf( _ulog, "N:%4d %7.4f %7.4f %7.4f %7.4f %10.3e\n", srfN.nr,
-                   srfN.ctd.x, srfN.ctd.y, srfN.ctd.z, srfN.rc, srfN.area );
-          fprintf( _ulog, "M:%4d %7.4f %7.4f %7.4f %7.4f %10.3e\n", srfM.nr,
-                   srfM.ctd.x, srfM.ctd.y, srfM.ctd.z, srfM.rc, srfM.area );
-          fprintf( _ulog, "    v: x       y       z\n" );
-          for( j=0; j<srfN.nv; j++ )
-            fprintf( _ulog, "N%d: %7.4f %7.4f %7.4f\n",
-                     j, srfN.v[j].x, srfN.v[j].y, srfN.v[j].z );
-          for( j=0; j<srfM.nv; j++ )
-            fprintf( _ulog, "M%d: %7.4f %7.4f %7.4f\n",
-                     j, srfM.v[j].x, srfM.v[j].y, srfM.v[j].z );
-          fflush( _ulog );
-          }
-        VECTOR( (&srfN.ctd), (&srfM.ctd), (&vNM) );
-        distNM = VLEN( (&vNM) );
-        if( distNM < 1.0e-5 * (srfN.rc + srfM.rc) )
-          errorf( 3, __FILE__, __LINE__, "Surfaces have same centroids", "" );
-
-        nProb = nPossN;
-        memcpy( probableObstr+1, possibleObstrN+1, nProb*sizeof(IX) );
-        if( nProb )
-          nProb = ConeRadiusTest( srf, &srfN, &srfM,
-            vfCtrl, probableObstr, nProb, distNM );
-
-        if( nProb )
-          nProb = BoxTest( srf, &srfN, &srfM, vfCtrl, probableObstr, nProb );
-
-        if( nProb )   /* test/set obstruction orientations */
-          nProb = OrientationTest( srf, &srfN, &srfM,
-            vfCtrl, probableObstr, nProb );
-
-        if( vfCtrl->nMaskSrf ) /* add masking surfaces */
-          nProb = AddMaskSrf( srf, &srfN, &srfM, maskSrf, base,
-            vfCtrl, probableObstr, nProb );
-        vfCtrl->nProbObstr = nProb;
-
-        if( vfCtrl->nProbObstr )    /*** obstructed view factors ***/
-          {
-          SRFDAT3X subs[5];    /* subsurfaces of surface 1  */
-          IX j, nSubSrf;       /* count / number of subsurfaces */
-          R8 calcAF = 0.0;
-                               /* set direction of projection */
-          if( ProjectionDirection( srf, &srfN, &srfM,
-              probableObstr, vfCtrl ) > 0 )
-            { srf1 = &srfN; srf2 = &srfM; }
-          else
-            { srf1 = &srfM; srf2 = &srfN; }
-          if( vfCtrl->nProbObstr && _list>2 )
-            {
-            if( vfCtrl->col && _list>3 )
-              fprintf( _ulog, " Project rays from srf %d to srf %d\n",
-                srf1->nr, srf2->nr );
-            DumpOS( " Final LOS:", vfCtrl->nProbObstr, probableObstr );
-            }
-          if( vfCtrl->nProbObstr > maxSrfT ) /* expand srfOT array */
-            {
-            Fre_V( vfCtrl->srfOT, 0, maxSrfT, sizeof(SRFDAT3X), "srfOT" );
-            maxSrfT = vfCtrl->nProbObstr + 4;
-            vfCtrl->srfOT = Alc_V( 0, maxSrfT, sizeof(SRFDAT3X), "srfOT" );
-            }
-          CoordTrans3D( srf, srf1, srf2, probableObstr, vfCtrl );
-
-          nSubSrf = Subsurface( &vfCtrl->srf1T, subs );
-          for( vfCtrl->failRecursion=j=0; j<nSubSrf; j++ )
-            {
-            minArea = MIN( subs[j].area, vfCtrl->srf2T.area );
-            vfCtrl->epsAF = minArea * vfCtrl->epsAdap;
-            if( subs[j].nv == 3 )
-              calcAF += ViewTP( subs[j].v, subs[j].area, 0, vfCtrl );
-            else 
-              calcAF += ViewRP( subs[j].v, subs[j].area, 0, vfCtrl );
-            }
-          AF[n][m] = calcAF * srf2->rc * srf2->rc;   /* area scaling factor */
-          if( vfCtrl->failRecursion )
-            {
-            fprintf( _ulog, " row %d, col %d,  recursion did not converge, AF %g\n",
-              _row, _col, AF[n][m] );
-            vfCtrl->failConverge = 1;
-            }
-          nObstr += vfCtrl->nProbObstr;
-          nAFwO += 1;
-          vfCtrl->method = 5;
-          }
-
-        else                      /*** unobstructed view factors ***/
-          {
-          SRFDATNM *srf1;  /* pointer to surface 1 (smaller surface) */
-          SRFDATNM *srf2;  /* pointer to surface 2 */
-          vfCtrl->method = 5;
-          vfCtrl->failViewALI = 0;
-          if( srfN.rc >= srfM.rc )
-            { srf1 = &srfM; srf2 = &srfN; }
-          else
-            { srf1 = &srfN; srf2 = &srfM; }
-          ViewMethod( &srfN, &srfM, distNM, vfCtrl );
-          minArea = MIN( srfN.area, srfM.area );
-          vfCtrl->epsAF = minArea * vfCtrl->epsAdap;
-          AF[n][m] = ViewUnobstructed( vfCtrl, _row, _col );
-          if( vfCtrl->failViewALI )
-            {
-            fprintf( _ulog, " row %d, col %d,  line integral did not converge, AF %g\n",
-              _row, _col, AF[n][m] );
-            vfCtrl->failConverge = 1;
-            }
-          if( vfCtrl->method<5 ) // ???
-            bins[vfCtrl->method][vfCtrl->nEdgeDiv] += 1;   /* count edge divisions */
-          nAFnO += 1;
-          }
-        }
-      else
-        {                         /* view not possible */
-        AF[n][m] = 0.0;
-        nAF0 += 1;
-        vfCtrl->method = 6;
-        }
-
-      if( srf[n].area > srf[m].area )  /* remove very small values */
-        {
-        if( AF[n][m] < 1.0e-8 * srf[n].area )
-          AF[n][m] = 0.0;
-        }
-      else
-        if( AF[n][m] < 1.0e-8 * srf[m].area )
-          AF[n][m] = 0.0;
-
-      if( _list>2 )
-        {
-        fprintf( _ulog, " AF(%d,%d): %.7e %.7e %.7e %s\n", _row, _col,
-          AF[n][m], AF[n][m] / srf[n].area, AF[n][m] / srf[m].area,
-          methods[vfCtrl->method] );
-        fflush( _ulog );
-        }
-
-      }  /* end of element M of row N */
-
-    }  /* end of row N */
+    job.lock = ThrdLockFre( job.lock );
+    }
+  else                     /* process rows in sequence */
+    {
+    job.nextRow = job.n1;
+    ViewRows( &job, 0 );
+    }
   fputc( '\n', stderr );
 
+  memset( bins, 0, sizeof(bins) );
+  for( t=0; t<job.nThrd; t++ )  /* sum results of all threads */
+    {
+    thrd = job.thrd + t;
+    nAF0 += thrd->nAF0;
+    nAFnO += thrd->nAFnO;
+    nAFwO += thrd->nAFwO;
+    nObstr += thrd->nObstr;
+    nVisClear += thrd->nVisClear;
+    nVisBlock += thrd->nVisBlock;
+    nVisPart += thrd->nVisPart;
+    for( i=0; i<7; i++ )
+      for( j=1; j<6; j++ )
+        bins[i][j] += thrd->bins[i][j];
+    usedV1LIpart += thrd->usedV1LIpart;
+    vfCtrl->usedV1LIadapt += thrd->vfCtrl.usedV1LIadapt;
+    vfCtrl->wastedVObs += thrd->vfCtrl.wastedVObs;
+    vfCtrl->usedVObs += thrd->vfCtrl.usedVObs;
+    vfCtrl->savedVObs += thrd->vfCtrl.savedVObs;
+    vfCtrl->totPoly += thrd->vfCtrl.totPoly;
+    vfCtrl->totVpt += thrd->vfCtrl.totVpt;
+    if( thrd->vfCtrl.failConverge )
+      vfCtrl->failConverge = 1;
+    ViewThrdInit( thrd, vfCtrl, 0 );
+    }
+
   fprintf( _ulog, "\nSurface pairs where F(i,j) must be zero: %8u\n", nAF0 );
+  if( vfCtrl->epsFar > 0.0 )
+    {
+    fprintf( _ulog, "\nSurface pairs from far-field clusters:   %8u\n",
+      job.nAFfar );
+    fprintf( _ulog, "Far-field cluster pairs:                 %8u\n",
+      job.nFarPair );
+    }
   fprintf( _ulog, "\nSurface pairs without obstructed views:  %8u\n", nAFnO );
   bins[4][5] = bins[0][5] + bins[1][5] + bins[2][5] + bins[3][5];
-  fprintf( _ulog, "   nd %7s %7s %7s %7s %7s\n",
-    methods[0], methods[1], methods[2], methods[3], methods[4] );
-  fprintf( _ulog, "    2 %7u %7u %7u %7u %7u direct\n",
-     bins[0][2], bins[1][2], bins[2][2], bins[3][2], bins[4][2] );
+  fprintf( _ulog, "   nd %7s %7s %7s %7s %7s %7s %7s\n", methods[0], methods[1],
+    methods[2], methods[3], methods[4], methods[5], methods[6] );
+  fprintf( _ulog, "    2 %7u %7u %7u %7u %7u %7u %7u direct\n", bins[0][2],
+     bins[1][2], bins[2][2], bins[3][2], bins[4][2], bins[5][2], bins[6][2] );
   fprintf( _ulog, "    3 %7u %7u %7u %7u\n",
      bins[0][3], bins[1][3], bins[2][3], bins[3][3] );
   fprintf( _ulog, "    4 %7u %7u %7u %7u\n",
      bins[0][4], bins[1][4], bins[2][4], bins[3][4] );
   fprintf( _ulog, "  fix %7u %7u %7u %7u %7u fixes\n",
      bins[0][5], bins[1][5], bins[2][5], bins[3][5], bins[4][5] );
-  ViewsInit( 4, 0 );
+  fprintf( _ulog, "Total line integral points evaluated:    %8lu\n",
+    usedV1LIpart );
   fprintf( _ulog, "Adaptive line integral evaluations used: %8lu\n",
     vfCtrl->usedV1LIadapt );
   fprintf( _ulog, "\nSurface pairs with obstructed views:   %10u\n", nAFwO );
@@ -360,6 +384,8 @@ void View3D( SRFDAT3D *srf, const IX *base, IX *possibleObstr,
       vfCtrl->usedVObs );
     fprintf( _ulog, "Adaptive viewpoint evaluations lost:   %10u\n",
       vfCtrl->wastedVObs );
+    fprintf( _ulog, "Adaptive viewpoint evaluations saved:  %10lu\n",
+      vfCtrl->savedVObs );
     fprintf( _ulog, "Non-zero viewpoint evaluations:        %10u\n",
       vfCtrl->totVpt );
 /***fprintf( _ulog, "Number of 1AI point-polygon evaluations: %8u\n",
@@ -367,6 +393,13 @@ void View3D( SRFDAT3D *srf, const IX *base, IX *possibleObstr,
     fprintf( _ulog, "Average number of polygons per viewpoint:  %6.2f\n\n",
       (R8)vfCtrl->totPoly / (R8)vfCtrl->totVpt );
     }
+  if( vfCtrl->visTest )
+    {
+    fprintf( _ulog, "Visibility pre-test of obstructed pairs:\n" );
+    fprintf( _ulog, "   proven clear:   %10u\n", nVisClear );
+    fprintf( _ulog, "   proven blocked: %10u\n", nVisBlock );
+    fprintf( _ulog, "   partial:        %10u\n\n", nVisPart );
+    }
 
   if( vfCtrl->failConverge ) error( 1, __FILE__, __LINE__,
     "Some calculations did not converge, see VIEW3D.LOG", "" );
@@ -376,11 +409,14 @@ void View3D( SRFDAT3D *srf, const IX *base, IX *possibleObstr,
   fprintf( _ulog, "Minimum %s", MemRem( _string ) );
 #endif
   if( vfCtrl->nMaskSrf ) /* pre-process view masking surfaces */
-    Fre_V( maskSrf, 1, vfCtrl->nMaskSrf, sizeof(IX), "mask" );
-  Fre_MC( bins, 0, 4, 1, 5, sizeof(IX), "bins" );
-  Fre_V( vfCtrl->srfOT, 0, maxSrfT, sizeof(SRFDAT3X), "srft" );
-  Fre_V( probableObstr, 1, vfCtrl->nAllSrf, sizeof(IX), "probableObstr" );
-  Fre_V( possibleObstrN, 1, vfCtrl->nAllSrf, sizeof(IX), "possibleObstrN" );
+    Fre_V( job.maskSrf, 1, vfCtrl->nMaskSrf, sizeof(IX), "mask" );
+  Fre_V( job.thrd, 0, job.nThrd-1, sizeof(VIEWTHRD), "thrd" );
+  for( t=0; t<ThrdCount(); t++ )
+    FreePolygonMem( vfCtrl->polyMem+t );
+  Fre_V( vfCtrl->polyMem, 0, ThrdCount()-1, sizeof(POLYMEM), "polyMem" );
+  job.tree = BoxTreeFree( job.tree );
+  vfCtrl->quad = SrfQuadFree( vfCtrl->quad, vfCtrl->nAllSrf );
+  vfCtrl->orient = OrientFree( vfCtrl->orient, vfCtrl->nAllSrf );
   Fre_V( possibleObstr, 1, vfCtrl->nAllSrf, sizeof(IX), "possibleObstr" );
 #if( DEBUG > 0 && _MSC_VER == 0 )
   fprintf( _ulog, "At end of View3D - %s", MemRem( _string ) );
@@ -388,6 +424,850 @@ void View3D( SRFDAT3D *srf, const IX *base, IX *possibleObstr,
 
   }  /* end of View3D */
 
+/***  ViewThrdInit.c  ********************************************************/
+
+/*  Allocate (init = 1) or free (init = 0) the work areas of one thread.
+ *  The thread gets a copy of vfCtrl with its counters cleared.  */
+
+void ViewThrdInit( VIEWTHRD *thrd, VFCTRL *vfCtrl, IX init )
+  {
+  VFCTRL *ctrl=&thrd->vfCtrl;  /* control values of this thread */
+
+  if( init )
+    {
+    memcpy( ctrl, vfCtrl, sizeof(VFCTRL) );
+    ctrl->usedV1LIadapt = 0;
+    ctrl->wastedVObs = 0;
+    ctrl->usedVObs = 0;
+    ctrl->savedVObs = 0;
+    ctrl->totPoly = 0;
+    ctrl->totVpt = 0;
+    ctrl->failConverge = 0;
+    ctrl->maxSrfT = 4;
+    ctrl->srfOT = Alc_V( 0, ctrl->maxSrfT, sizeof(SRFDAT3X), "srfOT" );
+    ctrl->NrelS = Alc_V( 1, ctrl->nAllSrf, sizeof(IX), "NrelS" );
+    ctrl->MrelS = Alc_V( 1, ctrl->nAllSrf, sizeof(IX), "MrelS" );
+    ViewsInit( 7, 1, ctrl );
+    if( vfCtrl->nThreads > 1 )
+      thrd->lock = ThrdLockAlc( );
+    thrd->probableObstr = Alc_V( 1, ctrl->nAllSrf, sizeof(IX),
+      "probableObstr" );
+    thrd->frontN = Alc_V( 1, ctrl->nAllSrf, sizeof(I1), "frontN" );
+    }
+
+  else
+    {
+    Fre_V( thrd->frontN, 1, ctrl->nAllSrf, sizeof(I1), "frontN" );
+    Fre_V( thrd->probableObstr, 1, ctrl->nAllSrf, sizeof(IX),
+      "probableObstr" );
+    if( thrd->lock )
+      thrd->lock = ThrdLockFre( thrd->lock );
+    ViewsInit( 7, 0, ctrl );
+    Fre_V( ctrl->MrelS, 1, ctrl->nAllSrf, sizeof(IX), "MrelS" );
+    Fre_V( ctrl->NrelS, 1, ctrl->nAllSrf, sizeof(IX), "NrelS" );
+    Fre_V( ctrl->srfOT, 0, ctrl->maxSrfT, sizeof(SRFDAT3X), "srfOT" );
+    }
+
+  }  /* end ViewThrdInit */
+
+/***  ViewRows.c  ************************************************************/
+
+/*  Thread function:  process rows of view factors until none remain.  */
+
+void ViewRows( void *job, IX index )
+  {
+  VIEWJOB *vj=(VIEWJOB *)job;
+  U4 usedV1LIpart=_usedV1LIpart;  /* V1LIpart() calls at start */
+  IX n;  /* row */
+
+  if( index >= vj->nThrd ) return;
+  while( (n = ViewNextRow( vj )) > 0 )
+    ViewRow( vj, vj->thrd+index, n );
+  vj->thrd[index].usedV1LIpart += _usedV1LIpart - usedV1LIpart;
+
+  }  /* end ViewRows */
+
+/***  ViewNextRow.c  *********************************************************/
+
+/*  Return the next row to be processed; 0 when all are done.
+ *  Several threads take the rows from the longest (last) to the shortest 
+ *  for better balance at the end; one thread works in row order.  */
+
+IX ViewNextRow( VIEWJOB *job )
+  {
+  IX n;  /* row */
+
+  if( job->lock )
+    ThrdLock( job->lock );
+  if( job->nThrd > 1 )
+    {
+    n = job->nextRow--;
+    if( n < job->n1 ) n = 0;
+    }
+  else
+    {
+    n = job->nextRow++;
+    if( n > job->nn ) n = 0;
+    }
+  if( n && job->m1 == 1 && job->n1 < job->nn )  /* progress display */
+    {
+    R4 pctDone = 100 * job->nAFdone / job->nAFtot;
+    fprintf( stderr, "\rSurface: %d; ~ %.1f %% complete", n, pctDone );
+    job->nAFdone += 2 * (n-1);
+    }
+  if( job->lock )
+    ThrdUnlock( job->lock );
+
+  return n;
+
+  }  /* end ViewNextRow */
+
+/***  ViewRow.c  *************************************************************/
+
+/*  Compute the view factors of row N.  */
+
+void ViewRow( VIEWJOB *job, VIEWTHRD *thrd, IX n )
+/* job  - data for all threads.
+ * thrd - data for this thread.
+ * n    - row number.
+ */
+  {
+  VFCTRL *vfCtrl=&thrd->vfCtrl;  /* control values of this thread */
+  IX m;  /* column */
+  IX m1=job->m1, mm;       /* first and last columns */
+
+  job->AF[n][n] = 0.0;
+  if( vfCtrl->col )  /* set column limits */
+    mm = m1 + 1;
+  else if( vfCtrl->row > 0 && vfCtrl->rowEnd == 0 )
+    mm = vfCtrl->nRadSrf + 1;
+  else
+    mm = n;
+
+  for( m=m1; m<mm; m++ )   /* compute view factor: row N, columns M */
+    {
+    if( job->preset && job->AF[n][m] >= 0.0 ) continue;
+    ViewPair( job, thrd, n, m );
+    }
+
+  }  /* end of ViewRow */
+
+/***  ViewObstrN.c  **********************************************************/
+
+/*  Set thrd->frontN[] for row N:  1 for each possible obstruction which 
+ *  is not totally behind surface N.  */
+
+void ViewObstrN( VIEWJOB *job, VIEWTHRD *thrd, IX n )
+  {
+  VFCTRL *vfCtrl=&thrd->vfCtrl;  /* control values of this thread */
+  IX *list=thrd->probableObstr;  /* work area */
+  IX nPossN;       /* number of possible obstructions rel. to N */
+  IX i;
+
+  nPossN = job->tree->nItem;
+  if( nPossN < 1 ) return;
+  for( i=1; i<=nPossN; i++ )
+    thrd->frontN[job->tree->list[i]] = 0;
+  memcpy( list+1, job->tree->list+1, nPossN*sizeof(IX) );
+  nPossN = OrientationTestN( job->srf, n, vfCtrl, list, nPossN );
+  for( i=1; i<=nPossN; i++ )
+    thrd->frontN[list[i]] = 1;
+  thrd->rowN = n;
+
+  }  /* end of ViewObstrN */
+
+/***  ViewPair.c  ************************************************************/
+
+/*  Compute the view factor of row N, column M.  When job->defer is set, 
+ *  an obstructed view factor is saved for ViewSchedule() instead.  */
+
+void ViewPair( VIEWJOB *job, VIEWTHRD *thrd, IX n, IX m )
+/* job  - data for all threads.
+ * thrd - data for this thread.
+ * n    - row number.
+ * m    - column number.
+ */
+  {
+  SRFDAT3D *srf=job->srf;  /* surface / vertex data for all surfaces */
+  R8 **AF=job->AF;         /* array of Area * F values */
+  VFCTRL *vfCtrl=&thrd->vfCtrl;  /* control values of this thread */
+  IX *probableObstr=thrd->probableObstr;
+  IX nProb;        /* number of probable obstructions */
+  IX mayView;      /* true if surfaces may view each other */
+  IX visible;      /* -1 = view blocked; 0 = partial */
+  SRFDATNM srfN,   /* row N surface */
+           srfM,   /* column M surface */
+          *srf1,   /* view from srf1 to srf2 -- */
+          *srf2;   /*   one is srfN, the other is srfM. */
+  VECTOR3D vNM;    /* vector between centroids of srfN and srfM */
+  R4 distNM;       /* distance between centroids of srfN and srfM */
+  R4 minArea;      /* area of smaller surface */
+
+  _row = n;
+  _col = m;
+  if( _list>2 )
+    fprintf( _ulog, "*ROW %d, COL %d\n", _row, _col );
+
+  mayView = SelfObstructionTest3D( srf+n, srf+m, &srfM );
+  if( mayView )
+    mayView = SelfObstructionTest3D( srf+m, srf+n, &srfN );
+  if( mayView )
+    {
+    if( srfN.area * srfM.area == 0.0 )  /* must clip one or both surfces */
+      {
+      if( srfN.area + srfM.area == 0.0 )
+        {
+        IntersectionTest( &srfN, &srfM );  /* check invalid geometry */
+        SelfObstructionClip( &srfN );
+        SelfObstructionClip( &srfM );
+        }
+      else if( srfN.area == 0.0 )
+        SelfObstructionClip( &srfN );
+      else if( srfM.area == 0.0 )
+        SelfObstructionClip( &srfM );
+      }
+    if( vfCtrl->col && _list>3 )
+      {
+      IX j;
+      fprintf( _ulog, "Surface centroid, radius, area:\n" );
+      fprintf( _ulog, "    ctd:  x       y       z     radius    area\n" );
+      fprintf( _ulog, "N:%4d %7.4f %7.4f %7.4f %7.4f %10.3e\n", srfN.nr,
+               srfN.ctd.x, srfN.ctd.y, srfN.ctd.z, srfN.rc, srfN.area );
+      fprintf( _ulog, "M:%4d %7.4f %7.4f %7.4f %7.4f %10.3e\n", srfM.nr,
+               srfM.ctd.x, srfM.ctd.y, srfM.ctd.z, srfM.rc, srfM.area );
+      fprintf( _ulog, "    v: x       y       z\n" );
+      for( j=0; j<srfN.nv; j++ )
+        fprintf( _ulog, "N%d: %7.4f %7.4f %7.4f\n",
+                 j, srfN.v[j].x, srfN.v[j].y, srfN.v[j].z );
+      for( j=0; j<srfM.nv; j++ )
+        fprintf( _ulog, "M%d: %7.4f %7.4f %7.4f\n",
+                 j, srfM.v[j].x, srfM.v[j].y, srfM.v[j].z );
+      fflush( _ulog );
+      }
+    VECTOR( (&srfN.ctd), (&srfM.ctd), (&vNM) );
+    distNM = VLEN( (&vNM) );
+    if( distNM < 1.0e-5 * (srfN.rc + srfM.rc) )
+      errorf( 3, __FILE__, __LINE__, "Surfaces have same centroids", "" );
+
+    if( thrd->rowN != n )
+      ViewObstrN( job, thrd, n );
+    nProb = BoxTest( &srfN, &srfM, vfCtrl, job->tree, probableObstr );
+
+    if( nProb )   /* remove obstructions behind N */
+      {
+      IX i, j;
+      for( j=0,i=1; i<=nProb; i++ )
+        if( thrd->frontN[probableObstr[i]] )
+          probableObstr[++j] = probableObstr[i];
+      nProb = j;
+      }
+
+    if( nProb )
+      nProb = ConeRadiusTest( srf, &srfN, &srfM,
+        vfCtrl, probableObstr, nProb, distNM );
+
+    if( nProb )   /* test/set obstruction orientations */
+      nProb = OrientationTest( srf, &srfN, &srfM,
+        vfCtrl, probableObstr, nProb );
+
+    if( nProb )   /* remove obstructions outside hull of N & M */
+      {
+      nProb = SeparationTest( srf, &srfN, &srfM,
+        vfCtrl, probableObstr, nProb );
+      if( !nProb )
+        thrd->nVisClear += 1;
+      }
+
+    if( vfCtrl->nMaskSrf ) /* add masking surfaces */
+      nProb = AddMaskSrf( srf, &srfN, &srfM, job->maskSrf, job->base,
+        vfCtrl, probableObstr, nProb );
+    vfCtrl->nProbObstr = nProb;
+
+    visible = 0;
+    if( nProb && vfCtrl->visTest )  /* prove clear or blocked views */
+      {
+      visible = VisibilityTest( srf, &srfN, &srfM,
+        vfCtrl, probableObstr, nProb );
+      if( visible < 0 )
+        thrd->nVisBlock += 1;
+      else if( !job->defer )
+        thrd->nVisPart += 1;
+      }
+
+    if( visible < 0 )         /*** blocked view factors ***/
+      {
+      AF[n][m] = 0.0;
+      vfCtrl->method = 8;
+      }
+
+    else if( vfCtrl->nProbObstr && job->defer )  /* schedule it later */
+      {
+      ViewSavePair( thrd, n, m, ViewCost( &srfN, &srfM, distNM, vfCtrl ) );
+      return;
+      }
+
+    else if( vfCtrl->nProbObstr )    /*** obstructed view factors ***/
+      {
+      SRFDAT3X subs[5];    /* subsurfaces of surface 1  */
+      IX j, nSubSrf;       /* count / number of subsurfaces */
+      R8 calcAF = 0.0;
+                           /* set direction of projection */
+      if( ProjectionDirection( srf, &srfN, &srfM,
+          probableObstr, vfCtrl ) > 0 )
+        { srf1 = &srfN; srf2 = &srfM; }
+      else
+        { srf1 = &srfM; srf2 = &srfN; }
+      if( vfCtrl->nProbObstr && _list>2 )
+        {
+        if( vfCtrl->col && _list>3 )
+          fprintf( _ulog, " Project rays from srf %d to srf %d\n",
+            srf1->nr, srf2->nr );
+        DumpOS( " Final LOS:", vfCtrl->nProbObstr, probableObstr );
+        }
+      if( vfCtrl->nProbObstr > vfCtrl->maxSrfT ) /* expand srfOT array */
+        {
+        Fre_V( vfCtrl->srfOT, 0, vfCtrl->maxSrfT, sizeof(SRFDAT3X), "srfOT" );
+        vfCtrl->maxSrfT = vfCtrl->nProbObstr + 4;
+        vfCtrl->srfOT = Alc_V( 0, vfCtrl->maxSrfT, sizeof(SRFDAT3X), "srfOT" );
+        }
+      CoordTrans3D( srf, srf1, srf2, probableObstr, vfCtrl );
+      thrd->nObstr += vfCtrl->nProbObstr;
+      vfCtrl->nProbObstr = MergeObstr( vfCtrl );
+
+      nSubSrf = Subsurface( &vfCtrl->srf1T, subs );
+      for( vfCtrl->failRecursion=j=0; j<nSubSrf; j++ )
+        {
+        minArea = MIN( subs[j].area, vfCtrl->srf2T.area );
+        vfCtrl->epsAF = minArea * vfCtrl->epsAdap;
+        if( subs[j].nv == 3 )
+          calcAF += ViewTP( subs[j].v, subs[j].area, 0, vfCtrl );
+        else 
+          calcAF += ViewRP( subs[j].v, subs[j].area, 0, vfCtrl );
+        }
+      AF[n][m] = calcAF * srf2->rc * srf2->rc;   /* area scaling factor */
+      if( vfCtrl->failRecursion )
+        {
+        fprintf( _ulog, " row %d, col %d,  recursion did not converge, AF %g\n",
+          _row, _col, AF[n][m] );
+        vfCtrl->failConverge = 1;
+        }
+      thrd->nAFwO += 1;
+      vfCtrl->method = 7;
+      }
+
+    else                      /*** unobstructed view factors ***/
+      {
+      vfCtrl->method = 7;
+      vfCtrl->failViewALI = 0;
+      ViewMethod( &srfN, &srfM, distNM, vfCtrl );
+      minArea = MIN( srfN.area, srfM.area );
+      vfCtrl->epsAF = minArea * vfCtrl->epsAdap;
+      AF[n][m] = ViewUnobstructed( vfCtrl, _row, _col );
+      if( vfCtrl->failViewALI )
+        {
+        fprintf( _ulog, " row %d, col %d,  line integral did not converge, AF %g\n",
+          _row, _col, AF[n][m] );
+        vfCtrl->failConverge = 1;
+        }
+      if( vfCtrl->method<=EXA ) // ???
+        thrd->bins[vfCtrl->method][vfCtrl->nEdgeDiv] += 1;   /* count edge divisions */
+      thrd->nAFnO += 1;
+      }
+    }
+  else
+    {                         /* view not possible */
+    AF[n][m] = 0.0;
+    thrd->nAF0 += 1;
+    vfCtrl->method = 8;
+    }
+
+  if( srf[n].area > srf[m].area )  /* remove very small values */
+    {
+    if( AF[n][m] < 1.0e-8 * srf[n].area )
+      AF[n][m] = 0.0;
+    }
+  else
+    if( AF[n][m] < 1.0e-8 * srf[m].area )
+      AF[n][m] = 0.0;
+
+  if( _list>2 )
+    {
+    fprintf( _ulog, " AF(%d,%d): %.7e %.7e %.7e %s\n", _row, _col,
+      AF[n][m], AF[n][m] / srf[n].area, AF[n][m] / srf[m].area,
+      methods[vfCtrl->method] );
+    fflush( _ulog );
+    }
+
+  }  /* end of ViewPair */
+
+/***  ViewCost.c  ************************************************************/
+
+/*  Estimate the relative time to compute an obstructed view factor.
+ *  ViewTP() and ViewRP() divide a surface into 4 parts at each level 
+ *  of recursion and project every obstruction at each view point.  
+ *  More levels are needed when the surfaces are close together 
+ *  (small relSep) or of very different sizes (large rcRatio), i.e., 
+ *  when ViewMethod() would select a line integral method.  */
+
+R4 ViewCost( SRFDATNM *srfN, SRFDATNM *srfM, R4 distNM, VFCTRL *vfCtrl )
+/* srfN, srfM - the two surfaces.
+ * distNM - distance between their centroids.
+ * vfCtrl - computation controls; nProbObstr must be set.
+ */
+  {
+  IX nLevel;       /* estimated number of recursion levels */
+  R4 sep;          /* relative separation */
+  R4 cost;
+
+  ViewMethod( srfN, srfM, distNM, vfCtrl );
+  nLevel = vfCtrl->minRecursion + 1;
+  if( vfCtrl->method == SLI || vfCtrl->method == ALI || vfCtrl->method == EXA )
+    nLevel += 1;
+  if( vfCtrl->rcRatio > 4.0f )
+    nLevel += 1;
+  for( sep=vfCtrl->relSep; sep<1.0f && nLevel<vfCtrl->maxRecursion; sep*=2 )
+    nLevel += 1;         /* one more level each time separation halves */
+  if( nLevel > vfCtrl->maxRecursion )
+    nLevel = vfCtrl->maxRecursion;
+
+  for( cost=(R4)vfCtrl->nProbObstr; nLevel>0; nLevel-- )
+    cost *= 4.0f;        /* 4 view points per level */
+
+  return cost;
+
+  }  /* end of ViewCost */
+
+/***  ViewSavePair.c  ********************************************************/
+
+/*  Save an obstructed pair in the list of this thread.  */
+
+void ViewSavePair( VIEWTHRD *thrd, IX n, IX m, R4 cost )
+  {
+  VIEWPAIR *pair;
+
+  if( thrd->nPair == thrd->maxPair )  /* expand pair array */
+    {
+    IX maxPair = thrd->maxPair ? 2 * thrd->maxPair : 256;
+    pair = Alc_V( 0, maxPair-1, sizeof(VIEWPAIR), "pair" );
+    if( thrd->maxPair )
+      {
+      memcpy( pair, thrd->pair, thrd->nPair*sizeof(VIEWPAIR) );
+      Fre_V( thrd->pair, 0, thrd->maxPair-1, sizeof(VIEWPAIR), "pair" );
+      }
+    thrd->pair = pair;
+    thrd->maxPair = maxPair;
+    }
+  pair = thrd->pair + thrd->nPair++;
+  pair->n = n;
+  pair->m = m;
+  pair->cost = cost;
+
+  }  /* end of ViewSavePair */
+
+/***  ViewSchedule.c  ********************************************************/
+
+/*  Collect the obstructed pairs of all threads, sort them with the most 
+ *  costly first, and deal them in turn to the thread deques.  Thread T 
+ *  owns pairs T, T+nThrd, T+2*nThrd, ... so each deque is also sorted.  */
+
+void ViewSchedule( VIEWJOB *job )
+  {
+  VIEWTHRD *thrd;
+  IX t;  /* thread */
+
+  for( job->nPair=t=0; t<job->nThrd; t++ )
+    job->nPair += job->thrd[t].nPair;
+  if( job->nPair > 0 )
+    job->pair = Alc_V( 0, job->nPair-1, sizeof(VIEWPAIR), "pair" );
+
+  for( job->nPair=t=0; t<job->nThrd; t++ )
+    {
+    thrd = job->thrd + t;
+    if( thrd->maxPair )
+      {
+      memcpy( job->pair+job->nPair, thrd->pair, thrd->nPair*sizeof(VIEWPAIR) );
+      job->nPair += thrd->nPair;
+      Fre_V( thrd->pair, 0, thrd->maxPair-1, sizeof(VIEWPAIR), "pair" );
+      thrd->pair = NULL;
+      thrd->nPair = thrd->maxPair = 0;
+      }
+    }
+  if( job->nPair > 1 )
+    qsort( job->pair, job->nPair, sizeof(VIEWPAIR), ViewPairCmp );
+
+  for( t=0; t<job->nThrd; t++ )
+    {
+    thrd = job->thrd + t;
+    thrd->head = 0;
+    thrd->tail = (job->nPair - t + job->nThrd - 1) / job->nThrd;
+    }
+  job->nPairDone = 0;
+
+  }  /* end of ViewSchedule */
+
+/***  ViewPairCmp.c  *********************************************************/
+
+/*  qsort() comparison: decreasing cost, then row and column order.  */
+
+int ViewPairCmp( const void *p1, const void *p2 )
+  {
+  const VIEWPAIR *a=(const VIEWPAIR *)p1;
+  const VIEWPAIR *b=(const VIEWPAIR *)p2;
+
+  if( a->cost > b->cost ) return -1;
+  if( a->cost < b->cost ) return 1;
+  if( a->n != b->n ) return a->n - b->n;
+  return a->m - b->m;
+
+  }  /* end of ViewPairCmp */
+
+/***  ViewPairs.c  ***********************************************************/
+
+/*  Thread function:  process obstructed pairs until none remain.  */
+
+void ViewPairs( void *job, IX index )
+  {
+  VIEWJOB *vj=(VIEWJOB *)job;
+  VIEWTHRD *thrd;
+  U4 usedV1LIpart=_usedV1LIpart;  /* V1LIpart() calls at start */
+  IX k;  /* pair */
+
+  if( index >= vj->nThrd ) return;
+  thrd = vj->thrd + index;
+  while( (k = ViewNextPair( vj, index )) >= 0 )
+    {
+    VIEWPAIR *pair = vj->pair + k;
+    ViewPair( vj, thrd, pair->n, pair->m );
+    }
+  thrd->usedV1LIpart += _usedV1LIpart - usedV1LIpart;
+
+  }  /* end ViewPairs */
+
+/***  ViewNextPair.c  ********************************************************/
+
+/*  Return the next pair to be processed by thread INDEX; -1 when all are 
+ *  done.  The thread takes the most costly pair from the head of its own 
+ *  deque; when that is empty it steals the least costly pair from the 
+ *  tail of another deque.  */
+
+IX ViewNextPair( VIEWJOB *job, IX index )
+  {
+  VIEWTHRD *thrd;
+  IX i, t;  /* thread */
+  IX k=-1;  /* pair */
+
+  for( i=0; i<job->nThrd && k<0; i++ )
+    {
+    t = (index + i) % job->nThrd;
+    thrd = job->thrd + t;
+    ThrdLock( thrd->lock );
+    if( thrd->head < thrd->tail )
+      {
+      if( i == 0 )
+        k = thrd->head++;
+      else
+        k = --thrd->tail;
+      k = t + k * job->nThrd;
+      }
+    ThrdUnlock( thrd->lock );
+    }
+
+  if( k >= 0 )   /* progress display */
+    {
+    ThrdLock( job->lock );
+    job->nPairDone += 1;
+    if( job->nPairDone % 16 == 1 || job->nPairDone == job->nPair )
+      fprintf( stderr, "\rObstructed views: %d of %d   ",
+        job->nPairDone, job->nPair );
+    ThrdUnlock( job->lock );
+    }
+
+  return k;
+
+  }  /* end ViewNextPair */
+
+/***  ViewFar.c  *************************************************************/
+
+/*  Set the view factors between well separated clusters of surfaces.
+ *  The radiating surfaces are clustered by a bounding box tree; pairs of 
+ *  tree nodes are tested from the root down.  Two clusters are far apart 
+ *  when (r1^2+r2^2)/d^2 <= vfCtrl->epsFar, r1 and r2 being the radii of 
+ *  the spheres about their boxes and d the gap between the spheres.  Then 
+ *  the AF between any two members is the point-to-point value 
+ *  A1*A2*cos1*cos2/(pi*r^2) from their centroids; its error is less than 
+ *  about epsFar*A1*A2/(pi*r^2).  The clusters are used only if each member 
+ *  faces all or none of the other cluster and no possible obstruction can 
+ *  cross a line between facing members; otherwise the larger is split.  
+ *  The remaining AF are flagged with -1 for the exact calculation.  */
+
+void ViewFar( VIEWJOB *job, VFCTRL *vfCtrl )
+/* job    - view factor calculation data.
+ * vfCtrl - computation controls.
+ */
+  {
+  VIEWFAR vf;     /* far-field cluster data */
+  IX nList=0;     /* number of clustered surfaces */
+  IX n, m;
+
+  for( n=job->n1; n<=job->nn; n++ )
+    for( m=1; m<n; m++ )
+      job->AF[n][m] = -1.0;     /* set AF flag values */
+
+  memset( &vf, 0, sizeof(VIEWFAR) );
+  vf.job = job;
+  vf.eps = vfCtrl->epsFar;
+  vf.list = Alc_V( 1, vfCtrl->nRadSrf, sizeof(IX), "farList" );
+  vf.obstr = Alc_V( 1, vfCtrl->nAllSrf, sizeof(IX), "farObstr" );
+  vf.facing = Alc_V( 1, vfCtrl->nRadSrf, sizeof(I1), "farFacing" );
+  for( n=1; n<=vfCtrl->nRadSrf; n++ )
+    if( job->srf[n].type == RSRF || job->srf[n].type == SUBS )
+      vf.list[++nList] = n;
+  vf.tree = BoxTreeInit( job->srf, vf.list, nList );
+  if( nList > 1 )
+    ViewFarNodes( &vf, 0, 0 );
+
+  job->nFarPair = vf.nPair;
+  job->nAFfar = vf.nAF;
+  job->preset = 1;
+  vf.tree = BoxTreeFree( vf.tree );
+  Fre_V( vf.facing, 1, vfCtrl->nRadSrf, sizeof(I1), "farFacing" );
+  Fre_V( vf.obstr, 1, vfCtrl->nAllSrf, sizeof(IX), "farObstr" );
+  Fre_V( vf.list, 1, vfCtrl->nRadSrf, sizeof(IX), "farList" );
+
+  }  /* end ViewFar */
+
+/***  ViewFarNodes.c  ********************************************************/
+
+/*  Set the far-field view factors between the surfaces of nodes A and B 
+ *  of the cluster tree, or within node A when A == B.  */
+
+void ViewFarNodes( VIEWFAR *vf, IX a, IX b )
+  {
+  BOXNODE *na=vf->tree->node + a;
+  BOXNODE *nb=vf->tree->node + b;
+  V3D ctr;
+
+  if( a == b )
+    {
+    if( na->count > 0 ) return;  /* leaf: exact calculation */
+    ViewFarNodes( vf, na->first, na->first );
+    ViewFarNodes( vf, na->first + 1, na->first + 1 );
+    ViewFarNodes( vf, na->first, na->first + 1 );
+    return;
+    }
+
+  if( ViewFarTest( vf, na, nb ) )
+    {
+    ViewFarSet( vf, na, nb );
+    return;
+    }
+
+  if( na->count > 0 && nb->count > 0 ) return;  /* exact calculation */
+  if( nb->count > 0 ||
+     (na->count == 0 && ViewFarSphere( na, &ctr ) >= ViewFarSphere( nb, &ctr )) )
+    {                      /* split the larger cluster */
+    ViewFarNodes( vf, na->first, b );
+    ViewFarNodes( vf, na->first + 1, b );
+    }
+  else
+    {
+    ViewFarNodes( vf, a, nb->first );
+    ViewFarNodes( vf, a, nb->first + 1 );
+    }
+
+  }  /* end ViewFarNodes */
+
+/***  ViewFarTest.c  *********************************************************/
+
+/*  Return 1 if the clusters of nodes A and B are far apart and have 
+ *  unobstructed views; set vf->facing[] for their surfaces.  */
+
+IX ViewFarTest( VIEWFAR *vf, BOXNODE *na, BOXNODE *nb )
+  {
+  SRFDAT3D *srf=vf->job->srf;
+  SRFDAT3D *srfK;  /* possible obstruction */
+  BOXNODE *node;
+  V3D ca, cb;      /* centers of clusters A and B */
+  V3D v;
+  R4 ra, rb;       /* radii of clusters A and B */
+  R4 box[6];       /* box enclosing both clusters */
+  R4 dist, ha, hb, h, tol;
+  IX i, j, k, n, first, count, nObstr, side;
+
+  ra = ViewFarSphere( na, &ca );
+  rb = ViewFarSphere( nb, &cb );
+  VECTOR( (&ca), (&cb), (&v) );
+  dist = VLEN( (&v) ) - ra - rb;
+  if( dist <= 0.0 ) return 0;
+  if( ra * ra + rb * rb > vf->eps * dist * dist ) return 0;
+
+  tol = 1.0e-5f * (ra + rb);
+  if( !ViewFarSide( vf, na, nb, tol ) ) return 0;
+  if( !ViewFarSide( vf, nb, na, tol ) ) return 0;
+
+  for( j=0; j<6; j+=2 )
+    {
+    box[j] = MIN( na->lim[j], nb->lim[j] );
+    box[j+1] = MAX( na->lim[j+1], nb->lim[j+1] );
+    }
+  nObstr = BoxTreeFind( vf->job->tree, box, vf->obstr );
+  for( i=1; i<=nObstr; i++ )
+    {
+    srfK = srf + vf->obstr[i];
+    ha = VDOTW( (&ca), (&srfK->dc) );
+    hb = VDOTW( (&cb), (&srfK->dc) );
+    if( (ha >= ra && hb >= rb) || (ha <= -ra && hb <= -rb) ) continue;
+         /* K cannot block lines between vertices on one side of its plane */
+    tol = 1.0e-5f * srfK->rc;
+    side = 0;
+    for( node=na; node; node=(node == na) ? nb : NULL )
+      {
+      count = ViewFarItems( vf->tree, node, &first );
+      for( j=first; j<first+count; j++ )
+        {
+        n = vf->list[vf->tree->item[j]+1];
+        if( !vf->facing[n] || srf + n == srfK ) continue;
+        for( k=0; k<srf[n].nv; k++ )
+          {
+          h = VDOTW( srf[n].v[k], (&srfK->dc) );
+          if( h > tol )
+            side |= 1;
+          else if( h < -tol )
+            side |= 2;
+          }
+        if( side == 3 ) return 0;
+        }
+      }
+    }
+
+  return 1;
+
+  }  /* end ViewFarTest */
+
+/***  ViewFarSide.c  *********************************************************/
+
+/*  Set vf->facing[] for the surfaces of node NA:  1 if the box of node NB 
+ *  is in front of the surface, 0 if it is behind or in its plane.  
+ *  Return 0 if the box is on both sides of any surface.  */
+
+IX ViewFarSide( VIEWFAR *vf, BOXNODE *na, BOXNODE *nb, R4 tol )
+  {
+  SRFDAT3D *srf=vf->job->srf;
+  R4 *lim=nb->lim;
+  V3D v;      /* corner of box NB */
+  R4 h, hmin, hmax;  /* heights of the corners above a surface */
+  IX i, j, n, first, count;
+
+  count = ViewFarItems( vf->tree, na, &first );
+  for( j=first; j<first+count; j++ )
+    {
+    n = vf->list[vf->tree->item[j]+1];
+    hmin = 1.0e30f;
+    hmax = -1.0e30f;
+    for( i=0; i<8; i++ )
+      {
+      v.x = lim[i & 1];
+      v.y = lim[2 + ((i >> 1) & 1)];
+      v.z = lim[4 + (i >> 2)];
+      h = VDOTW( (&v), (&srf[n].dc) );
+      if( h < hmin ) hmin = h;
+      if( h > hmax ) hmax = h;
+      }
+    if( hmin >= -tol )
+      vf->facing[n] = (hmax > tol) ? 1 : 0;
+    else if( hmax <= tol )
+      vf->facing[n] = 0;
+    else
+      return 0;
+    }
+
+  return 1;
+
+  }  /* end ViewFarSide */
+
+/***  ViewFarSet.c  **********************************************************/
+
+/*  Set the point-to-point AF values between the surfaces of nodes 
+ *  NA and NB; zero unless both surfaces face the other cluster.  */
+
+void ViewFarSet( VIEWFAR *vf, BOXNODE *na, BOXNODE *nb )
+  {
+  SRFDAT3D *srf=vf->job->srf;
+  R8 **AF=vf->job->AF;
+  V3D v;      /* vector between centroids */
+  R8 af, d2, cn, cm;
+  IX i, j, n, m, firstA, countA, firstB, countB;
+
+  countA = ViewFarItems( vf->tree, na, &firstA );
+  countB = ViewFarItems( vf->tree, nb, &firstB );
+  for( i=firstA; i<firstA+countA; i++ )
+    {
+    n = vf->list[vf->tree->item[i]+1];
+    for( j=firstB; j<firstB+countB; j++ )
+      {
+      m = vf->list[vf->tree->item[j]+1];
+      af = 0.0;
+      if( vf->facing[n] && vf->facing[m] )
+        {
+        VECTOR( (&srf[n].ctd), (&srf[m].ctd), (&v) );
+        d2 = VDOT( (&v), (&v) );
+        cn = VDOT( (&v), (&srf[n].dc) );    /* distance * cosine */
+        cm = -VDOT( (&v), (&srf[m].dc) );
+        if( cn > 0.0 && cm > 0.0 )
+          af = PIinv * srf[n].area * srf[m].area * cn * cm / (d2 * d2);
+        }
+      if( n > m )
+        AF[n][m] = af;
+      else
+        AF[m][n] = af;
+      }
+    }
+  vf->nAF += countA * countB;
+  vf->nPair += 1;
+
+  }  /* end ViewFarSet */
+
+/***  ViewFarItems.c  ********************************************************/
+
+/*  Return the number of items in NODE; FIRST is the first in tree->item[].
+ *  The items of a node are contiguous because BoxTreeSplit() partitions 
+ *  the item range of each node between its two children.  */
+
+IX ViewFarItems( BOXTREE *tree, BOXNODE *node, IX *first )
+  {
+  BOXNODE *lo=node, *hi=node;
+
+  while( lo->count == 0 )
+    lo = tree->node + lo->first;
+  while( hi->count == 0 )
+    hi = tree->node + hi->first + 1;
+  *first = lo->first;
+
+  return hi->first + hi->count - lo->first;
+
+  }  /* end ViewFarItems */
+
+/***  ViewFarSphere.c  *******************************************************/
+
+/*  Set CTR to the center of the box of NODE; return the radius of the 
+ *  sphere about the box.  */
+
+R4 ViewFarSphere( BOXNODE *node, V3D *ctr )
+  {
+  R4 *lim=node->lim;
+  V3D v;
+
+  ctr->x = 0.5f * (lim[0] + lim[1]);
+  ctr->y = 0.5f * (lim[2] + lim[3]);
+  ctr->z = 0.5f * (lim[4] + lim[5]);
+  v.x = 0.5f * (lim[1] - lim[0]);
+  v.y = 0.5f * (lim[3] - lim[2]);
+  v.z = 0.5f * (lim[5] - lim[4]);
+
+  return VLEN( (&v) );
+
+  }  /* end ViewFarSphere */
+
 /***  ProjectionDirection.c  *************************************************/
 
 /*  Set direction of projection of obstruction shadows.
@@ -435,13 +1315,13 @@ IX ProjectionDirection( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
       {
       R4 dist;
       k = probableObstr[j];
-      if( srf[k].NrelS >= 0 )
+      if( vfCtrl->NrelS[k] >= 0 )
         {
         VECTOR( (&srfN->ctd), (&srf[k].ctd), (&v) );
         dist = VDOT( (&v), (&v) );
         if( dist<sdtoN ) sdtoN = dist;
         }
-      if( srf[k].MrelS >= 0 )
+      if( vfCtrl->MrelS[k] >= 0 )
         {
         VECTOR( (&srfM->ctd), (&srf[k].ctd), (&v) );
         dist = VDOT( (&v), (&v) );
@@ -474,8 +1354,8 @@ IX ProjectionDirection( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
     for( j=1; j<=vfCtrl->nProbObstr; j++ )
       {
       k = probableObstr[j];
-      if( srf[k].NrelS >= 0 ) nosN++;
-      if( srf[k].MrelS >= 0 ) nosM++;
+      if( vfCtrl->NrelS[k] >= 0 ) nosN++;
+      if( vfCtrl->MrelS[k] >= 0 ) nosM++;
       }
     if( nosN > nosM )
       direction = +1;
@@ -494,11 +1374,11 @@ IX ProjectionDirection( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
   k = 0;         /* eliminate probableObstr surfaces facing wrong direction */
   if( direction > 0 )  /* projections from N toward M */
     for( j=1; j<=vfCtrl->nProbObstr; j++ )
-      if( srf[probableObstr[j]].MrelS >= 0 )
+      if( vfCtrl->MrelS[probableObstr[j]] >= 0 )
         probableObstr[++k] = probableObstr[j];
   if( direction < 0 )  /* projections from M toward N */
     for( j=1; j<=vfCtrl->nProbObstr; j++ )
-      if( srf[probableObstr[j]].NrelS >= 0 )
+      if( vfCtrl->NrelS[probableObstr[j]] >= 0 )
         probableObstr[++k] = probableObstr[j];
   vfCtrl->nProbObstr = k;
 
@@ -521,12 +1401,17 @@ void ViewMethod( SRFDATNM *srfN, SRFDATNM *srfM, R4 distNM, VFCTRL *vfCtrl )
     { srf1 = srfN; srf2 = srfM; }
   memcpy( &vfCtrl->srf1T, srf1, sizeof(SRFDAT3X) );
   memcpy( &vfCtrl->srf2T, srf2, sizeof(SRFDAT3X) );
+  vfCtrl->clip1 = srf1->clip;
+  vfCtrl->clip2 = srf2->clip;
 
   vfCtrl->rcRatio = srf2->rc / srf1->rc;
   vfCtrl->relSep = distNM / (srf1->rc + srf2->rc);
 
   vfCtrl->method = UNK;
-  if( vfCtrl->rcRatio > 4.0f )
+  if( srf1->shape == 4 && srf2->shape == 4 && vfCtrl->relSep < RCTSEP &&
+      RectPair( &vfCtrl->srf1T, &vfCtrl->srf2T ) )
+    vfCtrl->method = RCT;
+  if( vfCtrl->method==UNK && vfCtrl->rcRatio > 4.0f )
     {
     if( srf1->shape )
       {
@@ -549,6 +1434,8 @@ void ViewMethod( SRFDATNM *srfN, SRFDATNM *srfM, R4 distNM, VFCTRL *vfCtrl )
     vfCtrl->method = ALI;
   if( vfCtrl->method==UNK )
     vfCtrl->method = ALI;
+  if( vfCtrl->method==ALI && vfCtrl->relSep < RCTSEP )
+    vfCtrl->method = EXA;
 
 #if( DEBUG > 1 )
   fprintf( _ulog, "  rcRatio %.3f,  relSep %.2f, shapes %d %d, method %d\n",
@@ -617,6 +1504,7 @@ IX errorf( IX severity, I1 *file, IX line, ... )
  * ...;       string variables (up to 80 char total) */
   {
   va_list argp;     /* variable argument list */
+  I1 string[LINELEN];  /* message buffer; _string is not thread safe */
   I1 start[]=" ";
   I1 *msg, *s;
   static I1 *head[4] = { "  *** note *** ",
@@ -628,18 +1516,18 @@ IX errorf( IX severity, I1 *file, IX line, ... )
   if( severity >= 0 )
     {
     if( severity>3 ) severity = 3;
-    StrCpyS( _string, LINELEN, head[severity], "      file/function: ",
+    StrCpyS( string, LINELEN, head[severity], "      file/function: ",
       file, ",    line: ", IntStr( line ), "\n", "" );
-    fputs( _string, stderr );
+    fputs( string, stderr );
     if( _ulog != NULL && _ulog != stderr )
       {
-      fputs( _string, _ulog );
+      fputs( string, _ulog );
       fflush( _ulog );
       }
 
     msg = start;   /* merge message strings */
-    sprintf( _string, "row %d, col %d; ", _row, _col );
-    s = _string;
+    sprintf( string, "row %d, col %d; ", _row, _col );
+    s = string;
     while( *s )
       s++;
     va_start( argp, line );
@@ -653,9 +1541,9 @@ IX errorf( IX severity, I1 *file, IX line, ... )
     *s = '\0';
     va_end( argp );
 
-    fputs( _string, stderr );
+    fputs( string, stderr );
     if( _ulog != NULL && _ulog != stderr )
-      fputs( _string, _ulog );
+      fputs( string, _ulog );
     }
 
   if( severity>2 ) exit( 1 );
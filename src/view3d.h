@@ -55,6 +55,12 @@ typedef struct v3d       /* structure for a 3D vertex or vector */
 #define VERTEX3D V3D
 #define VECTOR3D V3D
 
+typedef struct cplx      /* structure for a complex number */
+  {
+  R8  re;  /* real part */
+  R8  im;  /* imaginary part */
+  } CPLX;
+
 /* vector macros using pointer to 3-element structures */
 
 /*  VECTOR:  define vector C from vertex A to vextex B.  */
@@ -111,10 +117,6 @@ typedef struct srfdat3d       /* structure for 3D surface data */
   DIRCOS dc;          /* direction cosines of surface normal */
   VERTEX3D ctd;       /* coordinates of centroid */
   VERTEX3D *v[MAXNV]; /* pointers to coordinates of up to MAXNV vertices */
-  IX NrelS;           /* orientation of srf N relative to S:
-                         -1: N behind S; +1: N in front of S;
-                          0: part of N behind S, part in front */
-  IX MrelS;           /* orientation of srf M relative to S */
   IX type;            /* surface type data - defined below */
   } SRFDAT3D;
 
@@ -135,6 +137,7 @@ typedef struct srfdatnm       /* structure for 3D surface data */
   VERTEX3D ctd;       /* coordinates of centroid */
   VERTEX3D v[MAXNV1]; /* coordinates of vertices */
   R4 dist[MAXNV1];    /* distances of vertices above plane of other surface */
+  IX clip;            /* 1 = clipped by SelfObstructionClip() */
   } SRFDATNM;
 
 typedef struct srfdat3x       /* structure for 3D surface data */
@@ -165,6 +168,49 @@ typedef struct edgediv    /* structure for Gaussian division of polygon edge */
   R4  s;  /* length of element */
   } EDGEDIV;
 
+typedef struct srfquad  /* quadrature data of one surface; see SrfQuad() */
+  {
+  IX iPt[5];          /* points gpt[iPt[n-1]] to gpt[iPt[n]-1] for nDiv = n */
+  VERTEX3D gpt[30];   /* Gaussian points of the area, nDiv = 1 to 4 */
+  R4 wt[30];          /* Gaussian weights * area */
+  EDGEDCS rc[MAXNV];  /* direction cosines and lengths of the edges */
+  EDGEDIV *dv[4][MAXNV];    /* edge divisions for nDiv = 1 to 4 */
+  EDGEDIV ediv[MAXNV][10];  /* storage of dv[][] */
+  IX nNest;           /* number of nested points of SubSrfNested() */
+  VERTEX3D npt[17];   /* nested points of the area */
+  R4 nwt[17];         /* fine nested weights * area */
+  R4 nwl[17];         /* coarse nested weights * area */
+  EDGEDIV *ndv[MAXNV];      /* nested edge divisions of DivideEdgesNested() */
+  EDGEDIV nediv[MAXNV][7];  /* storage of ndv[] */
+  IX iSoa[5];         /* points sx[iSoa[n-1]] to sx[iSoa[n]-1] for nDiv = n */
+  R8 sx[36], sy[36], sz[36];  /* gpt[] as arrays, each nDiv padded to SOAW */
+  R8 sw[36];          /* wt[]; 0 for padding */
+  } SRFQUAD;
+
+typedef struct quadcache  /* quadrature data of all surfaces */
+  {
+  SRFQUAD **srf;      /* data of each unclipped surface [1:nAllSrf]; 
+                         NULL until first used */
+  I1 *mem;            /* memory blocks of the SRFQUAD structures */
+  void *lock;         /* lock to add an entry; NULL = one thread */
+  } QUADCACHE;
+
+typedef struct orient   /* orientations of surfaces and possible obstructions */
+  {
+  IX nRow;            /* number of rows: surfaces 1 to nRow */
+  IX nCol;            /* number of columns: possible obstructions */
+  IX *col;            /* column of each possible obstruction [1:nAllSrf] */
+  U1 *rel;            /* relations of surface S and obstruction K in 2-bit 
+                         fields [0:nRow*nCol-1]; row S-1, column col[K] */
+  } ORIENT;
+
+#define ORNO  0   /* relation false for any eps <= 1.0e-5 * S.rc */
+#define ORYES 1   /* relation true for any eps <= 1.0e-5 * S.rc */
+#define ORTST 2   /* relation depends on eps; test the vertices */
+#define SFRONT(c)  ((c) & 3)         /* a vertex of S in front of K */
+#define SBEHIND(c) (((c) >> 2) & 3)  /* a vertex of S behind K */
+#define KFRONT(c)  (((c) >> 4) & 3)  /* a vertex of K in front of S */
+
 typedef struct          /* view factor calculation control values */
   {
   IX nAllSrf;       /* total number of surfaces */
@@ -176,12 +222,15 @@ typedef struct          /* view factor calculation control values */
   IX format;        /* geometry format: 3 or 4 */
   IX outFormat;     /* output file format */
   IX row;           /* row to solve; 0 = all rows */
+  IX rowEnd;        /* last row of a range of rows (row to rowEnd) */
   IX col;           /* column to solve; 0 = all columns */
   IX enclosure;     /* 1 = surfaces form an enclosure */
   IX emittances;    /* 1 = process emittances */
   IX nPossObstr;    /* number of possible view obstructing surfaces */
   IX nProbObstr;    /* number of probable view obstructing surfaces */
   IX prjReverse;    /* projection control; 0 = normal, 1 = reverse */
+  IX visTest;       /* 1 = prove views clear or blocked before projection */
+  R4 epsFar;        /* error limit of far-field clusters; 0 = not used */
   R4 epsAdap;       /* convergence for adaptive integration */
   R4 rcRatio;       /* rRatio of surface radii */
   R4 relSep;        /* surface separation / sum of radii */
@@ -196,6 +245,7 @@ typedef struct          /* view factor calculation control values */
   R4 epsAF;         /* convergence for current AF calculation */
   U4 wastedVObs;    /* number of ViewObstructed() calculations wasted */
   U4 usedVObs;      /* number of ViewObstructed() calculations used */
+  U4 savedVObs;     /* number of ViewObstructed() calculations saved */
   U4 totPoly;       /* total number of polygon view factors */
   U4 totVpt;        /* total number of view points */
   IX failConverge;  /* 1 if any calculation failed to converge */
@@ -205,6 +255,22 @@ typedef struct          /* view factor calculation control values */
   SRFDAT3X *srfOT;  /* pointer to array of view obstrucing surfaces;
                        dimensioned from 0 to maxSrfT in View3d();
                        coordinates transformed relative to srf2T. */
+  IX maxSrfT;       /* max number of participating (transformed) surfaces */
+  IX *NrelS;        /* orientation of srf N relative to obstruction S:
+                       -1: N behind S; +1: N in front of S;
+                        0: part of N behind S, part in front */
+  IX *MrelS;        /* orientation of srf M relative to obstruction S */
+  EDGEDCS *rc1;     /* edge DirCos of surface 1 */
+  EDGEDCS *rc2;     /* edge DirCos of surface 2 */
+  EDGEDIV **dv1;    /* edge divisions of surface 1 */
+  EDGEDIV **dv2;    /* edge divisions of surface 2 */
+  QUADCACHE *quad;  /* quadrature data of unclipped surfaces */
+  IX clip1;         /* 1 = srf1T clipped; quad not valid */
+  IX clip2;         /* 1 = srf2T clipped; quad not valid */
+  struct polymem *polyMem;  /* polygon processing memory of each thread;
+                       [0:ThrdCount()-1], index by ThrdIndex() */
+  IX nThreads;      /* number of threads for view factor calculation */
+  ORIENT *orient;   /* orientation table; NULL = not set */
   } VFCTRL;
 
 #define UNK -1  /* unknown integration method */
@@ -213,6 +279,10 @@ typedef struct          /* view factor calculation control values */
 #define DLI 2   /* double line integration */
 #define SLI 3   /* single line integration */
 #define ALI 4   /* adaptive line integration */
+#define RCT 5   /* closed-form rectangle formulas */
+#define EXA 6   /* exact polygon contour integral */
+#define RCTSEP 10.0f  /* use RCT or EXA if relSep < RCTSEP; the closed 
+                         forms lose accuracy to round-off at large relSep */
 
 typedef struct hcve   /* homogeneous coordinate description of vertex/edge */
   {
@@ -230,6 +300,56 @@ typedef struct poly   /* description of a polygon */
   R4 area;            /* area of the polygon */
   } POLY;
 
+typedef struct polymem  /* polygon processing memory; one for each thread */
+  {
+  I1 *memPoly;        /* memory block for polygon descriptions; start NULL */
+  HCVE *nextFreeVE;   /* pointer to next free vertex/edge */
+  POLY *nextFreePD;   /* pointer to next free polygon descripton */
+  POLY *nextUsedPD;   /* pointer to top-of-stack used polygon */
+  R4 epsDist;         /* minimum distance between vertices */
+  R4 epsArea;         /* minimum surface area */
+  } POLYMEM;
+
+typedef struct boxnode  /* node of a bounding box tree */
+  {
+  R4 lim[6];          /* xmin, xmax, ymin, ymax, zmin, zmax of the node */
+  IX first;           /* leaf: first item; other: first of 2 child nodes */
+  IX count;           /* leaf: number of items; 0 = not a leaf */
+  } BOXNODE;
+
+typedef struct boxtree  /* bounding box tree of surfaces or vertices */
+  {
+  IX nItem;           /* number of items in the tree */
+  IX *list;           /* surface numbers [1:nItem]; the list order */
+  IX *item;           /* positions in list, ordered by tree [0:nItem-1] */
+  R4 *lim;            /* limits of each item, as in BOXNODE [0:6*nItem-1] */
+  IX nNode;           /* number of nodes */
+  BOXNODE *node;      /* nodes [0:2*nItem-1]; node 0 is the root */
+  IX leaf;            /* maximum number of items in a leaf */
+  } BOXTREE;
+
+/* storage class for data private to each thread */
+#if( _MSC_VER )
+# define THRDLOCAL __declspec(thread)
+#else
+# define THRDLOCAL __thread
+#endif
+
+/* structure-of-arrays kernels:  lanes per block of View2AIsoa() */
+#define SOAW 4
+
+/* Vector kernels are compiled for several instruction sets when the 
+ * compiler supports it; the best one for the processor is selected at 
+ * run time.  Floating point exception flags are not used, so selections 
+ * in their loops need not be branches. */
+#if( defined(__GNUC__) && __GNUC__ >= 6 && defined(__x86_64__) \
+  && defined(__linux__) )
+# define SIMDCLONES __attribute__((target_clones("avx512f","avx2","default"), \
+    optimize("O3","no-trapping-math")))
+#else
+# define SIMDCLONES
+#endif
+
 /* macros for simple mathematical operations */
 #define MAX(a,b)  (((a) > (b)) ? (a) : (b))   /* max of 2 values */
 #define MIN(a,b)  (((a) < (b)) ? (a) : (b))   /* min of 2 values */
@@ -1,5 +1,43 @@
 /*subfile:  viewobs.c  *******************************************************/
 /*                                                                           */
+/*  View3D, Copyright (c) 2018 Alliance for Sustainable Energy, LLC          */
+/*  All rights reserved.                                                     */
+/*                                                                           */
+/*  Redistribution and use in source and binary forms, with or without       */
+/*  modification, are permitted provided that the following conditions are   */
+/*  met:                                                                     */
+/*                                                                           */
+/*  1. Redistributions of source code must retain the above copyright        */
+/*     notice, this list of conditions and the following disclaimer.         */
+/*                                                                           */
+/*  2. Redistributions in binary form must reproduce the above copyright     */
+/*     notice, this list of conditions and the following disclaimer in the   */
+/*     documentation and/or other materials provided with the distribution.  */
+/*                                                                           */
+/*  3. The name of the copyright holder(s), any contributors, the United     */
+/*     States Government, the United States Department of Energy, or any of  */
+/*     their employees may not be used to endorse or promote products        */
+/*     derived from this software without specific prior written permission  */
+/*     from the respective party.                                            */
+/*                                                                           */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) AND ANY             */
+/*  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,   */
+/*  BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND        */
+/*  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE   */
+/*  COPYRIGHT HOLDER(S), ANY CONTRIBUTORS, THE UNITED STATES GOVERNMENT, OR  */
+/*  THE UNITED STATES DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE   */
+/*  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR      */
+/*  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF     */
+/*  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR          */
+/*  BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,    */
+/*  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR  */
+/*  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF   */
+/*  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                               */
+/*                                                                           */
+/*  This file has been modified from the original public domain version.     */
+/*                                                                           */
+/*  Original NIST Disclaimer:                                                */
+/*                                                                           */
 /*  This software was developed at the National Institute of Standards       */
 /*  and Technology by employees of the Federal Government in the             */
 /*  course of their official duties. Pursuant to title 17 Section 105        */
@@ -32,9 +70,74 @@
 # endif
 #endif
 
+#define SHDMAX 32   /* maximum number of shadows to order */
+
+typedef struct shdkey    /* sort key of an obstruction shadow */
+  {
+  R4 cover;        /* estimated area of base window covered */
+  IX nvs;          /* number of shadow vertices */
+  VERTEX2D vs[MAXNV1+1];  /* vertices of shadow before LimitPolygon() */
+  } SHDKEY;
+
+#define MAXNVPT 17  /* maximum number of view points */
+
+typedef struct vobspts   /* view points of ViewObstructed() */
+  {
+  VFCTRL *vfCtrl;  /* control values of the calling thread */
+  VERTEX2D vb[MAXNV1];  /* 2D vertices: base surface (2) */
+  IX nvb;          /* number of vertices of base surface */
+  R4 xmin, xmax, ymin, ymax;  /* clipping limits */
+  R4 epsDist, epsArea;
+  VERTEX3D vpt[MAXNVPT];  /* vertices of view points */
+  R4 weight[MAXNVPT];     /* fine integration weighting factors */
+  R4 wlow[MAXNVPT];       /* coarse integration weighting factors */
+  IX nvpt;                /* number of view points */
+  R8 dFv[MAXNVPT];   /* F from each view point to all unshaded areas */
+  U4 nVpt[MAXNVPT];  /* 1 if the view point sees some of surface 2 */
+  U4 nPoly[MAXNVPT]; /* number of unshaded polygons */
+  } VOBSPTS;
+
+#define V1AIBLK 64  /* maximum number of edges in a V1AIEDG batch */
+
+typedef struct v1aiedg   /* polygon edges seen from a view point */
+  {
+  IX ne;              /* number of edges */
+  IX np;              /* number of polygons */
+  IX nv[V1AIBLK];     /* number of edges of each polygon */
+  R4 ax[V1AIBLK], ay[V1AIBLK], az[V1AIBLK];  /* vectors from view point 
+                         to first vertex of each edge */
+  R4 bx[V1AIBLK], by[V1AIBLK], bz[V1AIBLK];  /* ... to second vertex */
+  R8 term[V1AIBLK];   /* line integral of each edge */
+  } V1AIEDG;
+
+typedef struct vsubsrf   /* subsurface of ViewTP() or ViewRP() */
+  {
+  VFCTRL vfCtrl;   /* copy of control values; separate counters */
+  VERTEX3D v[4];   /* vertices of subsurface */
+  IX nv;           /* number of vertices: 3 or 4 */
+  IX level;        /* recursion level */
+  R4 area;         /* area of subsurface */
+  R8 AF;           /* computed AF */
+  R8 AFc;          /* coarse AF */
+  } VSUBSRF;
+
      /* local functions */
 void SubsrfRS( IX n, VERTEX3D v[], VERTEX3D s[] );
 void SubsrfTS( IX n, VERTEX3D v[], VERTEX3D s[] );
+void ViewObsPoint( void *arg, IX np );
+IX ViewObsShadow( VOBSPTS *vp, IX np, SRFDAT3X *srfT, VERTEX2D *vs );
+IX ViewObsCover( VOBSPTS *vp, IX nvs, VERTEX2D *vs );
+R8 ViewAdapt( IX nv, VERTEX3D v1[], R4 area, IX level, R8 AF, R8 AFc,
+  VFCTRL *vfCtrl );
+R8 ViewSubsrfs( IX nv, VERTEX3D v1[], R4 area, IX level, R8 AFp,
+  VFCTRL *vfCtrl );
+void ViewSubsrfEval( void *arg, IX n );
+void ViewSubsrf( void *arg, IX n );
+void V1AIadd( V1AIEDG *edg, const IX nv, const VERTEX3D p2[],
+  const VERTEX3D *p1 );
+SIMDCLONES void V1AIedges( V1AIEDG *edg, const DIRCOS *u1 );
+void ViewObsPolys( V1AIEDG *edg, const DIRCOS *u1, POLY *pp, R4 weight,
+  R8 *dFv );
 
 extern FILE *_ulog; /* written output file */
 
@@ -44,36 +147,23 @@ extern FILE *_ulog; /* written output file */
 /***  ViewObstructed.c  ******************************************************/
 
 /*  Compute view factor (AF), with view obstructions
- *  by computing views to unshaded polygons.  */
+ *  by computing views to unshaded polygons.  
+ *  The view points are independent and are shared with idle threads;
+ *  their results are summed in view point order.  The view points form 
+ *  a nested rule:  return the fine AF and set *AFl to the coarse AF 
+ *  computed from the same view points.  */
 
-R8 ViewObstructed( VFCTRL *vfCtrl, IX nv1, VERTEX3D v1[], R4 area, IX nDiv )
+R8 ViewObstructed( VFCTRL *vfCtrl, IX nv1, VERTEX3D v1[], R4 area, R8 *AFl )
 /* nv1  - number of vertices of surface 1.
  * v1   - vertices of surface 1.
  * area - area of surface 1.
- * nDiv - division factor, 3 or 4. */
+ * AFl  - coarse AF. */
   {
-  POLY *pp;     /* pointer to a polygon */
-  POLY *shade;  /* pointer to the obstruction shadow polygon */
-  POLY *stack;  /* pointer to stack of unobstructed polygons */
-  POLY *next;   /* pointer to next unobstructed polygons */
-  R8 dF,   /* F from a view point to an unshaded area */
-    dFv,   /* F from a view point to all unshaded areas */
-    AFu;   /* AF from all view points to all unshaded areas */
-  VERTEX3D v2[MAXNVT]; /* 3D vertices: obstruction */
-  VERTEX3D *pv2; /* clipped obstruction */
-  VERTEX2D vs[MAXNV2], vb[MAXNV1]; /* 2D vertices: shadow and base surface (2) */
+  VOBSPTS vp;   /* data for all view points */
+  R8 AFu;  /* AF from all view points to all unshaded areas */
   SRFDAT3X *srfT;  /* pointer to surface */
-  DIRCOS *dc1;  /* pointer to direction cosines of surface 1 */
-  R4 xmin, xmax, ymin, ymax; /* clipping limits */
-  IX clip; /* if true, clip to prevent upward projection */
-  R4 epsDist, epsArea;
-  R4 hc, zc[MAXNV1];  /* surface clipping test values */
-  VERTEX3D vpt[16];  /* vertices of view points */
-  R4 weight[16];     /* integration weighting factors */
-  IX nvpt; /* number of view points */
   IX np;   /* view point number */
-  IX nv2, nvs, nvb;
-  IX j, n;
+  IX n;
 
 #if( DEBUG > 1 )
   fprintf( _ulog, "ViewObstructed:\n" );
@@ -82,189 +172,356 @@ R8 ViewObstructed( VFCTRL *vfCtrl, IX nv1, VERTEX3D v1[], R4 area, IX nDiv )
   NullPointerTest( __FILE__, __LINE__ );
 #endif
 
-  dc1 = &vfCtrl->srf1T.dc;
+  vp.vfCtrl = vfCtrl;
   srfT = &vfCtrl->srf2T;
-  nvb = srfT->nv;
-  for( n=0; n<nvb; n++ )        /* reverse polygon 2 to clockwise */
+  vp.nvb = srfT->nv;
+  for( n=0; n<vp.nvb; n++ )     /* reverse polygon 2 to clockwise */
     {
-    vb[n].x = srfT->v[nvb-1-n].x;
-    vb[n].y = srfT->v[nvb-1-n].y;
+    vp.vb[n].x = srfT->v[vp.nvb-1-n].x;
+    vp.vb[n].y = srfT->v[vp.nvb-1-n].y;
     }
-  xmin = xmax = vb[0].x;
-  ymin = ymax = vb[0].y;
-  for( n=1; n<nvb; n++ )        /* determine polygon 2 to limits */
+  vp.xmin = vp.xmax = vp.vb[0].x;
+  vp.ymin = vp.ymax = vp.vb[0].y;
+  for( n=1; n<vp.nvb; n++ )     /* determine polygon 2 to limits */
     {
-    if( vb[n].x < xmin ) xmin = vb[n].x;
-    if( vb[n].x > xmax ) xmax = vb[n].x;
-    if( vb[n].y < ymin ) ymin = vb[n].y;
-    if( vb[n].y > ymax ) ymax = vb[n].y;
+    if( vp.vb[n].x < vp.xmin ) vp.xmin = vp.vb[n].x;
+    if( vp.vb[n].x > vp.xmax ) vp.xmax = vp.vb[n].x;
+    if( vp.vb[n].y < vp.ymin ) vp.ymin = vp.vb[n].y;
+    if( vp.vb[n].y > vp.ymax ) vp.ymax = vp.vb[n].y;
     }
 #if( DEBUG > 1 )
-  DumpP2D( "Base Surface:", nvb, vb );
-  fprintf( _ulog, "limits:  %f %f   %f %f\n", xmin, xmax, ymin, ymax );
+  DumpP2D( "Base Surface:", vp.nvb, vp.vb );
+  fprintf( _ulog, "limits:  %f %f   %f %f\n", vp.xmin, vp.xmax, vp.ymin, vp.ymax );
 #endif
-  epsDist = 1.0e-6f * (R4)sqrt( (xmax-xmin)*(xmax-xmin) + (ymax-ymin)*(ymax-ymin) );
-  epsArea = 1.0e-6f * srfT->area;
+  vp.epsDist = 1.0e-6f * (R4)sqrt( (vp.xmax-vp.xmin)*(vp.xmax-vp.xmin)
+    + (vp.ymax-vp.ymin)*(vp.ymax-vp.ymin) );
+  vp.epsArea = 1.0e-6f * srfT->area;
 
-        /* determine Gaussian view points of polygon 1 */
-  nvpt = SubSrf( nDiv, nv1, v1, area, vpt, weight );
+        /* determine nested view points of polygon 1 */
+  vp.nvpt = SubSrfNested( nv1, v1, area, vp.vpt, vp.weight, vp.wlow );
 
         /* compute unobstructed view from each view point of polygon 1 */
-  for( AFu=0.0,np=0; np<nvpt; np++ )        /* begin view points loop */
-    {
-    hc = 0.9999f * vpt[np].z;
 #if( DEBUG > 1 )
-    fprintf( _ulog, "view point: %f %f %f\n", vpt[np].x, vpt[np].y, vpt[np].z );
-    fprintf( _ulog, "Hclip %g\n", hc );
-    fflush( _ulog );
+  for( np=0; np<vp.nvpt; np++ )   /* keep the debug output in order */
+    ViewObsPoint( &vp, np );
+#else
+  ThrdTasks( ViewObsPoint, &vp, vp.nvpt );
 #endif
-        /* begin with cleared small structures area - memBlock */
-    InitPolygonMem( epsDist, epsArea );
-    stack = SetPolygonHC( nvb, vb, 1.0 );  /* convert surface 2 to HC */
-#if( DEBUG > 1 )
-    DumpHC( "BASE SURFACE:", stack, NULL );
+  for( AFu=*AFl=0.0,np=0; np<vp.nvpt; np++ )
+    {
+    AFu += vp.weight[np] * vp.dFv[np];
+    *AFl += vp.wlow[np] * vp.dFv[np];
+    vfCtrl->totVpt += vp.nVpt[np];
+    vfCtrl->totPoly += vp.nPoly[np];
+    }
+
+#if( DEBUG > 0 )
+  if( AFu<0.0 )
+    {
+    if( AFu < -1.0e-11 ) errorf( 1, __FILE__, __LINE__,
+      "Negative AFu (", FltStr(AFu,4), ") set to 0", "" );
+    AFu = 0.0;
+    }
 #endif
 
-        /* project shadow of each view obstructing surface */
-    srfT = vfCtrl->srfOT;
-    for( dFv=0.0,j=0; j<vfCtrl->nProbObstr; j++,srfT++ )
-      {                        /* CTD must be behind surface */
-      R4 dot = VDOTW ( (vpt+np), (&srfT->dc) );
 #if( DEBUG > 1 )
-      fprintf( _ulog, "Surface %d;  dot %f\n", srfT->nr, dot );
-      fflush( _ulog );
+  fprintf( _ulog, "v_obst_u AF:  %g\n", AFu );
+  fflush( _ulog );
 #endif
-      if( dot >= 0.0 ) continue;      /* no shadow polygon created */
-      nvs = srfT->nv;
-      for( clip=n=0; n<nvs; n++ )
-        {
-        zc[n] = srfT->v[n].z - hc;
-        if( zc[n] > 0.0 ) clip = 1;
-        }
-      if( clip )        /* clip to prevent upward projection */
-        {
+#if( DEBUG > 0 && _MSC_VER == 0 )
+  NullPointerTest( __FILE__, __LINE__ );
+#endif
+
+  return AFu;
+
+  }  /*  end of ViewObstructed  */
+
+/***  ViewObsPoint.c  ********************************************************/
+
+/*  Compute the view from view point NP to the unshaded parts of surface 2.
+ *  This may run on any thread; it uses the polygon memory of that thread 
+ *  and writes only the NP elements of the view point arrays.
+ *  Up to SHDMAX shadows are processed in order of their estimated coverage
+ *  of the base window so that a heavily shaded view point reaches total obstruction 
+ *  sooner.  A shadow which contains the whole base surface ends the loop 
+ *  without polygon overlap processing.  */
+
+void ViewObsPoint( void *arg, IX np )
+  {
+  VOBSPTS *vp=(VOBSPTS *)arg;  /* data for all view points */
+  VFCTRL *vfCtrl=vp->vfCtrl;
+  POLY *pp;     /* pointer to a polygon */
+  POLY *shade;  /* pointer to the obstruction shadow polygon */
+  POLY *stack;  /* pointer to stack of unobstructed polygons */
+  POLY *next;   /* pointer to next unobstructed polygons */
+  POLY *first;  /* pointer to first polygon of edge batch */
+  POLYMEM *pm;  /* polygon processing memory of this thread */
+  V1AIEDG edg;  /* edges of unshaded polygons */
+  R8 dFv;  /* F from a view point to all unshaded areas */
+  VERTEX3D v2[MAXNVT]; /* 3D vertices: unshaded polygon */
+  VERTEX2D vs[MAXNV2]; /* 2D vertices: shadow */
+  VERTEX3D *vpt=vp->vpt;  /* vertices of view points */
+  SHDKEY key[SHDMAX]; /* shadows in order of coverage */
+  IX order;     /* true if shadows are ordered */
+  DIRCOS *dc1;  /* pointer to direction cosines of surface 1 */
+  R4 xmin, xmax, ymin, ymax;  /* limits of shadow */
+  R4 cover;     /* estimated coverage of base window */
+  IX nKey=0;    /* number of shadows */
+  IX nv2, nvs;
+  IX j, k, n;
+
+  pm = vfCtrl->polyMem + ThrdIndex();
+  dc1 = &vfCtrl->srf1T.dc;
+  vp->dFv[np] = 0.0;
+  vp->nVpt[np] = vp->nPoly[np] = 0;
+
 #if( DEBUG > 1 )
-        fprintf( _ulog, "Clip M;  zc: %g %g %g %g\n",
-          zc[0], zc[1], zc[2], zc[3] );
+  fprintf( _ulog, "view point: %f %f %f\n", vpt[np].x, vpt[np].y, vpt[np].z );
+  fprintf( _ulog, "Hclip %g\n", 0.9999f * vpt[np].z );
+  fflush( _ulog );
 #endif
-        nvs = ClipPolygon( -1.0, nvs, (VERTEX3D *)&srfT->v, zc, v2 );
-        if( nvs < 3 ) continue;                /* no shadow polygon created */
-        pv2 = v2;
+      /* begin with cleared small structures area - memBlock */
+  InitPolygonMem( pm, vp->epsDist, vp->epsArea );
+  stack = SetPolygonHC( pm, vp->nvb, vp->vb, 1.0 );  /* convert surface 2 to HC */
 #if( DEBUG > 1 )
-        DumpP3D( "Clipped surface:", nvs, pv2 );
+  DumpHC( "BASE SURFACE:", stack, NULL );
 #endif
-        }
-      else
-        pv2 = (void *)&srfT->v;
 
-              /* project obstruction from centroid to z=0 plane */
-      for( n=0; n<nvs; n++,pv2++ )
-        {
-        R4 temp = vpt[np].z / (vpt[np].z - pv2->z);  /* projection factor */
-        vs[n].x = vpt[np].x - temp * (vpt[np].x - pv2->x);
-        vs[n].y = vpt[np].y - temp * (vpt[np].y - pv2->y);
-        }
-              /* limit projected surface; avoid some HC problems */
-      nvs = LimitPolygon( nvs, vs, xmax, xmin, ymax, ymin );
-      if( nvs < 3 ) continue;                  /* no shadow polygon created */
-#if( DEBUG > 0 )
-             /* bounds check on projected surface */
+  order = vfCtrl->nProbObstr > 1 && vfCtrl->nProbObstr <= SHDMAX;
+  if( order )    /* order shadows by bounding box coverage of base */
+    {
+    for( j=0; j<vfCtrl->nProbObstr; j++ )
       {
-      R8 temp = 0.0;
-      for( n=0; n<nvs; n++ )
+      nvs = ViewObsShadow( vp, np, vfCtrl->srfOT+j, vs );
+      if( nvs < 3 ) continue;              /* no shadow polygon created */
+      xmin = xmax = vs[0].x;
+      ymin = ymax = vs[0].y;
+      for( n=1; n<nvs; n++ )
         {
-        if( fabs(vs[n].x) > temp ) temp = fabs(vs[n].x);
-        if( fabs(vs[n].y) > temp ) temp = fabs(vs[n].y);
+        if( vs[n].x < xmin ) xmin = vs[n].x;
+        if( vs[n].x > xmax ) xmax = vs[n].x;
+        if( vs[n].y < ymin ) ymin = vs[n].y;
+        if( vs[n].y > ymax ) ymax = vs[n].y;
         }
-      if( temp > 1.01 ) errorf( 1, __FILE__, __LINE__,
-        "Projected surface too large", "" );
-      }
-#endif
-      NewPolygonStack( );
-      shade = SetPolygonHC( nvs, vs, 0.0 );
-      if( shade )
-        {
+      if( xmin < vp->xmin ) xmin = vp->xmin;
+      if( xmax > vp->xmax ) xmax = vp->xmax;
+      if( ymin < vp->ymin ) ymin = vp->ymin;
+      if( ymax > vp->ymax ) ymax = vp->ymax;
+      if( xmax <= xmin || ymax <= ymin ) continue;  /* outside base */
+      if( xmin == vp->xmin && xmax == vp->xmax
+        && ymin == vp->ymin && ymax == vp->ymax )
+        {                          /* test for total obstruction */
+        VERTEX2D vc[MAXNV2];
+        memcpy( vc, vs, nvs*sizeof(VERTEX2D) );
+        n = LimitPolygon( nvs, vc, vp->xmax, vp->xmin, vp->ymax, vp->ymin );
+        if( n >= 3 && ViewObsCover( vp, n, vc ) )
+          {
 #if( DEBUG > 1 )
-        DumpHC( "SHADOW:", shade, NULL );
+          fprintf( _ulog, "Surface %d covers base\n", vfCtrl->srfOT[j].nr );
 #endif
-
-          /* compute unshaded portion of surface 2 polygon */
-        NewPolygonStack( );
-        for( pp=stack; pp; pp=next ) /* determine portions of old polygons */
-          {                          /* outside the shadow polygon. */
-          next = pp->next;              /* must save next to pop old stack */
-          PolygonOverlap( shade, pp, 3, 1 ); /* 1 = popping old stack */
+          return;                  /* polygon 2 is totally obstructed. */
           }
-        stack = TopOfPolygonStack();
-        if( stack==NULL )            /* no new unshaded polygons; so */
-          break;                     /* polygon 2 is totally obstructed. */
+        }
+      cover = (xmax - xmin) * (ymax - ymin);
+      for( k=nKey++; k>0 && key[k-1].cover < cover; k-- )
+        key[k] = key[k-1];         /* insertion sort; largest first */
+      key[k].cover = cover;
+      key[k].nvs = nvs;
+      memcpy( key[k].vs, vs, nvs*sizeof(VERTEX2D) );
+      }
+    }
+  else
+    nKey = vfCtrl->nProbObstr;
 
-#if( DEBUG > 1 )
-        DumpHC( "UNSHADED:", stack, NULL );
+      /* project shadow of each view obstructing surface */
+  for( dFv=0.0,k=0; k<nKey; k++ )
+    {
+    if( order )
+      {
+      nvs = key[k].nvs;
+      memcpy( vs, key[k].vs, nvs*sizeof(VERTEX2D) );
+      }
+    else
+      nvs = ViewObsShadow( vp, np, vfCtrl->srfOT+k, vs );
+    if( nvs < 3 ) continue;                  /* no shadow polygon created */
+            /* limit projected surface; avoid some HC problems */
+    nvs = LimitPolygon( nvs, vs, vp->xmax, vp->xmin, vp->ymax, vp->ymin );
+    if( nvs < 3 ) continue;                  /* no shadow polygon created */
+#if( DEBUG > 0 )
+           /* bounds check on projected surface */
+    {
+    R8 temp = 0.0;
+    for( n=0; n<nvs; n++ )
+      {
+      if( fabs(vs[n].x) > temp ) temp = fabs(vs[n].x);
+      if( fabs(vs[n].y) > temp ) temp = fabs(vs[n].y);
+      }
+    if( temp > 1.01 ) errorf( 1, __FILE__, __LINE__,
+      "Projected surface too large", "" );
+    }
 #endif
-        FreePolygons( shade, NULL ); /* free the shadow polygon */
-        }  /* end shade */
-      }  /* end of obstruction surfaces (J) loop */
-    if( stack == NULL ) continue;
-
-        /* compute interchange area to each unshaded polygon */
-    vfCtrl->totVpt += 1;
-    for( pp=stack; pp; pp=pp->next )
+    if( !order && ViewObsCover( vp, nvs, vs ) )
       {
-      vfCtrl->totPoly += 1;
-      nv2 = GetPolygonVrt3D( pp, v2 );
 #if( DEBUG > 1 )
-      DumpP3D( "Unshaded surface:", nv2, v2 );
+      fprintf( _ulog, "Shadow %d covers base\n", k );
 #endif
-      dF = V1AIpart( nv2, v2, vpt+np, dc1 );
+      stack = NULL;                /* polygon 2 is totally obstructed. */
+      break;
+      }
+    NewPolygonStack( pm );
+    shade = SetPolygonHC( pm, nvs, vs, 0.0 );
+    if( shade )
+      {
 #if( DEBUG > 1 )
-      fprintf( _ulog, " Partial view factor: %g\n", dF );
+      DumpHC( "SHADOW:", shade, NULL );
 #endif
-#if( DEBUG > 0 )
-      if( dF < 0.0 )
-        {
-        if( dF < -1.0e-9 )
-          {
-          errorf( 1, __FILE__, __LINE__,
-            "Negative F (", FltStr(dF,4), ") set to 0", "" );
-# if( DEBUG > 1 )     /* normally 1 */
-          DumpHC( " Polygon", pp, pp );
-          V1AIpart( nv2, v2, vpt+np, dc1 );
-# endif
-          }
-        dF = 0.0;
+
+        /* compute unshaded portion of surface 2 polygon */
+      NewPolygonStack( pm );
+      for( pp=stack; pp; pp=next ) /* determine portions of old polygons */
+        {                          /* outside the shadow polygon. */
+        next = pp->next;              /* must save next to pop old stack */
+        PolygonOverlap( pm, shade, pp, 3, 1 ); /* 1 = popping old stack */
         }
-#endif
-      dFv += dF * weight[np]; 
-      }
+      stack = TopOfPolygonStack( pm );
+      if( stack==NULL )            /* no new unshaded polygons; so */
+        break;                     /* polygon 2 is totally obstructed. */
 
 #if( DEBUG > 1 )
-    fprintf( _ulog, " SS: x %f, y %f, z %f, dFv %g\n",
-      vpt[np].x, vpt[np].y, vpt[np].z, dFv );
+      DumpHC( "UNSHADED:", stack, NULL );
 #endif
-    AFu += dFv;
-    }  /* end of view points loop */
-
-#if( DEBUG > 0 )
-  if( AFu<0.0 )
+      FreePolygons( pm, shade, NULL ); /* free the shadow polygon */
+      }  /* end shade */
+    }  /* end of obstruction surfaces (K) loop */
+  if( stack == NULL ) return;
+
+      /* compute interchange area to each unshaded polygon; 
+       * the edges of several polygons are processed together. */
+  vp->nVpt[np] += 1;
+  edg.ne = edg.np = 0;
+  for( first=pp=stack; pp; pp=pp->next )
     {
-    if( AFu < -1.0e-11 ) errorf( 1, __FILE__, __LINE__,
-      "Negative AFu (", FltStr(AFu,4), ") set to 0", "" );
-    AFu = 0.0;
+    vp->nPoly[np] += 1;
+    nv2 = GetPolygonVrt3D( pp, v2 );
+#if( DEBUG > 1 )
+    DumpP3D( "Unshaded surface:", nv2, v2 );
+#endif
+    if( edg.ne + nv2 > V1AIBLK )
+      {
+      ViewObsPolys( &edg, dc1, first, 1.0f, &dFv );
+      first = pp;
+      }
+    V1AIadd( &edg, nv2, v2, vpt+np );
     }
+  ViewObsPolys( &edg, dc1, first, 1.0f, &dFv );
+
+#if( DEBUG > 1 )
+  fprintf( _ulog, " SS: x %f, y %f, z %f, dFv %g\n",
+    vpt[np].x, vpt[np].y, vpt[np].z, dFv );
 #endif
+  vp->dFv[np] = dFv;
 
+  }  /* end of ViewObsPoint */
+
+/***  ViewObsShadow.c  *******************************************************/
+
+/*  Project the shadow of obstruction srfT from view point NP to the z=0 
+ *  plane.  Return the number of shadow vertices; less than 3 if there is 
+ *  no shadow.  */
+
+IX ViewObsShadow( VOBSPTS *vp, IX np, SRFDAT3X *srfT, VERTEX2D *vs )
+  {
+  VERTEX3D *vpt=vp->vpt;  /* vertices of view points */
+  VERTEX3D v2[MAXNVT]; /* 3D vertices: obstruction */
+  VERTEX3D *pv2; /* clipped obstruction */
+  IX clip; /* if true, clip to prevent upward projection */
+  R4 hc, zc[MAXNV1];  /* surface clipping test values */
+  R4 dot;
+  IX nvs, n;
+
+  hc = 0.9999f * vpt[np].z;
+                             /* CTD must be behind surface */
+  dot = VDOTW ( (vpt+np), (&srfT->dc) );
 #if( DEBUG > 1 )
-  fprintf( _ulog, "v_obst_u AF:  %g\n", AFu );
+  fprintf( _ulog, "Surface %d;  dot %f\n", srfT->nr, dot );
   fflush( _ulog );
 #endif
-#if( DEBUG > 0 && _MSC_VER == 0 )
-  NullPointerTest( __FILE__, __LINE__ );
+  if( dot >= 0.0 ) return 0;        /* no shadow polygon created */
+  nvs = srfT->nv;
+  for( clip=n=0; n<nvs; n++ )
+    {
+    zc[n] = srfT->v[n].z - hc;
+    if( zc[n] > 0.0 ) clip = 1;
+    }
+  if( clip )        /* clip to prevent upward projection */
+    {
+#if( DEBUG > 1 )
+    fprintf( _ulog, "Clip M;  zc: %g %g %g %g\n",
+      zc[0], zc[1], zc[2], zc[3] );
+#endif
+    nvs = ClipPolygon( -1.0, nvs, (VERTEX3D *)&srfT->v, zc, v2 );
+    if( nvs < 3 ) return 0;                /* no shadow polygon created */
+    pv2 = v2;
+#if( DEBUG > 1 )
+    DumpP3D( "Clipped surface:", nvs, pv2 );
 #endif
+    }
+  else
+    pv2 = (void *)&srfT->v;
 
-  return AFu;
+            /* project obstruction from centroid to z=0 plane */
+  for( n=0; n<nvs; n++,pv2++ )
+    {
+    R4 temp = vpt[np].z / (vpt[np].z - pv2->z);  /* projection factor */
+    vs[n].x = vpt[np].x - temp * (vpt[np].x - pv2->x);
+    vs[n].y = vpt[np].y - temp * (vpt[np].y - pv2->y);
+    }
 
-  }  /*  end of ViewObstructed  */
+  return nvs;
+
+  }  /* end of ViewObsShadow */
+
+/***  ViewObsCover.c  ********************************************************/
+
+/*  Return 1 if the convex shadow polygon, after LimitPolygon(), contains 
+ *  all vertices of the base surface by more than epsDist.  */
+
+IX ViewObsCover( VOBSPTS *vp, IX nvs, VERTEX2D *vs )
+  {
+  R8 area=0.0;  /* twice the signed area of the shadow */
+  R8 ex, ey, cross, tol;
+  R4 xmin, xmax, ymin, ymax;  /* limits of shadow */
+  IX i, im1, n;
+
+  xmin = xmax = vs[0].x;   /* shadow must reach all base limits */
+  ymin = ymax = vs[0].y;
+  for( i=1; i<nvs; i++ )
+    {
+    if( vs[i].x < xmin ) xmin = vs[i].x;
+    if( vs[i].x > xmax ) xmax = vs[i].x;
+    if( vs[i].y < ymin ) ymin = vs[i].y;
+    if( vs[i].y > ymax ) ymax = vs[i].y;
+    }
+  if( xmin > vp->xmin || xmax < vp->xmax || ymin > vp->ymin || ymax < vp->ymax )
+    return 0;
+
+  for( im1=nvs-1,i=0; i<nvs; im1=i++ )
+    area += vs[im1].x * vs[i].y - vs[i].x * vs[im1].y;
+  for( im1=nvs-1,i=0; i<nvs; im1=i++ )
+    {
+    ex = vs[i].x - vs[im1].x;
+    ey = vs[i].y - vs[im1].y;
+    tol = vp->epsDist * sqrt( ex*ex + ey*ey );
+    for( n=0; n<vp->nvb; n++ )
+      {
+      cross = ex * (vp->vb[n].y - vs[im1].y) - ey * (vp->vb[n].x - vs[im1].x);
+      if( area > 0.0 ? cross <= tol : cross >= -tol ) return 0;
+      }
+    }
+
+  return 1;
+
+  }  /* end of ViewObsCover */
 
 /***  V1AIpart.c  ************************************************************/
 
@@ -285,41 +542,159 @@ R8 V1AIpart( const IX nv, const VERTEX3D p2[],
  *  p1   coordinates of surface (point) P1
  *  u1   components of unit vector normal to surface P1 */
   {
+  V1AIEDG edg;  /* edges of P2 */
   IX n;  /* edge number */
-  VECTOR3D A,  /* A = vector from P1 to P2[n-1]; |A| > 0 */
-           B,  /* B = vector from P1 to P2[n]; |B| > 0 */
-           C;  /* C = vector cross product of A and B */
-  R8 UdotC; /* dot product of U and C; always >= 0 */
   R8 sum=0; /* sum of line integrals */
 
-                            /* Initialization */
-  n = nv - 1;
-  VECTOR( p1, (p2+n), (&B) );           /* vector B */
-                            /* For all edges of polygon p2: */
+  edg.ne = edg.np = 0;
+  V1AIadd( &edg, nv, p2, p1 );
+  V1AIedges( &edg, u1 );
   for( n=0; n<nv; n++ )
+    sum += edg.term[n];
+
+  sum *= PIt2inv;                 /* Divide by 2*pi */
+
+  return sum;
+
+  }  /* end of V1AIpart
+
+/***  V1AIadd.c  *************************************************************/
+
+/*  Add the NV edges of polygon P2 as seen from point P1 to EDG.  */
+
+void V1AIadd( V1AIEDG *edg, const IX nv, const VERTEX3D p2[],
+  const VERTEX3D *p1 )
+  {
+  IX n, e=edg->ne;
+  VECTOR3D A,  /* A = vector from P1 to P2[n-1]; |A| > 0 */
+           B;  /* B = vector from P1 to P2[n]; |B| > 0 */
+
+  if( e + nv > V1AIBLK )
+    error( 3, __FILE__, __LINE__, "Too many polygon edges", "" );
+  n = nv - 1;
+  VECTOR( p1, (p2+n), (&B) );
+  for( n=0; n<nv; n++,e++ )
     {
     VCOPY( (&B), (&A) );                /* A = old B */
     VECTOR( p1, (p2+n), (&B) );         /* vector B */
-    VCROSS( (&A), (&B), (&C) );         /* C = A cross B */
-    UdotC = VDOT( u1, (&C) );           /* U dot C */
-    if( fabs(UdotC) > EPS2 )
+    edg->ax[e] = A.x;
+    edg->ay[e] = A.y;
+    edg->az[e] = A.z;
+    edg->bx[e] = B.x;
+    edg->by[e] = B.y;
+    edg->bz[e] = B.z;
+    }
+  edg->ne = e;
+  edg->nv[edg->np++] = nv;
+
+  }  /* end of V1AIadd */
+
+/***  V1AIedges.c  ***********************************************************/
+
+/*  Compute the line integral of V1AIpart() for each edge in EDG.
+ *  The second loop has no branches or function calls so that the compiler
+ *  can process several edges at once with vector instructions; sqrt() is
+ *  in the first loop because it may set errno.  The arc 
+ *  tangent is from the Cephes library (S.L. Moshier) and is accurate to 
+ *  about 1e-16:  the argument is reduced to |x| <= 0.66 using 
+ *  atan(x) = pi/2 - atan(1/x) and atan(x) = pi/4 + atan((x-1)/(x+1)).  */
+
+#define T3P8 2.41421356237309504880     /* tan( 3 * pi / 8 ) */
+#define MOREBITS 6.123233995736765886130E-17   /* pi / 2 - PId2 */
+
+SIMDCLONES void V1AIedges( V1AIEDG *edg, const DIRCOS *u1 )
+  {
+  IX n, ne=edg->ne, bad=0;
+  R4 ux=u1->x, uy=u1->y, uz=u1->z;
+  R4 len[V1AIBLK];  /* | C | */
+
+  for( n=0; n<ne; n++ )
+    {
+    R4 cx = edg->ay[n] * edg->bz[n] - edg->az[n] * edg->by[n];  /* C =  */
+    R4 cy = edg->az[n] * edg->bx[n] - edg->ax[n] * edg->bz[n];  /* A x B */
+    R4 cz = edg->ax[n] * edg->by[n] - edg->ay[n] * edg->bx[n];
+    len[n] = (R4)sqrt( cx * cx + cy * cy + cz * cz );
+    }
+
+  for( n=0; n<ne; n++ )
+    {
+    R4 cx = edg->ay[n] * edg->bz[n] - edg->az[n] * edg->by[n];  /* C =  */
+    R4 cy = edg->az[n] * edg->bx[n] - edg->ax[n] * edg->bz[n];  /* A x B */
+    R4 cz = edg->ax[n] * edg->by[n] - edg->ay[n] * edg->bx[n];
+    R8 UdotC = ux * cx + uy * cy + uz * cz;   /* U dot C */
+    R8 Clen = len[n];
+    IX use = fabs(UdotC) > EPS2;
+    IX ok = Clen > EPS2;
+    R8 x, ax, y, z, gamma;
+    IX big, mid;
+
+    if( !ok ) Clen = 1.0;   /* avoid division by zero */
+    x = (edg->ax[n] * edg->bx[n] + edg->ay[n] * edg->by[n]
+       + edg->az[n] * edg->bz[n]) / Clen;
+    ax = fabs( x );
+    big = ax > T3P8;
+    mid = (ax > 0.66) & !big;
+    y = big ? -1.0 : ( mid ? ax - 1.0 : ax );
+    z = big ? ax : ( mid ? ax + 1.0 : 1.0 );
+    y /= z;                 /* reduced argument */
+    z = y * y;
+    z = z * ((((-8.750608600031904122785E-1 * z
+      - 1.615753718733365076637E1) * z - 7.500855792314704667340E1) * z
+      - 1.228866684490136173410E2) * z - 6.485021904942025371773E1)
+      / (((((z + 2.485846490142306297962E1) * z
+      + 1.650270098316988542046E2) * z + 4.328810604912902668951E2) * z
+      + 4.853903996359136964868E2) * z + 1.945506571482613964425E2);
+    z = y * z + y;
+    z += big ? PId2 + MOREBITS : ( mid ? 0.5 * (PId2 + MOREBITS) : 0.0 );
+    gamma = PId2 - ( x < 0.0 ? -z : z );   /* angle between A and B */
+    z = UdotC * gamma / Clen;
+    edg->term[n] = ( use & ok ) ? z : 0.0;
+    bad += use & !ok;
+    }
+  if( bad )
+    error( 3, __FILE__, __LINE__, "Invalid geometry, call George", "" );
+
+  }  /* end of V1AIedges */
+
+/***  ViewObsPolys.c  ********************************************************/
+
+/*  Add the views from a view point to the polygons in EDG, times WEIGHT,
+ *  to DFV in polygon order.  PP is the first polygon.  EDG is emptied.  */
+
+void ViewObsPolys( V1AIEDG *edg, const DIRCOS *u1, POLY *pp, R4 weight,
+  R8 *dFv )
+  {
+  R8 dF;   /* F from a view point to an unshaded area */
+  IX e, j, n;
+
+  V1AIedges( edg, u1 );
+  for( e=j=0; j<edg->np; j++,pp=pp->next )
+    {
+    for( dF=0.0,n=0; n<edg->nv[j]; n++,e++ )
+      dF += edg->term[e];
+    dF *= PIt2inv;                /* Divide by 2*pi */
+#if( DEBUG > 1 )
+    fprintf( _ulog, " Partial view factor: %g\n", dF );
+#endif
+#if( DEBUG > 0 )
+    if( dF < 0.0 )
       {
-      R8 Clen = VLEN( (&C) );           /* | C | */
-      if( Clen > EPS2 )
-        {   /* gamma = angle between A and B; 0 < gamma < 180 */
-        R8 gamma = PId2 - atan( VDOT( (&A), (&B) ) / Clen );
-        sum += UdotC * gamma / Clen;
+      if( dF < -1.0e-9 )
+        {
+        errorf( 1, __FILE__, __LINE__,
+          "Negative F (", FltStr(dF,4), ") set to 0", "" );
+# if( DEBUG > 1 )     /* normally 1 */
+        DumpHC( " Polygon", pp, pp );
+# endif
         }
-      else
-        error( 3, __FILE__, __LINE__, "Invalid geometry, call George", "" );
+      dF = 0.0;
       }
-    }  /* end edge loop */
-
-  sum *= PIt2inv;                 /* Divide by 2*pi */
+#endif
+    *dFv += dF * weight;
+    }
+  edg->ne = edg->np = 0;
 
-  return sum;
-
-  }  /* end of V1AIpart
+  }  /* end of ViewObsPolys */
 
 /***  View1AI.c  *************************************************************/
 
@@ -339,6 +714,47 @@ R8 View1AI( IX nss, VERTEX3D *p1, R4 *area1, DIRCOS *dc1, SRFDAT3X *srf2 )
 
   }  /* end View1AI */
 
+/***  View1AInested.c  *******************************************************/
+
+/*  Estimate direct interchange area by single area integration over the 
+ *  nested points of SubSrfNested():  LEVEL 1 uses the center point 0, 
+ *  level 2 the coarse weights WL and level 3 the fine weights WT.  
+ *  V1AIpart() values are kept in DF so that each level computes only 
+ *  the points not used by the lower levels.  */
+
+R8 View1AInested( IX level, IX nss, VERTEX3D *p1, R4 *wt, R4 *wl, R4 area,
+  R8 *dF, DIRCOS *dc1, SRFDAT3X *srf2 )
+  {
+  IX j;
+  R8 sum=0.0;
+
+  if( level == 1 )
+    {
+    dF[0] = V1AIpart( srf2->nv, srf2->v, p1, dc1 );
+    sum = area * dF[0];
+    }
+  else if( level == 2 )
+    {
+    for( j=1; j<nss; j++ )
+      if( wl[j] != 0.0f )
+        dF[j] = V1AIpart( srf2->nv, srf2->v, p1+j, dc1 );
+    for( j=0; j<nss; j++ )
+      if( wl[j] != 0.0f )
+        sum += wl[j] * dF[j];
+    }
+  else
+    {
+    for( j=1; j<nss; j++ )
+      if( wl[j] == 0.0f )
+        dF[j] = V1AIpart( srf2->nv, srf2->v, p1+j, dc1 );
+    for( j=0; j<nss; j++ )
+      sum += wt[j] * dF[j];
+    }
+
+  return sum;
+
+  }  /* end View1AInested */
+
 /***  Subsurface.c  **********************************************************/
 
 /*  Divide convex polygon SRF into elemental subsurfaces SUB.  */
@@ -641,19 +1057,11 @@ R8 ViewTP( VERTEX3D v1[], R4 area, IX level, VFCTRL *vfCtrl )
  * area - area of surface 1;
  * vfCtrl->maxRecursion - recursion limit. */
   {
-  R8 AF;      /* AF values computed for triangle */
-  R8 AF7,     /* AF values for 7-  */
+  R8 AF7,     /* AF values for nested 7-  */
     AF13;     /* and 13-point integration */
-  R8 dF;      /* differential view factor */
-  IX cnvg;    /* true if both AF.. sufficiently close */
-  VERTEX3D vt[3]; /* vertices of subsurfaces */
-  IX n;       /* subsurface number */
 
   if( level >= vfCtrl->minRecursion )
-    {
-    AF7 = ViewObstructed( vfCtrl, 3, v1, area, 3 );
-    AF13 = ViewObstructed( vfCtrl, 3, v1, area, 4 );
-    }
+    AF13 = ViewObstructed( vfCtrl, 3, v1, area, &AF7 );
   else
     {
     AF7 = -vfCtrl->epsAF;
@@ -674,38 +1082,7 @@ R8 ViewTP( VERTEX3D v1[], R4 area, IX level, VFCTRL *vfCtrl )
   fflush( _ulog );
 #endif
 
-  if( fabs(AF13 - AF7) < vfCtrl->epsAF )
-    cnvg = 1;
-  else
-    {
-    cnvg = 0;
-    if( level++ >= vfCtrl->maxRecursion )
-      vfCtrl->failRecursion = cnvg = 1;     /* limit maximum recursions */
-    }
-
-  if( level >= vfCtrl->minRecursion )
-    {
-    vfCtrl->wastedVObs += 7;
-    if( cnvg )
-      vfCtrl->usedVObs += 13;
-    else
-      vfCtrl->wastedVObs += 13;
-    }
-
-  if( cnvg )      /* AF7 and AF13 are similar; */
-    AF = AF13;    /* therefore, assume AF13 is accurate. */
-  else
-    for( AF=0.0,n=0; n<4; n++ )    /* Otherwise, divide triangle into */
-      {                            /* four subsurfaces and compute AF */
-      SubsrfTS( n, v1, vt );       /* for each subsurface and sum. */
-      dF = ViewTP( vt, 0.25f*area, level, vfCtrl );
-      AF += dF;
-#if( DEBUG > 1 )
-      fprintf( _ulog, "  ViewTP (%d) AF: %d (%f) %f\n", level, n, dF, AF );
-#endif
-      }
-
-  return AF;
+  return ViewAdapt( 3, v1, area, level, AF13, AF7, vfCtrl );
 
   }  /* end ViewTP */
 
@@ -734,40 +1111,54 @@ void SubsrfRS( IX n, VERTEX3D v[], VERTEX3D s[] )
 
 R8 ViewRP( VERTEX3D v1[], R4 area, IX level, VFCTRL *vfCtrl )
   {
-  R8 AF;      /* AF values computed for rectangle */
-  R8 AF9,     /* AF values for 9-  */
-    AF16;     /* and 16-point integration */
-  R8 dF;      /* differential view factor */
-  IX cnvg;    /* true if both AF.. sufficiently close */
-  VERTEX3D vt[4]; /* vertices of subsurfaces */
-  IX n;       /* subsurface number */
+  R8 AF5,     /* AF values for nested 5-  */
+    AF17;     /* and 17-point integration */
 
   if( level >= vfCtrl->minRecursion )
-    {
-    AF9 = ViewObstructed( vfCtrl, 4, v1, area, 3 );
-    AF16 = ViewObstructed( vfCtrl, 4, v1, area, 4 );
-    }
+    AF17 = ViewObstructed( vfCtrl, 4, v1, area, &AF5 );
   else
     {
-    AF9 = -vfCtrl->epsAF;
-    AF16 = vfCtrl->epsAF;
+    AF5 = -vfCtrl->epsAF;
+    AF17 = vfCtrl->epsAF;
     }
 
 #if( STKTEST > 0 )
 # if defined __TURBOC__  
-  fprintf( _ulog, "  ViewRP %d (%d) area %f  AF9: %f  AF16: %f\n",
-    level, _SP, area, AF9, AF16 );
+  fprintf( _ulog, "  ViewRP %d (%d) area %f  AF5: %f  AF17: %f\n",
+    level, _SP, area, AF5, AF17 );
 # elif defined __WATCOMC__
-  fprintf( _ulog, "  ViewRP %d (%d) area %f  AF9: %f  AF16: %f\n",
-    level, stackavail(), area, AF9, AF16 );
+  fprintf( _ulog, "  ViewRP %d (%d) area %f  AF5: %f  AF17: %f\n",
+    level, stackavail(), area, AF5, AF17 );
 # else
-  fprintf( _ulog, "  ViewRP %d area %f  AF9: %f  AF16: %f\n",
-    level, area, AF9, AF16 );
+  fprintf( _ulog, "  ViewRP %d area %f  AF5: %f  AF17: %f\n",
+    level, area, AF5, AF17 );
 # endif
   fflush( _ulog );
 #endif
 
-  if( fabs(AF16 - AF9) < vfCtrl->epsAF )
+  return ViewAdapt( 4, v1, area, level, AF17, AF5, vfCtrl );
+
+  }  /* end ViewRP */
+
+/***  ViewAdapt.c  ***********************************************************/
+
+/*  Accept the AF of a triangle (nv = 3) or rectangle (nv = 4) if it 
+ *  agrees with its coarse estimate AFc; otherwise compute it from four 
+ *  subsurfaces.  */
+
+R8 ViewAdapt( IX nv, VERTEX3D v1[], R4 area, IX level, R8 AF, R8 AFc,
+  VFCTRL *vfCtrl )
+/* nv   - number of vertices of surface 1.
+ * v1   - vertices of surface 1.
+ * area - area of surface 1.
+ * level - recursion level of surface 1.
+ * AF, AFc - fine and coarse AF of surface 1. */
+  {
+  IX eval;    /* true if AF.. were computed at this level */
+  IX cnvg;    /* true if both AF.. sufficiently close */
+
+  eval = level >= vfCtrl->minRecursion;
+  if( fabs(AF - AFc) < vfCtrl->epsAF )
     cnvg = 1;
   else
     {
@@ -776,29 +1167,142 @@ R8 ViewRP( VERTEX3D v1[], R4 area, IX level, VFCTRL *vfCtrl )
       vfCtrl->failRecursion = cnvg = 1;     /* limit maximum recursions */
     }
 
-  if( level >= vfCtrl->minRecursion )
+  if( eval )
     {
-    vfCtrl->wastedVObs += 9;
     if( cnvg )
-      vfCtrl->usedVObs += 16;
+      vfCtrl->usedVObs += nv == 3 ? 13 : 17;
     else
-      vfCtrl->wastedVObs += 16;
+      vfCtrl->wastedVObs += nv == 3 ? 13 : 17;
+    }
+
+  if( !cnvg )     /* Divide surface into four subsurfaces. */
+    AF = ViewSubsrfs( nv, v1, area, level, eval ? AF : -1.0, vfCtrl );
+
+  return AF;
+
+  }  /* end ViewAdapt */
+
+/***  ViewSubsrfs.c  *********************************************************/
+
+/*  Compute AF for the four subsurfaces of a triangle (nv = 3) or 
+ *  rectangle (nv = 4).  Each subsurface is evaluated once; if their sum 
+ *  agrees with the parent AF, it is accepted without further tests.  
+ *  Otherwise a subsurface is refined only if its own estimates differ 
+ *  by more than epsAF.  The subsurfaces are independent 
+ *  tasks which may run on idle threads.  Each one has a copy of vfCtrl 
+ *  for its counters; these and the AF values are summed in subsurface 
+ *  order, so the result does not depend on the threads.  */
+
+R8 ViewSubsrfs( IX nv, VERTEX3D v1[], R4 area, IX level, R8 AFp,
+  VFCTRL *vfCtrl )
+/* nv   - number of vertices of surface 1.
+ * v1   - vertices of surface 1.
+ * area - area of surface 1.
+ * level - recursion level of the subsurfaces.
+ * AFp  - fine AF of surface 1; negative if not computed. */
+  {
+  VSUBSRF sub[4];  /* data for each subsurface */
+  R8 AF;      /* sum of subsurface AF values */
+  IX nvpt;    /* number of view points per evaluation */
+  IX n;       /* subsurface number */
+
+  nvpt = nv == 3 ? 13 : 17;
+  for( n=0; n<4; n++ )
+    {
+    memcpy( &sub[n].vfCtrl, vfCtrl, sizeof(VFCTRL) );
+    sub[n].vfCtrl.wastedVObs = 0;
+    sub[n].vfCtrl.usedVObs = 0;
+    sub[n].vfCtrl.savedVObs = 0;
+    sub[n].vfCtrl.totPoly = 0;
+    sub[n].vfCtrl.totVpt = 0;
+    sub[n].vfCtrl.failRecursion = 0;
+    if( nv == 3 )
+      SubsrfTS( n, v1, sub[n].v );
+    else
+      SubsrfRS( n, v1, sub[n].v );
+    sub[n].nv = nv;
+    sub[n].area = 0.25f * area;
+    sub[n].level = level;
     }
 
-  if( cnvg )      /* AF9 and AF16 are similar; */
-    AF = AF16;    /* therefore, assume AF16 is accurate. */
-  else
-    for( AF=0.0,n=0; n<4; n++ )    /* Otherwise, divide rectangle into */
-      {                            /* four subsurfaces and compute AF */
-      SubsrfRS( n, v1, vt );       /* for each subsurface and sum. */
-      dF = ViewRP( vt, 0.25f*area, level, vfCtrl );
-      AF += dF;
 #if( DEBUG > 1 )
-      fprintf( _ulog, "  ViewRP (%d) AF: %d (%f) %f\n", level, n, dF, AF );
+  for( n=0; n<4; n++ )   /* keep the debug output in order */
+    ViewSubsrfEval( sub, n );
+#else
+  ThrdTasks( ViewSubsrfEval, sub, 4 );
 #endif
+  for( AF=0.0,n=0; n<4; n++ )
+    AF += sub[n].AF;
+
+  if( AFp >= 0.0 && level >= vfCtrl->minRecursion
+    && fabs(AF - AFp) < vfCtrl->epsAF )
+    {                 /* parent and subsurfaces agree */
+    for( n=0; n<4; n++ )
+      {
+      vfCtrl->usedVObs += nvpt;
+      if( fabs(sub[n].AF - sub[n].AFc) >= vfCtrl->epsAF )
+        vfCtrl->savedVObs += 4 * nvpt;  /* would have been divided */
       }
+    }
+  else
+    {
+#if( DEBUG > 1 )
+    for( n=0; n<4; n++ )
+      ViewSubsrf( sub, n );
+#else
+    ThrdTasks( ViewSubsrf, sub, 4 );
+#endif
+    for( AF=0.0,n=0; n<4; n++ )
+      AF += sub[n].AF;
+    }
+
+  for( n=0; n<4; n++ )
+    {
+    vfCtrl->wastedVObs += sub[n].vfCtrl.wastedVObs;
+    vfCtrl->usedVObs += sub[n].vfCtrl.usedVObs;
+    vfCtrl->savedVObs += sub[n].vfCtrl.savedVObs;
+    vfCtrl->totPoly += sub[n].vfCtrl.totPoly;
+    vfCtrl->totVpt += sub[n].vfCtrl.totVpt;
+    if( sub[n].vfCtrl.failRecursion )
+      vfCtrl->failRecursion = 1;
+#if( DEBUG > 1 )
+    fprintf( _ulog, "  View%cP (%d) AF: %d (%f)\n", nv == 3 ? 'T' : 'R',
+      level, n, sub[n].AF );
+#endif
+    }
 
   return AF;
 
-  }  /* end ViewRP */
+  }  /* end ViewSubsrfs */
+
+/***  ViewSubsrfEval.c  ******************************************************/
+
+/*  Task function:  compute fine and coarse AF for subsurface N.  */
+
+void ViewSubsrfEval( void *arg, IX n )
+  {
+  VSUBSRF *sub=(VSUBSRF *)arg + n;
+
+  if( sub->level >= sub->vfCtrl.minRecursion )
+    sub->AF = ViewObstructed( &sub->vfCtrl, sub->nv, sub->v, sub->area,
+      &sub->AFc );
+  else
+    {
+    sub->AFc = -sub->vfCtrl.epsAF;
+    sub->AF = sub->vfCtrl.epsAF;
+    }
+
+  }  /* end ViewSubsrfEval */
+
+/***  ViewSubsrf.c  **********************************************************/
+
+/*  Task function:  accept or refine the AF of subsurface N.  */
+
+void ViewSubsrf( void *arg, IX n )
+  {
+  VSUBSRF *sub=(VSUBSRF *)arg + n;
+
+  sub->AF = ViewAdapt( sub->nv, sub->v, sub->area, sub->level,
+    sub->AF, sub->AFc, &sub->vfCtrl );
 
+  }  /* end ViewSubsrf */
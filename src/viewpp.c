@@ -1,5 +1,43 @@
 /*subfile:  viewpp.c  *********************************************************/
 /*                                                                           */
+/*  View3D, Copyright (c) 2018 Alliance for Sustainable Energy, LLC          */
+/*  All rights reserved.                                                     */
+/*                                                                           */
+/*  Redistribution and use in source and binary forms, with or without       */
+/*  modification, are permitted provided that the following conditions are   */
+/*  met:                                                                     */
+/*                                                                           */
+/*  1. Redistributions of source code must retain the above copyright        */
+/*     notice, this list of conditions and the following disclaimer.         */
+/*                                                                           */
+/*  2. Redistributions in binary form must reproduce the above copyright     */
+/*     notice, this list of conditions and the following disclaimer in the   */
+/*     documentation and/or other materials provided with the distribution.  */
+/*                                                                           */
+/*  3. The name of the copyright holder(s), any contributors, the United     */
+/*     States Government, the United States Department of Energy, or any of  */
+/*     their employees may not be used to endorse or promote products        */
+/*     derived from this software without specific prior written permission  */
+/*     from the respective party.                                            */
+/*                                                                           */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER(S) AND ANY             */
+/*  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,   */
+/*  BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND        */
+/*  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE   */
+/*  COPYRIGHT HOLDER(S), ANY CONTRIBUTORS, THE UNITED STATES GOVERNMENT, OR  */
+/*  THE UNITED STATES DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE   */
+/*  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR      */
+/*  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF     */
+/*  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR          */
+/*  BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,    */
+/*  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR  */
+/*  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF   */
+/*  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                               */
+/*                                                                           */
+/*  This file has been modified from the original public domain version.     */
+/*                                                                           */
+/*  Original NIST Disclaimer:                                                */
+/*                                                                           */
 /*  This software was developed at the National Institute of Standards       */
 /*  and Technology by employees of the Federal Government in the             */
 /*  course of their official duties. Pursuant to title 17 Section 105        */
@@ -29,6 +67,33 @@
 extern FILE *_ulog; /* log file */
 extern IX _list;    /* output control, higher value = more output */
 
+#define LDLBLK 64   /* rows/columns per block in LDLFactor() & LDLInverse() */
+
+typedef struct ldljob   /* data shared by the threads of LDLFactor() 
+                           and LDLInverse() */
+  {
+  IX neq;       /* number of equations */
+  R8 **a;       /* matrix [triangular] */
+  R8 *w;        /* work rows; LDLBLK values per row */
+  IX k0, k1;    /* first and last rows (columns) of current block */
+  } LDLJOB;
+
+typedef struct normjob  /* data shared by the threads of NormAF() */
+  {
+  IX nSrf;      /* number of surfaces */
+  R8 **AF;      /* radiation interchange factors / lower triangle */
+  R8 *scale;    /* scale factor of each row & column [1:nSrf] */
+  R8 *colSum;   /* sum of each column below the diagonal [1:nSrf] */
+  } NORMJOB;
+
+     /* local functions */
+void NormAFThrd( void *arg, IX index );
+void LDLRow( R8 **a, R8 *u, IX i, IX k0, IX k1 );
+void LDLPanel( void *arg, IX index );
+void LDLUpdate( void *arg, IX index );
+void LDLInvL( void *arg, IX index );
+void LDLInvA( void *arg, IX index );
+
 /***  DelNull.c  *************************************************************/
 
 /*  Delete NULS surfaces from AF and supporting vectors.
@@ -184,6 +249,7 @@ void NormAF( const nSrf, const R4 *emit, const R4 *area, R8 **AF,
  *  itMax; maximum number of iterations
  */
   {
+  NORMJOB job;  /* data for threads */
   IX n;    /* row */
   IX m;    /* column */
   IX iter; /* iterations count */
@@ -191,34 +257,79 @@ void NormAF( const nSrf, const R4 *emit, const R4 *area, R8 **AF,
   R8 maxError=1.0;   /* max error value */
   R8 sumAF, sumF;
 
+  job.nSrf = nSrf;
+  job.AF = AF;
+  job.scale = Alc_V( 1, nSrf, sizeof(R8), "scale" );
+  job.colSum = Alc_V( 1, nSrf, sizeof(R8), "colSum" );
+  for( m=1; m<=nSrf; m++ )
+    job.scale[m] = 1.0;
+
+/* Each row and column m is scaled in turn using the values of the rows 
+ * n < m already scaled.  Find the scale factors from the column sums and 
+ * the rows of AF in one sweep; scale AF in the next column sum sweep. */
   for( iter=0; iter<itMax && maxError>eMax; iter++ )
     {
+    ThrdRun( NormAFThrd, &job );
     for( maxError=0.0,m=1; m<=nSrf; m++ )
       {
-      for( sumAF=0.0,n=1; n<=m; n++ )
-        sumAF += AF[m][n];
-      for( n=m+1; n<=nSrf; n++ )
-        sumAF += AF[n][m];
+      for( sumAF=0.0,n=1; n<m; n++ )
+        sumAF += AF[m][n] * job.scale[n];
+      sumAF += AF[m][m];
+      sumAF += job.colSum[m];
       sumF = sumAF / area[m];
       err = fabs( sumF - emit[m] );
       if( err > maxError )
         maxError = err;
-      sumF = emit[m] / sumF;
-      for( n=1; n<=m; n++ )
-        AF[m][n] *= sumF;
-      for( n=m+1; n<=nSrf; n++ )
-        AF[n][m] *= sumF;
+      job.scale[m] = emit[m] / sumF;
       }
     if( _list>1 )
       fprintf( _ulog, "NormAF: %d  maxError: %.2e\n", iter+1, maxError );
     }
+  ThrdRun( NormAFThrd, &job );  /* apply last scale factors */
 
   if( iter>=itMax )
     error( 2, __FILE__, __LINE__, "Too many iterations for normalization", "" );
   fprintf( _ulog, "%d normalization iterations.\n", iter );
 
+  Fre_V( job.colSum, 1, nSrf, sizeof(R8), "colSum" );
+  Fre_V( job.scale, 1, nSrf, sizeof(R8), "scale" );
+
   }  /* end of NormAF */
 
+/***  NormAFThrd.c  **********************************************************/
+
+/*  Thread function:  scale AF by the row and column scale factors and sum
+ *  the columns below the diagonal.  Each thread processes blocks of 
+ *  LDLBLK columns; each block is processed row by row.  */
+
+void NormAFThrd( void *arg, IX index )
+  {
+  NORMJOB *job=(NORMJOB *)arg;
+  R8 **AF=job->AF, *scale=job->scale, *colSum=job->colSum;
+  IX m0, m1, m, n;
+  R8 *an;
+
+  for( m0=1+index*LDLBLK; m0<=job->nSrf; m0+=ThrdCount()*LDLBLK )
+    {
+    m1 = MIN( m0 + LDLBLK - 1, job->nSrf );
+    for( m=m0; m<=m1; m++ )
+      colSum[m] = 0.0;
+    for( n=m0; n<=job->nSrf; n++ )
+      {
+      an = AF[n];
+      for( m=m0; m<=MIN(m1,n-1); m++ )
+        {
+        an[m] *= scale[m];
+        an[m] *= scale[n];
+        colSum[m] += an[m];
+        }
+      if( n <= m1 )
+        an[n] *= scale[n];
+      }
+    }
+
+  }  /* end of NormAFThrd */
+
 /*  IntFac.c  ****************************************************************/
 
 /*  Compute the total radiation interchange factors; i.e., include the
@@ -235,11 +346,9 @@ void IntFac( const IX nSrf, const R4 *emit, const R4 *area, R8 **AF )
  */
   {
   IX  m, n;
-  R8 *a, *w;
-  FILE *tmpf=tmpfile();
+  R8 *a;
 
   a = Alc_V( 1, nSrf, sizeof(R8), "A" );
-  w = Alc_V( 1, nSrf, sizeof(R8), "W" );
 
 /* subtract AREA/RHO from diagonal elements */
   for( n=1; n<=nSrf; n++ )
@@ -249,34 +358,228 @@ void IntFac( const IX nSrf, const R4 *emit, const R4 *area, R8 **AF )
     a[n] *= emit[n];
     }
 
-  LUFactorSymm( nSrf, AF );  /* factor AF (symmetric) */
-  
-  for( n=1; n<=nSrf; n++ )  /* determine response vectors */
-    {
-    memset( w+1, 0, nSrf*sizeof(R8) );
-    w[n] = -a[n];
-    LUSolveSymm( nSrf, AF, w );
-    fwrite( w+1, sizeof(R8), nSrf, tmpf );
-    }
-  
-  fflush( tmpf );
-  rewind( tmpf );
-  for( n=1; n<=nSrf; n++ )    /* compute total interchange areas */
+  LDLFactor( nSrf, AF );   /* factor AF (symmetric) */
+  LDLInverse( nSrf, AF );  /* replace AF by its inverse */
+
+/* The response to {B} = -a[n] in row n is column n of the inverse 
+ * times -a[n]; compute total interchange areas from all responses. */
+  for( n=1; n<=nSrf; n++ )
     {
-    m = fread( w+1, sizeof(R8), nSrf, tmpf );
     for( m=1; m<n; m++ )
-      AF[n][m] = a[m] * w[m];
-    AF[n][n] = a[n] * (w[n] - emit[n]);
-    for( m=n+1; m<=nSrf; m++ )
-      AF[m][n] = 0.5 * ( AF[m][n] + a[m] * w[m] );
+      AF[n][m] *= -a[m] * a[n];
+    AF[n][n] = a[n] * (-a[n] * AF[n][n] - emit[n]);
     }
 
   Fre_V( a, 1, nSrf, sizeof(R8), "A" );
-  Fre_V( w, 1, nSrf, sizeof(R8), "W" );
-  fclose( tmpf );
 
   }  /* end of IntFac */
 
+/***  LDLFactor.c  *********************************************************/
+
+/*  Factor symmetric matrix [A] = [L] * [D] * [L]'.  Only the lower 
+ *  triangle of [A] (including diagonal) is used.  On return the strict 
+ *  lower triangle holds [L] (unit diagonal) and the diagonal holds 1/[D].
+ *  The columns are processed in blocks of LDLBLK:  the block of rows on 
+ *  the diagonal is factored, the rows below it are reduced to that block 
+ *  and the rest of the matrix is updated by the block.  The last two 
+ *  steps are done by all threads; each row is done by a single thread in
+ *  a fixed order so the result does not depend on the number of threads.
+ *  Like LUFactorSymm() there is no pivoting.  */
+
+void LDLFactor( const IX neq, R8 **a )
+  {
+  LDLJOB job;
+  IX i;
+  R8 dot;
+
+  job.neq = neq;
+  job.a = a;
+  job.w = Alc_V( 0, (neq+1)*LDLBLK-1, sizeof(R8), "LDL w" );
+  for( job.k0=1; job.k0<=neq; job.k0+=LDLBLK )
+    {
+    job.k1 = MIN( job.k0 + LDLBLK - 1, neq );
+    for( i=job.k0; i<=job.k1; i++ )   /* diagonal block */
+      {
+      LDLRow( a, job.w + i*LDLBLK - 1, i, job.k0, i-1 );
+      dot = DotProd( i - job.k0, job.w + i*LDLBLK - 1, a[i] + job.k0 - 1 );
+      a[i][i] -= dot;
+      if( a[i][i] == 0.0 ) error( 3, __FILE__, __LINE__,
+          "Zero on the diagonal, row ", IntStr( i ), "" );
+      a[i][i] = 1.0 / a[i][i];
+      }
+    if( job.k1 < neq )
+      {
+      ThrdRun( LDLPanel, &job );
+      ThrdRun( LDLUpdate, &job );
+      }
+    }
+  Fre_V( job.w, 0, (neq+1)*LDLBLK-1, sizeof(R8), "LDL w" );
+
+  }  /* end of LDLFactor */
+
+/***  LDLRow.c  **************************************************************/
+
+/*  Reduce columns K0 to K1 of row I of [A] by the rows K0 to K1 which 
+ *  are already factored.  The reduced values, [L]*[D], are saved in
+ *  {U} [1:K1-K0+1]; [L] replaces [A].  */
+
+void LDLRow( R8 **a, R8 *u, IX i, IX k0, IX k1 )
+  {
+  IX j;
+  R8 *ai=a[i];
+
+  for( j=k0; j<=k1; j++ )
+    {
+    u[j-k0+1] = ai[j] - DotProd( j-k0, u, a[j] + k0 - 1 );
+    ai[j] = u[j-k0+1] * a[j][j];
+    }
+
+  }  /* end of LDLRow */
+
+/***  LDLPanel.c  ************************************************************/
+
+/*  Thread function:  reduce the rows below the diagonal block.  */
+
+void LDLPanel( void *arg, IX index )
+  {
+  LDLJOB *job=(LDLJOB *)arg;
+  IX i;
+
+  for( i=job->k1+1+index; i<=job->neq; i+=ThrdCount() )
+    LDLRow( job->a, job->w + i*LDLBLK - 1, i, job->k0, job->k1 );
+
+  }  /* end of LDLPanel */
+
+/***  LDLUpdate.c  ***********************************************************/
+
+/*  Thread function:  subtract [L]*[D]*[L]' of the current block from the 
+ *  rest of the matrix.  Each thread updates blocks of LDLBLK rows, using 
+ *  the block columns in tiles of LDLBLK rows.  */
+
+void LDLUpdate( void *arg, IX index )
+  {
+  LDLJOB *job=(LDLJOB *)arg;
+  R8 **a=job->a;
+  IX nk=job->k1 - job->k0 + 1;  /* number of columns in block */
+  IX i0, i1, i, j0, j1, j;
+  R8 *u;
+
+  for( i0=job->k1+1+index*LDLBLK; i0<=job->neq; i0+=ThrdCount()*LDLBLK )
+    {
+    i1 = MIN( i0 + LDLBLK - 1, job->neq );
+    for( j0=job->k1+1; j0<=i1; j0+=LDLBLK )
+      {
+      j1 = MIN( j0 + LDLBLK - 1, i1 );
+      for( i=MAX(i0,j0); i<=i1; i++ )
+        {
+        u = job->w + i*LDLBLK - 1;
+        for( j=j0; j<=MIN(j1,i); j++ )
+          a[i][j] -= DotProd( nk, u, a[j] + job->k0 - 1 );
+        }
+      }
+    }
+
+  }  /* end of LDLUpdate */
+
+/***  LDLInverse.c  **********************************************************/
+
+/*  Replace the [L]*[D]*[L]' factors from LDLFactor() by the lower triangle
+ *  of the inverse of [A] = [Z]' * 1/[D] * [Z] where [Z] = inverse of [L].
+ *  [Z] replaces [L] and then the inverse replaces [Z] one block of LDLBLK 
+ *  rows at a time.  The threads compute separate blocks of columns.  */
+
+void LDLInverse( const IX neq, R8 **a )
+  {
+  LDLJOB job;
+  IX i;
+
+  job.neq = neq;
+  job.a = a;
+  job.w = Alc_V( 0, LDLBLK*neq-1, sizeof(R8), "LDL w" );
+  for( job.k0=1; job.k0<=neq; job.k0+=LDLBLK )   /* [Z] */
+    {
+    job.k1 = MIN( job.k0 + LDLBLK - 1, neq );
+    for( i=job.k0; i<=job.k1; i++ )   /* copy rows of [L] */
+      memcpy( job.w + (i-job.k0)*neq, a[i]+1, (i-1)*sizeof(R8) );
+    ThrdRun( LDLInvL, &job );
+    }
+
+  for( job.k0=1; job.k0<=neq; job.k0+=LDLBLK )   /* inverse */
+    {
+    job.k1 = MIN( job.k0 + LDLBLK - 1, neq );
+    memset( job.w, 0, LDLBLK*neq*sizeof(R8) );
+    ThrdRun( LDLInvA, &job );
+    for( i=job.k0; i<=job.k1; i++ )
+      memcpy( a[i]+1, job.w + (i-job.k0)*neq, i*sizeof(R8) );
+    }
+  Fre_V( job.w, 0, LDLBLK*neq-1, sizeof(R8), "LDL w" );
+
+  }  /* end of LDLInverse */
+
+/***  LDLInvL.c  *************************************************************/
+
+/*  Thread function:  compute rows K0 to K1 of [Z] = inverse of [L]; 
+ *  Z[i][j] = -L[i][j] - SUM( L[i][k] * Z[k][j] ), j < k < i.
+ *  Rows K0 to K1 of [L] have been copied to job->w.  */
+
+void LDLInvL( void *arg, IX index )
+  {
+  LDLJOB *job=(LDLJOB *)arg;
+  R8 **a=job->a;
+  IX j0, j1, j, i, k;
+  R8 *li, c;
+
+  for( j0=1+index*LDLBLK; j0<job->k1; j0+=ThrdCount()*LDLBLK )
+    {
+    j1 = MIN( j0 + LDLBLK - 1, job->k1 - 1 );
+    for( i=MAX(job->k0,j0+1); i<=job->k1; i++ )
+      {
+      li = job->w + (i-job->k0)*job->neq - 1;
+      for( j=j0; j<=MIN(j1,i-1); j++ )
+        a[i][j] = -li[j];
+      }
+    for( k=j0+1; k<job->k1; k++ )
+      for( i=MAX(job->k0,k+1); i<=job->k1; i++ )
+        {
+        c = job->w[(i-job->k0)*job->neq + k-1];
+        if( c != 0.0 )
+          for( j=j0; j<=MIN(j1,k-1); j++ )
+            a[i][j] -= c * a[k][j];
+        }
+    }
+
+  }  /* end of LDLInvL */
+
+/***  LDLInvA.c  *************************************************************/
+
+/*  Thread function:  compute rows K0 to K1 of the inverse into job->w;
+ *  Ainv[i][j] = SUM( Z[k][i] / D[k] * Z[k][j] ), k >= i >= j, Z[k][k] = 1.  */
+
+void LDLInvA( void *arg, IX index )
+  {
+  LDLJOB *job=(LDLJOB *)arg;
+  R8 **a=job->a;
+  IX j0, j1, j, i, k;
+  R8 *bi, c;
+
+  for( j0=1+index*LDLBLK; j0<=job->k1; j0+=ThrdCount()*LDLBLK )
+    {
+    j1 = MIN( j0 + LDLBLK - 1, job->k1 );
+    for( k=MAX(job->k0,j0); k<=job->neq; k++ )
+      for( i=MAX(job->k0,j0); i<=MIN(job->k1,k); i++ )
+        {
+        bi = job->w + (i-job->k0)*job->neq - 1;
+        c = (i < k) ? a[k][i] * a[k][k] : a[k][k];
+        if( c == 0.0 ) continue;
+        for( j=j0; j<=MIN(j1,MIN(i,k-1)); j++ )
+          bi[j] += c * a[k][j];
+        if( i == k && j0 <= k && k <= j1 )
+          bi[k] += c;
+        }
+    }
+
+  }  /* end of LDLInvA */
+
 /*  LUFactorSymm.c  **********************************************************/
 
 /*  L-U factorization of symmetric matrix [A] which is used for
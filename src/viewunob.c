@@ -37,15 +37,23 @@ extern I1 *methods[]; /* method abbreviations */
 
 #define PId2     1.570796326794896619   /* pi / 2 */
 #define PIinv    0.318309886183790672   /* 1 / pi */
+#define PIt2inv  0.159154943091895346   /* 1 / (2 * pi) */
 #define PIt4inv  0.079577471545947673   /* 1 / (4 * pi) */
-
-/* The following variables are "global" to this file.  
- * They are allocated and freed in ViewsInit(). */
-EDGEDCS *_rc1; /* edge DirCos of surface 1 */
-EDGEDCS *_rc2; /* edge DirCos of surface 2 */
-EDGEDIV **_dv1;  /* edge divisions of surface 1 */
-EDGEDIV **_dv2;  /* edge divisions of surface 2 */
-I4 _usedV1LIpart=0L;  /* number of calls to V1LIpart() */
+#define PI2d6    1.644934066848226436   /* pi^2 / 6 */
+#define RECTTOL  1.0e-6   /* tolerance of parallel / perpendicular edges */
+#define EXACTPAR 1.0e-7   /* sine of angle of parallel edges */
+
+THRDLOCAL U4 _usedV1LIpart=0L;  /* number of calls to V1LIpart() */
+
+const R4 _pqx[7] = {     /* nested Gauss-Patterson ordinates */
+   0.500000000f, 0.112701665f, 0.887298335f, 0.019754366f, 0.980245634f,
+   0.282878125f, 0.717121875f };
+const R8 _pqw[3][7] = {  /* weights of the 1, 3 and 7 point levels */
+   { 1.0 },
+   { 0.444444444444444, 0.277777777777778, 0.277777777777778 },
+   { 0.225458269329237, 0.134244044934167, 0.134244044934167,
+     0.052328113013234, 0.052328113013234,
+     0.200698707387981, 0.200698707387981 } };
 
 /***  ViewUnobstructed.c  ****************************************************/
 
@@ -53,12 +61,21 @@ I4 _usedV1LIpart=0L;  /* number of calls to V1LIpart() */
 
 R8 ViewUnobstructed( VFCTRL *vfCtrl, IX row, IX col )
   {
-  VERTEX3D pt1[16], pt2[16];
-  R4 area1[16], area2[16];
+  VERTEX3D pt1[17], pt2[16];
+  R4 area1[17], area2[16], wlow1[17];
   SRFDAT3X *srf1;  /* pointer to surface 1 */
   SRFDAT3X *srf2;  /* pointer to surface 2 */
+  SRFQUAD *q1=NULL, *q2=NULL;  /* cached quadrature data of surfaces 1, 2 */
+  VERTEX3D *p1=pt1, *p2=pt2;   /* Gaussian points */
+  R4 *w1=area1, *w2=area2;     /* Gaussian weights */
+  EDGEDCS *rc1=vfCtrl->rc1, *rc2=vfCtrl->rc2;  /* edge direction cosines */
+  EDGEDIV **dv1=vfCtrl->dv1, **dv2=vfCtrl->dv2;  /* edge divisions */
   R8 AF0,  /* estimate of AF */
      AF1;  /* improved estimate; one more edge division */
+  R8 dAF;  /* |AF1 - AF0| of the previous level */
+  R8 sx2[16], sy2[16], sz2[16], ss2[16];
+  R8 *x2=sx2, *y2=sy2, *z2=sz2, *s2=ss2;  /* surface 2 as arrays */
+  IX nsoa;  /* number of points in x2[], y2[], z2[], s2[] */
   IX nmax, mmax;
   IX nDiv;
 
@@ -68,8 +85,32 @@ R8 ViewUnobstructed( VFCTRL *vfCtrl, IX row, IX col )
 
   srf1 = &vfCtrl->srf1T;
   srf2 = &vfCtrl->srf2T;
+  if( vfCtrl->method == RCT )  /* closed-form rectangles */
+    {
+#if( DEBUG > 1 )
+    fprintf( _ulog, " RCT" );
+#endif
+    AF1 = ViewRect( srf1, srf2 );
+    nDiv = 2;                /* for bins[][] report */
+    goto done;
+    }
+  if( vfCtrl->method == EXA )  /* exact contour integral */
+    {
+#if( DEBUG > 1 )
+    fprintf( _ulog, " EXA" );
+#endif
+    AF1 = ViewExact( srf1->nv, srf1->v, srf2->nv, srf2->v );
+    nDiv = 2;                /* for bins[][] report */
+    goto done;
+    }
   if( vfCtrl->method < ALI )
+    {
     AF1 = 2.0 * srf1->area;
+    if( !vfCtrl->clip1 )
+      q1 = SrfQuad( vfCtrl->quad, srf1 );
+    if( !vfCtrl->clip2 && (vfCtrl->method == DAI || vfCtrl->method == DLI) )
+      q2 = SrfQuad( vfCtrl->quad, srf2 );
+    }
   if( vfCtrl->method == DAI )  /* double area integration */
     {
 #if( DEBUG > 1 )
@@ -78,45 +119,73 @@ R8 ViewUnobstructed( VFCTRL *vfCtrl, IX row, IX col )
     for( nDiv=1; nDiv<5; nDiv++ )
       {
       AF0 = AF1;
-      nmax = SubSrf( nDiv, srf1->nv, srf1->v, srf1->area, pt1, area1 );
-      mmax = SubSrf( nDiv, srf2->nv, srf2->v, srf2->area, pt2, area2 );
-      AF1 = View2AI( nmax, &srf1->dc, pt1, area1, mmax, &srf2->dc, pt2, area2 );
+      if( q1 )
+        nmax = QuadPoints( q1, nDiv, &p1, &w1 );
+      else
+        nmax = SubSrf( nDiv, srf1->nv, srf1->v, srf1->area, pt1, area1 );
+      if( q2 )
+        {
+        mmax = QuadPoints( q2, nDiv, &p2, &w2 );
+        nsoa = QuadPointsSoa( q2, nDiv, &x2, &y2, &z2, &s2 );
+        }
+      else
+        {
+        mmax = SubSrf( nDiv, srf2->nv, srf2->v, srf2->area, pt2, area2 );
+        nsoa = PointsSoa( mmax, pt2, area2, x2, y2, z2, s2 );
+        }
+      AF1 = View2AIsoa( nmax, &srf1->dc, p1, w1, nsoa, &srf2->dc,
+        x2, y2, z2, s2 );
+#if( DEBUG > 0 )
+      SoaCheck( AF1, View2AI( nmax, &srf1->dc, p1, w1, mmax, &srf2->dc,
+        p2, w2 ), srf1->area, "View2AIsoa" );
+#endif
 #if( DEBUG > 1 )
       fprintf( _ulog, " %g", AF1 );
 #endif
-      if( fabs(AF1 - AF0) < vfCtrl->epsAF ) goto done;
+      if( Converged( nDiv, AF0, AF1, &dAF, vfCtrl->epsAF ) ) goto done;
       }
     }
   else if( vfCtrl->method == SAI )  /* single area integration */
     {
+    R8 dF[17];    /* V1AIpart() values of the nested points */
+    R4 *wl=wlow1; /* coarse nested weights */
 #if( DEBUG > 1 )
     fprintf( _ulog, " 1AI" );
 #endif
-    for( nDiv=1; nDiv<5; nDiv++ )
+    if( q1 )
+      { nmax = q1->nNest; p1 = q1->npt; w1 = q1->nwt; wl = q1->nwl; }
+    else
+      nmax = SubSrfNested( srf1->nv, srf1->v, srf1->area, pt1, area1, wlow1 );
+    for( nDiv=1; nDiv<4; nDiv++ )
       {
       AF0 = AF1;
-      nmax = SubSrf( nDiv, srf1->nv, srf1->v, srf1->area, pt1, area1 );
-      AF1 = -View1AI( nmax, pt1, area1, &srf1->dc, srf2 );
+      AF1 = -View1AInested( nDiv, nmax, p1, w1, wl, srf1->area, dF,
+        &srf1->dc, srf2 );
 #if( DEBUG > 1 )
       fprintf( _ulog, " %g", AF1 );
 #endif
-      if( fabs(AF1 - AF0) < vfCtrl->epsAF ) goto done;
+      if( Converged( nDiv, AF0, AF1, &dAF, vfCtrl->epsAF ) ) goto done;
       }
     }
   else if( vfCtrl->method == SLI )  /* single line integration */
     {
+    R8 dF[MAXNV1*MAXNVT*7];  /* V1LIpart() values of the nested points */
 #if( DEBUG > 1 )
     fprintf( _ulog, " 1LI" );
 #endif
-    for( nDiv=1; nDiv<5; nDiv++ )
+    if( q1 )
+      { rc1 = q1->rc; dv1 = q1->ndv; }
+    else
+      DivideEdgesNested( srf1->nv, srf1->v, rc1, dv1 );
+    for( nDiv=1; nDiv<4; nDiv++ )
       {
       AF0 = AF1;
-      DivideEdges( nDiv, srf1->nv, srf1->v, _rc1, _dv1 );
-      AF1 = View1LI( nDiv, srf1->nv, _rc1, _dv1, srf1->v, srf2->nv, srf2->v );
+      AF1 = View1LI( nDiv, srf1->nv, rc1, dv1, srf1->v, srf2->nv, srf2->v,
+        dF );
 #if( DEBUG > 1 )
       fprintf( _ulog, " %g", AF1 );
 #endif
-      if( fabs(AF1 - AF0) < vfCtrl->epsAF ) goto done;
+      if( Converged( nDiv, AF0, AF1, &dAF, vfCtrl->epsAF ) ) goto done;
       }
     }
   else if( vfCtrl->method == DLI )  /* double line integration */
@@ -127,13 +196,19 @@ R8 ViewUnobstructed( VFCTRL *vfCtrl, IX row, IX col )
     for( nDiv=1; nDiv<5; nDiv++ )
       {
       AF0 = AF1;
-      DivideEdges( nDiv, srf1->nv, srf1->v, _rc1, _dv1 );
-      DivideEdges( nDiv, srf2->nv, srf2->v, _rc2, _dv2 );
-      AF1 = View2LI( nDiv, srf1->nv, _rc1, _dv1, nDiv, srf2->nv, _rc2, _dv2 );
+      if( q1 )
+        { rc1 = q1->rc; dv1 = q1->dv[nDiv-1]; }
+      else
+        DivideEdges( nDiv, srf1->nv, srf1->v, rc1, dv1 );
+      if( q2 )
+        { rc2 = q2->rc; dv2 = q2->dv[nDiv-1]; }
+      else
+        DivideEdges( nDiv, srf2->nv, srf2->v, rc2, dv2 );
+      AF1 = View2LI( nDiv, srf1->nv, rc1, dv1, nDiv, srf2->nv, rc2, dv2 );
 #if( DEBUG > 1 )
       fprintf( _ulog, " %g", AF1 );
 #endif
-      if( fabs(AF1 - AF0) < vfCtrl->epsAF ) goto done;
+      if( Converged( nDiv, AF0, AF1, &dAF, vfCtrl->epsAF ) ) goto done;
       }
     }
     
@@ -141,7 +216,7 @@ R8 ViewUnobstructed( VFCTRL *vfCtrl, IX row, IX col )
 #if( DEBUG > 1 )
   if( vfCtrl->method < ALI )
     fprintf( _ulog, " Fixing view factor\n" );
-  fprintf( _ulog, " ALI" );
+  fprintf( _ulog, (vfCtrl->relSep < RCTSEP) ? " EXA" : " ALI" );
 #endif
 #if( DEBUG == 1 )
   if( vfCtrl->method < ALI )
@@ -150,7 +225,10 @@ R8 ViewUnobstructed( VFCTRL *vfCtrl, IX row, IX col )
       vfCtrl->rcRatio, vfCtrl->relSep, AF0, AF1 );
 #endif
 
-  AF1 = ViewALI( srf1->nv, srf1->v, srf2->nv, srf2->v, vfCtrl );
+  if( vfCtrl->relSep < RCTSEP )
+    AF1 = ViewExact( srf1->nv, srf1->v, srf2->nv, srf2->v );
+  else
+    AF1 = ViewALI( srf1->nv, srf1->v, srf2->nv, srf2->v, vfCtrl );
 
 #if( DEBUG == 1 )
   if( vfCtrl->method < ALI )
@@ -158,6 +236,8 @@ R8 ViewUnobstructed( VFCTRL *vfCtrl, IX row, IX col )
 #endif
   if( vfCtrl->method == ALI )  /* adaptive line integration */
     nDiv = 2;                /* for bins[][] report */
+  else
+    nDiv = 5;                /* fixed; 1AI and 1LI use only 3 levels */
 #if( DEBUG > 1 )
   fprintf( _ulog, " %g", AF1 );
 #endif
@@ -172,6 +252,46 @@ done:
 
   }  /* end ViewUnobstructed */
 
+/***  Converged.c  ***********************************************************/
+
+/*  Test convergence of the sequence of AF estimates of ViewUnobstructed():  
+ *  AF1 is accepted when it differs from AF0 by less than EPS, or when 
+ *  the differences of the last two levels predict an error of AF1 less 
+ *  than EPS.  The rules converge at least geometrically, so the error 
+ *  of AF1 is about |AF1-AF0| * |AF1-AF0| / |AF0-AF(-1)|.  *dAF holds 
+ *  |AF0-AF(-1)| on entry and |AF1-AF0| on return.  */
+
+IX Converged( IX nDiv, R8 AF0, R8 AF1, R8 *dAF, R8 eps )
+  {
+  R8 d = fabs(AF1 - AF0);
+
+  if( d < eps ) return 1;
+  if( nDiv > 2 && d * d < eps * *dAF ) return 1;
+  *dAF = d;
+
+  return 0;
+
+  }  /* end Converged */
+
+#if( DEBUG > 0 )
+/***  SoaCheck.c  ************************************************************/
+
+/*  Compare AF from structure-of-arrays kernel NAME with AFS from the 
+ *  scalar kernel.  They use different order of operations and precision, 
+ *  so only round-off differences are expected.  AF is at most AREA, the 
+ *  area of surface 1, which scales the tolerance.  */
+
+void SoaCheck( R8 AF, R8 AFs, R8 area, I1 *name )
+  {
+  R8 d = fabs(AF - AFs) / area;
+
+  if( d > 1.0e-5 )
+    error( 1, __FILE__, __LINE__, name, " differs from scalar kernel by ",
+      FltStr(d,3), " * area", "" );
+
+  }  /* end SoaCheck */
+#endif
+
 /***  View2AI.c  *************************************************************/
 
 /*  Compute direct interchange area by double area integration.
@@ -203,8 +323,486 @@ R8 View2AI( const IX nss1, const DIRCOS *dc1, const VERTEX3D *pt1, const R4 *are
 
   }  /* end View2AI */
 
+/***  View2AIsoa.c  **********************************************************/
+
+/*  Compute direct interchange area by double area integration, as View2AI(), 
+ *  with the points of surface 2 in structure-of-arrays form padded to a 
+ *  multiple of SOAW points with zero weights (see PointsSoa()).  The SOAW 
+ *  lanes of the inner loop are independent, so compilers turn them into 
+ *  vector instructions; SIMDCLONES adds versions for wider vectors.  */
+
+SIMDCLONES
+R8 View2AIsoa( const IX nss1, const DIRCOS *dc1, const VERTEX3D *pt1,
+  const R4 *area1, const IX nss2, const DIRCOS *dc2, const R8 *x2,
+  const R8 *y2, const R8 *z2, const R8 *w2 )
+/* nss2 - number of points of surface 2; a multiple of SOAW.
+ * x2, y2, z2 - coordinates of points of surface 2.
+ * w2   - weights * area of points of surface 2. */
+  {
+  R8 acc[SOAW];  /* sums of each lane */
+  R8 sum=0.0;
+  IX i, j, k;
+
+  for( k=0; k<SOAW; k++ )
+    acc[k] = 0.0;
+  for( i=0; i<nss1; i++ )
+    {
+    R8 px=pt1[i].x, py=pt1[i].y, pz=pt1[i].z, a1=area1[i];
+    for( j=0; j<nss2; j+=SOAW )
+      for( k=0; k<SOAW; k++ )
+        {
+        R8 vx = x2[j+k] - px;
+        R8 vy = y2[j+k] - py;
+        R8 vz = z2[j+k] - pz;
+        R8 r2 = vx * vx + vy * vy + vz * vz;
+        acc[k] += (vx * dc1->x + vy * dc1->y + vz * dc1->z)
+                * (vx * dc2->x + vy * dc2->y + vz * dc2->z)
+                * a1 * w2[j+k] / ( r2 * r2 );
+        }
+    }
+  for( k=0; k<SOAW; k++ )
+    sum -= acc[k];
+
+  sum *= PIinv;             /* divide by pi */
+
+  return sum;
+
+  }  /* end View2AIsoa */
+
+/***  PointsSoa.c  ***********************************************************/
+
+/*  Copy N points PT and weights WT of SubSrf() to arrays X, Y, Z and W. 
+ *  Pad with copies of the last point and zero weights to a multiple of 
+ *  SOAW points, which is returned.  */
+
+IX PointsSoa( const IX n, const VERTEX3D *pt, const R4 *wt,
+  R8 *x, R8 *y, R8 *z, R8 *w )
+  {
+  IX j, np=SOAW*((n+SOAW-1)/SOAW);
+
+  for( j=0; j<np; j++ )
+    {
+    IX jj = (j < n) ? j : n-1;
+    x[j] = pt[jj].x;
+    y[j] = pt[jj].y;
+    z[j] = pt[jj].z;
+    w[j] = (j < n) ? wt[j] : 0.0;
+    }
+
+  return np;
+
+  }  /* end PointsSoa */
+
 /*  View1AI() is in viewobs.c  */
 
+/***  RectPair.c  ************************************************************/
+
+/*  Return 1 if surfaces 1 and 2 are rectangles whose edges are all 
+ *  parallel or perpendicular to each other, e.g., parallel or 
+ *  perpendicular axis-aligned rectangles; then ViewRect() applies.  */
+
+IX RectPair( const SRFDAT3X *srf1, const SRFDAT3X *srf2 )
+  {
+  R8 e[4][3];   /* unit vectors of edges 0 and 1 of surfaces 1 and 2 */
+  R8 len, dot;
+  IX i, j, k;
+
+  if( srf1->nv != 4 || srf2->nv != 4 ) return 0;
+  for( i=0; i<4; i++ )
+    {
+    const VERTEX3D *v = (i < 2) ? srf1->v : srf2->v;
+    j = i & 1;
+    e[i][0] = (R8)v[j+1].x - (R8)v[j].x;
+    e[i][1] = (R8)v[j+1].y - (R8)v[j].y;
+    e[i][2] = (R8)v[j+1].z - (R8)v[j].z;
+    len = sqrt( e[i][0]*e[i][0] + e[i][1]*e[i][1] + e[i][2]*e[i][2] );
+    if( len == 0.0 ) return 0;
+    for( k=0; k<3; k++ )
+      e[i][k] /= len;
+    }
+
+  dot = e[0][0]*e[1][0] + e[0][1]*e[1][1] + e[0][2]*e[1][2];
+  if( fabs(dot) > RECTTOL ) return 0;      /* surface 1 not a rectangle */
+  dot = e[2][0]*e[3][0] + e[2][1]*e[3][1] + e[2][2]*e[3][2];
+  if( fabs(dot) > RECTTOL ) return 0;      /* surface 2 not a rectangle */
+  for( i=0; i<2; i++ )
+    for( j=2; j<4; j++ )
+      {
+      dot = fabs( e[i][0]*e[j][0] + e[i][1]*e[j][1] + e[i][2]*e[j][2] );
+      if( dot > RECTTOL && dot < 1.0 - RECTTOL ) return 0;
+      }
+
+  return 1;
+
+  }  /* end RectPair */
+
+/***  ViewRect.c  ************************************************************/
+
+/*  Compute direct interchange area of two rectangles accepted by 
+ *  RectPair() in closed form.  In the double line integral, 
+ *  AF = 1/(2*pi) * sum of integrals of ln(r) ds1.ds2 over edge pairs, 
+ *  only parallel edges contribute, and each of those integrals is exact 
+ *  (RectEdges).  This covers the parallel and perpendicular rectangle 
+ *  formulas with any offset along their edges.  */
+
+R8 ViewRect( const SRFDAT3X *srf1, const SRFDAT3X *srf2 )
+  {
+  R8 e[4][3];      /* unit vectors of the edges of surface 1 */
+  R8 len1[4];      /* lengths of the edges of surface 1 */
+  R8 d[3];         /* edge J of surface 2 */
+  R8 p[3];         /* start of edge J relative to start of edge I */
+  R8 len2, dot, c, h2, w;
+  R8 sum=0.0;      /* double because of large +/- operations */
+  IX i, j, k;
+
+  for( i=0; i<4; i++ )
+    {
+    k = (i + 1) % 4;
+    e[i][0] = (R8)srf1->v[k].x - (R8)srf1->v[i].x;
+    e[i][1] = (R8)srf1->v[k].y - (R8)srf1->v[i].y;
+    e[i][2] = (R8)srf1->v[k].z - (R8)srf1->v[i].z;
+    len1[i] = sqrt( e[i][0]*e[i][0] + e[i][1]*e[i][1] + e[i][2]*e[i][2] );
+    for( k=0; k<3; k++ )
+      e[i][k] /= len1[i];
+    }
+
+  for( j=0; j<4; j++ )
+    {
+    k = (j + 1) % 4;
+    d[0] = (R8)srf2->v[k].x - (R8)srf2->v[j].x;
+    d[1] = (R8)srf2->v[k].y - (R8)srf2->v[j].y;
+    d[2] = (R8)srf2->v[k].z - (R8)srf2->v[j].z;
+    len2 = sqrt( d[0]*d[0] + d[1]*d[1] + d[2]*d[2] );
+    for( i=0; i<4; i++ )
+      {
+      dot = e[i][0]*d[0] + e[i][1]*d[1] + e[i][2]*d[2];
+      if( fabs(dot) < 0.5 * len2 ) continue;   /* perpendicular edges */
+      p[0] = (R8)srf2->v[j].x - (R8)srf1->v[i].x;  /* J start from I start */
+      p[1] = (R8)srf2->v[j].y - (R8)srf1->v[i].y;
+      p[2] = (R8)srf2->v[j].z - (R8)srf1->v[i].z;
+      c = p[0]*e[i][0] + p[1]*e[i][1] + p[2]*e[i][2];
+      for( h2=0.0,k=0; k<3; k++ )   /* squared distance between lines */
+        h2 += (p[k] - c*e[i][k]) * (p[k] - c*e[i][k]);
+      w = (dot > 0.0) ? c + len2 : c - len2;    /* J end along I */
+      sum += RectEdges( len1[i] - c, h2 ) - RectEdges( len1[i] - w, h2 )
+           - RectEdges( c, h2 ) + RectEdges( w, h2 );
+      }
+    }
+
+  sum *= PIt2inv;          /* divide by 2*pi */
+
+  return sum;
+
+  }  /* end ViewRect */
+
+/***  RectEdges.c  ***********************************************************/
+
+/*  Second integral along two parallel lines, H2 apart, of ln(r):
+ *  G(u) = (u^2 - h^2)/4 * ln(u^2 + h^2) + h*u*atan(u/h), where U is the 
+ *  offset along the lines; G" = ln(r) + 3/2, and the constant part 
+ *  cancels in the sum over the closed edges of both rectangles.  */
+
+R8 RectEdges( R8 u, R8 h2 )
+  {
+  R8 u2=u*u, h;
+
+  if( h2 == 0.0 )
+    return (u2 > 0.0) ? 0.25 * u2 * log( u2 ) : 0.0;
+  h = sqrt( h2 );
+
+  return 0.25 * (u2 - h2) * log( u2 + h2 ) + h * u * atan( u / h );
+
+  }  /* end RectEdges */
+
+/***  ViewExact.c  ***********************************************************/
+
+/*  Compute direct interchange area of two convex polygons in closed form.
+ *  As in View2LI(), AF = 1/(2*pi) * sum over edge pairs of 
+ *  dot(i,j) * integral of ln(r) over edges i and j, but each double 
+ *  integral is exact:  RectEdges() for parallel edges, ExactEdges() 
+ *  for edges in general position, in a common plane, or sharing 
+ *  a vertex.  No edge divisions or adaptive steps are needed.  */
+
+R8 ViewExact( const IX nv1, const VERTEX3D *v1,
+              const IX nv2, const VERTEX3D *v2 )
+/* nv1 - number of vertices/edges of polygon 1.
+ * v1  - vector of vertices of polygon 1.
+ * nv2 - number of vertices/edges of polygon 2.
+ * v2  - vector of vertices of polygon 2.
+ */
+  {
+  R8 a[MAXNV1][3];  /* unit vectors of the edges of polygon 1 */
+  R8 la[MAXNV1];    /* lengths of the edges of polygon 1 */
+  R8 b[3], lb;      /* unit vector and length of edge j of polygon 2 */
+  R8 p[3];          /* start of edge j relative to start of edge i */
+  R8 x[3];          /* cross product of edges i and j */
+  R8 dot, sinA, c, h2, w, sumt;
+  R8 sum=0.0;       /* double because of large +/- operations */
+  IX i, im1,        /* polygon 1 edge index */
+     j, jm1,        /* polygon 2 edge index */
+     k;
+
+  im1 = nv1 - 1;
+  for( i=0; i<nv1; im1=i++ )     /* for all edges of polygon 1 */
+    {
+    a[i][0] = (R8)v1[i].x - (R8)v1[im1].x;
+    a[i][1] = (R8)v1[i].y - (R8)v1[im1].y;
+    a[i][2] = (R8)v1[i].z - (R8)v1[im1].z;
+    la[i] = sqrt( a[i][0]*a[i][0] + a[i][1]*a[i][1] + a[i][2]*a[i][2] );
+    for( k=0; k<3; k++ )
+      a[i][k] /= la[i];
+    }
+
+  jm1 = nv2 - 1;
+  for( j=0; j<nv2; jm1=j++ )   /* for all edges of polygon 2 */
+    {
+    b[0] = (R8)v2[j].x - (R8)v2[jm1].x;
+    b[1] = (R8)v2[j].y - (R8)v2[jm1].y;
+    b[2] = (R8)v2[j].z - (R8)v2[jm1].z;
+    lb = sqrt( b[0]*b[0] + b[1]*b[1] + b[2]*b[2] );
+    for( k=0; k<3; k++ )
+      b[k] /= lb;
+
+    im1 = nv1 - 1;
+    for( i=0; i<nv1; im1=i++ )     /* for all edges of polygon 1 */
+      {
+      dot = a[i][0]*b[0] + a[i][1]*b[1] + a[i][2]*b[2];
+      if( fabs(dot) <= EPS2 ) continue;
+      x[0] = a[i][1]*b[2] - a[i][2]*b[1];
+      x[1] = a[i][2]*b[0] - a[i][0]*b[2];
+      x[2] = a[i][0]*b[1] - a[i][1]*b[0];
+      sinA = sqrt( x[0]*x[0] + x[1]*x[1] + x[2]*x[2] );
+      p[0] = (R8)v2[jm1].x - (R8)v1[im1].x;
+      p[1] = (R8)v2[jm1].y - (R8)v1[im1].y;
+      p[2] = (R8)v2[jm1].z - (R8)v1[im1].z;
+      if( sinA < EXACTPAR )    /* parallel edges */
+        {
+        c = p[0]*a[i][0] + p[1]*a[i][1] + p[2]*a[i][2];
+        for( h2=0.0,k=0; k<3; k++ )
+          h2 += (p[k] - c*a[i][k]) * (p[k] - c*a[i][k]);
+        w = (dot > 0.0) ? c + lb : c - lb;
+        sumt = RectEdges( la[i] - c, h2 ) - RectEdges( la[i] - w, h2 )
+             - RectEdges( c, h2 ) + RectEdges( w, h2 );
+        if( dot < 0.0 )
+          sumt = -sumt;
+        sumt -= 1.5 * la[i] * lb;   /* constant part of RectEdges() */
+        }
+      else
+        sumt = ExactEdges( a[i], la[i], b, lb, p, dot, sinA );
+      sum += dot * sumt;
+      }  /* end i loop */
+    }  /* end j loop */
+
+  sum *= PIt2inv;          /* divide by 2*pi */
+
+  return sum;
+
+  }  /* end of ViewExact */
+
+/***  ExactEdges.c  **********************************************************/
+
+/*  Integral of ln(r) over two non-parallel edges:  s along edge 1 of 
+ *  length LA and t along edge 2 of length LB, starting at P relative to 
+ *  the start of edge 1.  With s and t measured from the closest points 
+ *  of the two lines, d apart, r^2 = s^2 + t^2 - 2*s*t*cosA + d^2.  
+ *  The map x = s - t*cosA, y = t*sinA takes the (s,t) rectangle to 
+ *  a parallelogram where r^2 = x^2 + y^2 + d^2, and the integral over 
+ *  the parallelogram is reduced to its sides (ExactSide).  */
+
+R8 ExactEdges( const R8 *a, const R8 la, const R8 *b, const R8 lb,
+               const R8 *p, const R8 cosA, const R8 sinA )
+/* a, b - unit vectors along edges 1 and 2.
+ * la, lb - lengths of edges 1 and 2.
+ * p - start of edge 2 relative to start of edge 1.
+ * cosA, sinA - cosine and sine of the angle between the edges.
+ */
+  {
+  R8 ap, bp;     /* projections of P on the edges */
+  R8 s0, t0;     /* closest points of the two lines */
+  R8 d, dv[3];   /* distance between the lines */
+  R8 s[2], t[2]; /* limits of s and t */
+  R8 px[4], py[4];  /* corners of the parallelogram */
+  R8 dx, dy, len, h, lA, lB;
+  R8 sum=0.0;
+  IX i, k;
+
+  ap = a[0]*p[0] + a[1]*p[1] + a[2]*p[2];
+  bp = b[0]*p[0] + b[1]*p[1] + b[2]*p[2];
+  s0 = (ap - cosA * bp) / (sinA * sinA);
+  t0 = s0 * cosA - bp;
+  for( d=0.0,k=0; k<3; k++ )
+    {
+    dv[k] = s0 * a[k] - p[k] - t0 * b[k];
+    d += dv[k] * dv[k];
+    }
+  d = sqrt( d );
+  if( d < 1.0e-9 * (la + lb) )   /* lines in a common plane */
+    d = 0.0;
+
+  s[0] = -s0;
+  s[1] = la - s0;
+  t[0] = -t0;
+  t[1] = lb - t0;
+  for( i=0; i<4; i++ )   /* counterclockwise corners */
+    {
+    R8 si = s[(i == 1 || i == 2) ? 1 : 0];
+    R8 ti = t[(i < 2) ? 0 : 1];
+    px[i] = si - ti * cosA;
+    py[i] = ti * sinA;
+    }
+
+  for( i=0; i<4; i++ )   /* sides of the parallelogram */
+    {
+    k = (i + 1) % 4;
+    dx = px[k] - px[i];
+    dy = py[k] - py[i];
+    len = sqrt( dx*dx + dy*dy );
+    h = (px[i] * dy - py[i] * dx) / len;   /* distance from origin */
+    lA = (px[i] * dx + py[i] * dy) / len;  /* ends along the side */
+    lB = (px[k] * dx + py[k] * dy) / len;
+    sum += ExactSide( lA, lB, h, d );
+    }
+
+  return sum / sinA;
+
+  }  /* end ExactEdges */
+
+/***  ExactSide.c  ***********************************************************/
+
+/*  Flux through one side of a polygon, from LA to LB along a line at 
+ *  distance H from the origin, of the field (x,y)*F(rho)/rho^2 whose 
+ *  divergence is ln(sqrt(rho^2+d^2)):  F(rho) = ((rho^2+d^2)*ln(rho^2+d^2) 
+ *  - rho^2 - d^2*ln(d^2)) / 4.  The integral along the side uses, 
+ *  with rho^2 = l^2 + h^2 and q^2 = h^2 + d^2,
+ *   ln(l^2+q^2) dl  ->  l*ln(l^2+q^2) - 2*l + 2*q*atan(l/q),
+ *   dl / (l^2+h^2)  ->  atan(l/h) / h,
+ *   ln(l^2+q^2) / (l^2+h^2) dl  ->  Im( sum for B = h+q and h-q of 
+ *     ln(i*B)*ln(l-i*h) - Li2((h+i*l)/B) ) / h.  */
+
+R8 ExactSide( const R8 lA, const R8 lB, const R8 h, const R8 d )
+  {
+  R8 ah, q, d2, bb[2], sum=0.0;
+  R8 l, v, lnu, argu, im;
+  IX i, n;
+  CPLX z;
+
+  if( h == 0.0 ) return 0.0;   /* side through the origin */
+  ah = fabs( h );              /* integrand depends on h^2 */
+  d2 = d * d;
+  q = sqrt( ah*ah + d2 );
+  bb[0] = ah + q;
+  bb[1] = -d2 / (q + ah);      /* h - q without round-off */
+
+  for( n=0; n<2; n++ )
+    {
+    l = (n == 0) ? lA : lB;
+    v = l * log( l*l + q*q ) - 3.0 * l + 2.0 * q * atan( l / q );
+    if( d2 > 0.0 )
+      {
+      lnu = 0.5 * log( l*l + ah*ah );  /* ln(l - i*h) */
+      argu = atan2( -ah, l );
+      for( im=0.0,i=0; i<2; i++ )
+        {
+        im += log( fabs(bb[i]) ) * argu
+            + ((bb[i] > 0.0) ? PId2 : -PId2) * lnu;
+        z.re = ah / bb[i];
+        z.im = l / bb[i];
+        im -= CLi2( z ).im;
+        }
+      v += d2 * (im - log( d2 ) * atan( l / ah )) / ah;
+      }
+    sum += (n == 0) ? -v : v;
+    }
+
+  return 0.25 * h * sum;
+
+  }  /* end ExactSide */
+
+/***  CLi2.c  ****************************************************************/
+
+/*  Dilogarithm of complex Z not on the real axis beyond 1:  reduce Z 
+ *  to |Z| <= 1, Re(Z) <= 1/2 and sum the Bernoulli series in 
+ *  w = -ln(1-Z).  */
+
+CPLX CLi2( CPLX z )
+  {
+  static R8 bern[12] = { 1.0, -0.25, 0.027777777777777776,
+    -2.777777777777778e-4, 4.72411186696901e-6, -9.185773074661964e-8,
+    1.8978869988971e-9, -4.0647616451442256e-11, 8.921691020456452e-13,
+    -1.9939295860721074e-14, 4.518980029619918e-16,
+    -1.0356517612181247e-17 };  /* B(k)/(k+1)!, k = 0, 1, 2, 4, ... 20 */
+  CPLX add, w, wk, u, s;
+  R8 sign=1.0, t;
+  IX k;
+
+  add.re = add.im = 0.0;
+      /* |z| > 1:  Li2(z) = -pi^2/6 - ln(-z)^2/2 - Li2(1/z) */
+  if( z.re*z.re + z.im*z.im > 1.0 )
+    {
+    u.re = -z.re;
+    u.im = -z.im;
+    u = CLog( u );
+    add.re = -PI2d6 - 0.5 * (u.re*u.re - u.im*u.im);
+    add.im = -u.re * u.im;
+    sign = -1.0;
+    t = z.re*z.re + z.im*z.im;
+    z.re /= t;
+    z.im /= -t;
+    }
+  if( z.re > 0.5 )  /* Li2(z) = pi^2/6 - ln(z)*ln(1-z) - Li2(1-z) */
+    {
+    w = CLog( z );
+    u.re = 1.0 - z.re;
+    u.im = -z.im;
+    u = CLog( u );
+    add.re += sign * (PI2d6 - (w.re*u.re - w.im*u.im));
+    add.im -= sign * (w.re*u.im + w.im*u.re);
+    sign = -sign;
+    z.re = 1.0 - z.re;
+    z.im = -z.im;
+    }
+
+  u.re = 1.0 - z.re;
+  u.im = -z.im;
+  w = CLog( u );
+  w.re = -w.re;
+  w.im = -w.im;
+  s.re = w.re + bern[1] * (w.re*w.re - w.im*w.im);
+  s.im = w.im + bern[1] * 2.0 * w.re * w.im;
+  wk = w;                     /* w^(k+1) for even k */
+  u.re = w.re*w.re - w.im*w.im;
+  u.im = 2.0 * w.re * w.im;   /* w^2 */
+  for( k=2; k<12; k++ )
+    {
+    t = wk.re * u.re - wk.im * u.im;
+    wk.im = wk.re * u.im + wk.im * u.re;
+    wk.re = t;
+    s.re += bern[k] * wk.re;
+    s.im += bern[k] * wk.im;
+    }
+
+  s.re = add.re + sign * s.re;
+  s.im = add.im + sign * s.im;
+
+  return s;
+
+  }  /* end CLi2 */
+
+/***  CLog.c  ****************************************************************/
+
+/*  Principal natural logarithm of complex Z.  */
+
+CPLX CLog( CPLX z )
+  {
+  CPLX u;
+
+  u.re = 0.5 * log( z.re*z.re + z.im*z.im );
+  u.im = atan2( z.im, z.re );
+
+  return u;
+
+  }  /* end CLog */
+
 /***  View2LI.c  *************************************************************/
 
 /*  Compute direct interchange area by double line integration. 
@@ -266,17 +864,21 @@ R8 View2LI( const IX nd1, const IX nv1, const EDGEDCS *rc1, const EDGEDIV **dv1,
  *  subdivisions of those edges for numerical integration. 
  *  Surface 2 described by its vertices.  */
 
-R8 View1LI( const IX nd1, const IX nv1, const EDGEDCS *rc1,
-  const EDGEDIV **dv1, const VERTEX3D *v1, const IX nv2, const VERTEX3D *v2 )
-/* nd1 - number of edge divisions of polygon 1.
+R8 View1LI( const IX level, const IX nv1, const EDGEDCS *rc1,
+  const EDGEDIV **dv1, const VERTEX3D *v1, const IX nv2, const VERTEX3D *v2,
+  R8 *part )
+/* level - 1, 2 or 3:  use 1, 3 or 7 points of DivideEdgesNested().
  * nv1 - number of vertices/edges of polygon 1.
  * rc1 - vector of direction cosines of edges of polygon 1.
- * dv1 - array of edge divisions of polygon 1.
+ * dv1 - array of nested edge divisions of polygon 1.
  * v1  - vector of vertices of polygon 1.
  * nv2 - number of vertices/edges of polygon 2.
  * v2  - vector of vertices of polygon 2.
+ * part - V1LIpart() values [nv2*nv1*7]; values of the lower levels 
+ *        are reused and those of the new points of LEVEL are added.
  */
   {
+  static const IX last[4] = { 0, 1, 3, 7 };  /* points of each level */
   R8 sum, sumt;  /* double because of large +/- operations */
   IX i, im1,  /* surface 1 edge index */
      j, jm1,  /* surface 2 edge index */
@@ -302,28 +904,29 @@ R8 View1LI( const IX nd1, const IX nv1, const EDGEDCS *rc1,
     im1 = nv1 - 1;
     for( i=0; i<nv1; im1=i++ )
       {
-      IX parallel=1;  /* true if edges i and j are parallel */
+      R8 *dF = part + 7*(nv1*j + i);  /* V1LIpart() values of edge i */
       R8 dot = VDOT( (&B), (rc1+i) ) * binv;
       if( fabs(dot) <= EPS * b ) continue;
-      if( fabs(dot) < 1.0-EPS )
-        parallel = 0;
-      for( sumt=0.0,n=0; n<nd1; n++ )    /* numeric integration */
-        {
-        IX close;
-        sumt += V1LIpart( (void*)(dv1[i]+n), v2+jm1, v2+j, &B, b2, &close )
-              * dv1[i][n].s;
-        if( parallel && close ) break;   /* colinear edges */
-        }  /* end numeric integration */
-
-      if( n==nd1 )
+      if( fabs(dot) >= 1.0-EPS )  /* parallel edges */
         {
-        sum += dot * sumt * binv;
+        VECTOR3D S, SxB;
+        VECTOR( (v2+jm1), (dv1[i]+0), (&S) );
+        VCROSS( (&S), (&B), (&SxB) );
+        if( VDOT( (&SxB), (&SxB) ) <= EPS2*b2 )
+          {              /* colinear edges ==> analytic solution */
+          sumt = V1LIxact( v1+im1, v1+i, rc1[i].s, v2+jm1, v2+j, b );
+          sum += dot * sumt;
+          continue;
+          }
         }
-      else               /* colinear edges ==> analytic solution */
+      for( n=last[level-1]; n<last[level]; n++ )  /* new points */
         {
-        sumt = V1LIxact( v1+im1, v1+i, rc1[i].s, v2+jm1, v2+j, b );
-        sum += dot * sumt;
+        IX close;
+        dF[n] = V1LIpart( (void*)(dv1[i]+n), v2+jm1, v2+j, &B, b2, &close );
         }
+      for( sumt=0.0,n=0; n<last[level]; n++ )    /* numeric integration */
+        sumt += _pqw[level-1][n] * dF[n];
+      sum += dot * sumt * rc1[i].s * binv;
       }  /* end i loop */
     }  /* end j loop */
 
@@ -611,37 +1214,30 @@ R8 ViewALI( const IX nv1, const VERTEX3D *v1,
 
 /***  ViewsInit.c  ***********************************************************/
 
-/*  Allocate / free arrays local to this file based on INIT.
- *  Initialize Gaussian integration coefficients.  
- *  Store G coefficients in vectors emulating triangular arrays.  */
+/*  Allocate / free the edge arrays of vfCtrl based on INIT.
+ *  Each thread has its own vfCtrl and therefore its own arrays.  */
 
-void ViewsInit( IX maxDiv, IX init )
+void ViewsInit( IX maxDiv, IX init, VFCTRL *vfCtrl )
   {
-  static IX maxRC1;    /* max number of values in RC1 */
-  static IX maxRC2;    /* max number of values in RC2 */
-  static IX maxDV1;    /* max number of values in DV1 */
-  static IX maxDV2;    /* max number of values in DV2 */
+  IX maxRC1 = MAXNV1;       /* max number of values in RC1 */
+  IX maxRC2 = MAXNVT;       /* max number of values in RC2 */
+  IX maxDV1 = maxDiv - 1;   /* max number of values in DV1 */
+  IX maxDV2 = maxDiv - 1;   /* max number of values in DV2 */
 
   if( init )
     {
-    maxRC1 = MAXNV1;
-    _rc1 = Alc_V( 0, maxRC1, sizeof(EDGEDCS), "rc1" );
-    maxDV1 = maxDiv - 1;
-    _dv1 = Alc_MC( 0, maxRC1, 0, maxDV1, sizeof(EDGEDIV), "dv1" );
-    maxRC2 = MAXNVT;
-    _rc2 = Alc_V( 0, maxRC2, sizeof(EDGEDCS), "rc2" );
-    maxDV2 = maxDiv - 1;
-    _dv2 = Alc_MC( 0, maxRC2, 0, maxDV2, sizeof(EDGEDIV), "dv2" );
+    vfCtrl->rc1 = Alc_V( 0, maxRC1, sizeof(EDGEDCS), "rc1" );
+    vfCtrl->dv1 = Alc_MC( 0, maxRC1, 0, maxDV1, sizeof(EDGEDIV), "dv1" );
+    vfCtrl->rc2 = Alc_V( 0, maxRC2, sizeof(EDGEDCS), "rc2" );
+    vfCtrl->dv2 = Alc_MC( 0, maxRC2, 0, maxDV2, sizeof(EDGEDIV), "dv2" );
     }
 
   else
     {
-    Fre_MC( _dv2, 0, maxRC2, 0, maxDV2, sizeof(EDGEDIV), "dv2" );
-    Fre_V( _rc2, 0, maxRC2, sizeof(EDGEDCS), "rc2" );
-    Fre_MC( _dv1, 0, maxRC1, 0, maxDV1, sizeof(EDGEDIV), "dv1" );
-    Fre_V( _rc1, 0, maxRC1, sizeof(EDGEDCS), "rc1" );
-    fprintf( _ulog, "Total line integral points evaluated:    %8lu\n",
-      _usedV1LIpart );
+    Fre_MC( vfCtrl->dv2, 0, maxRC2, 0, maxDV2, sizeof(EDGEDIV), "dv2" );
+    Fre_V( vfCtrl->rc2, 0, maxRC2, sizeof(EDGEDCS), "rc2" );
+    Fre_MC( vfCtrl->dv1, 0, maxRC1, 0, maxDV1, sizeof(EDGEDIV), "dv1" );
+    Fre_V( vfCtrl->rc1, 0, maxRC1, sizeof(EDGEDCS), "rc1" );
     }
 
   }  /* end ViewsInit */
@@ -717,6 +1313,161 @@ IX DivideEdges( IX nDiv, IX nVrt, VERTEX3D *Vrt, EDGEDCS *rc, EDGEDIV **dv )
 
   }  /* end of DivideEdges */
 
+/***  DivideEdgesNested.c  ***************************************************/
+
+/*  Divide edges of a polygon for nested quadrature:  the 1 point rule 
+ *  uses point 0, the 3 point Gauss rule points 0-2 and the 7 point 
+ *  Kronrod-Patterson rule points 0-6 with the weights of _pqw[][].  
+ *  The element length is that of the 7 point rule.  */
+
+void DivideEdgesNested( IX nVrt, VERTEX3D *Vrt, EDGEDCS *rc, EDGEDIV **dv )
+/* nVrt  - number of vertices/edges.
+ * Vrt  - coordinates of vertices.
+ * rc  - direction cosines of each edge.
+ * dv  - edge divisions for nested quadrature.
+ */
+  {
+  VECTOR3D V; /* vector betweeen successive vertices */
+  R4 s;    /* distance between vertices */
+  IX i, im1, j;
+
+  im1 = nVrt - 1;
+  for( i=0; i<nVrt; im1=i++ )  /* for all edges */
+    {
+    VECTOR( (Vrt+im1), (Vrt+i), (&V) );
+    rc[i].s = s = VLEN( (&V) );
+    rc[i].x = V.x / s;
+    rc[i].y = V.y / s;
+    rc[i].z = V.z / s;
+    for( j=0; j<7; j++ )  /* divide each edge */
+      {
+      dv[i][j].x = Vrt[im1].x + _pqx[j] * V.x;
+      dv[i][j].y = Vrt[im1].y + _pqx[j] * V.y;
+      dv[i][j].z = Vrt[im1].z + _pqx[j] * V.z;
+      dv[i][j].s = (R4)_pqw[2][j] * s;
+      }
+    }
+
+  }  /* end of DivideEdgesNested */
+
+/***  SrfQuadInit.c  *********************************************************/
+
+/*  Allocate the cache of surface quadrature data.  
+ *  Entries are computed by SrfQuad() as the surfaces are used.  */
+
+QUADCACHE *SrfQuadInit( IX nAllSrf, IX nThreads )
+  {
+  QUADCACHE *qc;
+
+  qc = Alc_E( sizeof(QUADCACHE), "quadCache" );
+  qc->srf = Alc_V( 1, nAllSrf, sizeof(SRFQUAD *), "quadSrf" );
+  qc->mem = Alc_ECI( 16*sizeof(SRFQUAD) + 32, "quadMem" );
+  if( nThreads > 1 )
+    qc->lock = ThrdLockAlc( );
+
+  return qc;
+
+  }  /* end SrfQuadInit */
+
+/***  SrfQuadFree.c  *********************************************************/
+
+/*  Free the cache of surface quadrature data.  */
+
+QUADCACHE *SrfQuadFree( QUADCACHE *qc, IX nAllSrf )
+  {
+  if( qc->lock )
+    qc->lock = ThrdLockFre( qc->lock );
+  qc->mem = Fre_EC( qc->mem, "quadMem" );
+  Fre_V( qc->srf, 1, nAllSrf, sizeof(SRFQUAD *), "quadSrf" );
+  Fre_E( qc, sizeof(QUADCACHE), "quadCache" );
+
+  return NULL;
+
+  }  /* end SrfQuadFree */
+
+/***  SrfQuad.c  *************************************************************/
+
+/*  Return the quadrature data of unclipped surface SRF:  Gaussian points 
+ *  and weights of SubSrf() and edge divisions of DivideEdges() for 
+ *  nDiv = 1 to 4, the points again as arrays for View2AIsoa(), and the 
+ *  nested points of SubSrfNested() and DivideEdgesNested().  They depend 
+ *  only on the surface, so they are computed the first time any pair 
+ *  needs them and then shared by all threads.  The entry is complete 
+ *  before ThrdStorePtr() publishes its pointer in qc->srf[], and 
+ *  ThrdLoadPtr() reads it, so other threads find either NULL or the 
+ *  finished data.  */
+
+SRFQUAD *SrfQuad( QUADCACHE *qc, SRFDAT3X *srf )
+  {
+  SRFQUAD *q;
+  IX i, n;
+
+  q = ThrdLoadPtr( (void **)(qc->srf + srf->nr) );
+  if( q ) return q;
+
+  if( qc->lock )
+    ThrdLock( qc->lock );
+  q = ThrdLoadPtr( (void **)(qc->srf + srf->nr) );  /* set by another thread? */
+  if( !q )
+    {
+    q = Alc_EC( &qc->mem, sizeof(SRFQUAD), "quadSrf" );
+    for( n=1; n<=4; n++ )
+      {
+      q->iPt[n] = q->iPt[n-1] + SubSrf( n, srf->nv, srf->v, srf->area,
+        q->gpt + q->iPt[n-1], q->wt + q->iPt[n-1] );
+      q->iSoa[n] = q->iSoa[n-1] + PointsSoa( q->iPt[n] - q->iPt[n-1],
+        q->gpt + q->iPt[n-1], q->wt + q->iPt[n-1], q->sx + q->iSoa[n-1],
+        q->sy + q->iSoa[n-1], q->sz + q->iSoa[n-1], q->sw + q->iSoa[n-1] );
+      for( i=0; i<srf->nv; i++ )
+        q->dv[n-1][i] = q->ediv[i] + _offset[n-1];
+      DivideEdges( n, srf->nv, srf->v, q->rc, q->dv[n-1] );
+      }
+    q->nNest = SubSrfNested( srf->nv, srf->v, srf->area,
+      q->npt, q->nwt, q->nwl );
+    for( i=0; i<srf->nv; i++ )
+      q->ndv[i] = q->nediv[i];
+    DivideEdgesNested( srf->nv, srf->v, q->rc, q->ndv );
+    ThrdStorePtr( (void **)(qc->srf + srf->nr), q );
+    }
+  if( qc->lock )
+    ThrdUnlock( qc->lock );
+
+  return q;
+
+  }  /* end SrfQuad */
+
+/***  QuadPoints.c  **********************************************************/
+
+/*  Point PT and WT to the Gaussian points and weights of Q for NDIV; 
+ *  return the number of points.  */
+
+IX QuadPoints( SRFQUAD *q, IX nDiv, VERTEX3D **pt, R4 **wt )
+  {
+  *pt = q->gpt + q->iPt[nDiv-1];
+  *wt = q->wt + q->iPt[nDiv-1];
+
+  return q->iPt[nDiv] - q->iPt[nDiv-1];
+
+  }  /* end QuadPoints */
+
+/***  QuadPointsSoa.c  *******************************************************/
+
+/*  Point X, Y, Z and W to the arrays of Gaussian points and weights of Q 
+ *  for NDIV; return the number of points, including padding.  */
+
+IX QuadPointsSoa( SRFQUAD *q, IX nDiv, R8 **x, R8 **y, R8 **z, R8 **w )
+  {
+  IX n = q->iSoa[nDiv-1];
+
+  *x = q->sx + n;
+  *y = q->sy + n;
+  *z = q->sz + n;
+  *w = q->sw + n;
+
+  return q->iSoa[nDiv] - n;
+
+  }  /* end QuadPointsSoa */
+
 /***  GQParallelogram.c  *****************************************************/
 
 /*  Compute Gaussian integration values for a parallelogram.  
@@ -875,3 +1626,137 @@ IX GQTriangle( const IX nDiv, const VERTEX3D *vt, VERTEX3D *p, R4 *w )
 
   }  /* end GQTriangle */
 
+/***  SubSrfNested.c  ********************************************************/
+
+/*  Set nested integration values for triangle or rectangle:  the coarse 
+ *  weights WL use the same points as the fine weights WT, so both AF 
+ *  estimates come from one set of view point calculations.  */
+
+IX SubSrfNested( const IX nv, const VERTEX3D *Sv, const R4 area,
+  VERTEX3D *Gpt, R4 *wt, R4 *wl )
+/* nv   - number of vertices, 3 or 4
+ * Sv   - coordinates of vertices
+ * area - of triangle or rectangle
+ * Gpt  - coordinates of integration points
+ * wt   - fine integration weights
+ * wl   - coarse integration weights */
+  {
+  IX nSubSrf;       /* number of subsurfaces */
+  IX n;
+
+  if( nv == 3 )
+    nSubSrf = GQTriangleNested( Sv, Gpt, wt, wl );
+  else
+    nSubSrf = GQParallelogramNested( Sv, Gpt, wt, wl );
+
+  for( n=0; n<nSubSrf; n++ )
+    {
+    wt[n] *= area;
+    wl[n] *= area;
+    }
+
+  return nSubSrf;
+
+  }  /* end SubSrfNested */
+
+/***  GQTriangleNested.c  ****************************************************/
+
+/*  Nested integration values for a triangle:  the 13-point rule of 
+ *  GQTriangle() (degree 7) with a 7-point rule (degree 3) on its centroid 
+ *  and first two 3-point orbits.  */
+
+IX GQTriangleNested( const VERTEX3D *vt, VERTEX3D *p, R4 *w, R4 *wl )
+/* vt   - vertices of triangle
+ * p    - coordinates of integration points
+ * w    - 13-point weights
+ * wl   - 7-point weights */
+  {
+  static const R4 gx[13][5] = {  /* ordinates & fine, coarse weights */
+     {0.33333333f, 0.33333333f, 0.33333333f, -0.14957004f, -2.72185573f },
+     {0.47930807f, 0.26034597f, 0.26034597f, 0.17561526f, 1.20082790f },
+     {0.26034597f, 0.47930807f, 0.26034597f, 0.17561526f, 1.20082790f },
+     {0.26034597f, 0.26034597f, 0.47930807f, 0.17561526f, 1.20082790f },
+     {0.86973979f, 0.06513010f, 0.06513010f, 0.05334724f, 0.03979068f },
+     {0.06513010f, 0.86973979f, 0.06513010f, 0.05334724f, 0.03979068f },
+     {0.06513010f, 0.06513010f, 0.86973979f, 0.05334724f, 0.03979068f },
+     {0.63844419f, 0.31286550f, 0.04869031f, 0.07711376f, 0.00000000f },
+     {0.63844419f, 0.04869031f, 0.31286550f, 0.07711376f, 0.00000000f },
+     {0.31286550f, 0.63844419f, 0.04869031f, 0.07711376f, 0.00000000f },
+     {0.31286550f, 0.04869031f, 0.63844419f, 0.07711376f, 0.00000000f },
+     {0.04869031f, 0.63844419f, 0.31286550f, 0.07711376f, 0.00000000f },
+     {0.04869031f, 0.31286550f, 0.63844419f, 0.07711376f, 0.00000000f }
+                             };  /* ordinates & weights */
+  IX j;
+
+  for( j=0; j<13; j++,p++ )
+    {
+    p->x = gx[j][0] * vt[0].x + gx[j][1] * vt[1].x + gx[j][2] * vt[2].x;
+    p->y = gx[j][0] * vt[0].y + gx[j][1] * vt[1].y + gx[j][2] * vt[2].y;
+    p->z = gx[j][0] * vt[0].z + gx[j][1] * vt[1].z + gx[j][2] * vt[2].z;
+    w[j] = gx[j][3];
+    wl[j] = gx[j][4];
+    }
+
+  return 13;
+
+  }  /* end GQTriangleNested */
+
+/***  GQParallelogramNested.c  ***********************************************/
+
+/*  Nested integration values for a parallelogram:  the 17-point rule 
+ *  of Genz and Malik (degree 7) with a 5-point rule (degree 3) on its 
+ *  center and outer axis points.
+ *  Points are given by fractions (s,t) along v[0]-v[1] and v[0]-v[3], 
+ *  interpolated as in GQParallelogram().  */
+
+IX GQParallelogramNested( const VERTEX3D *vp, VERTEX3D *p, R4 *w, R4 *wl )
+/* vp   - vertices of parallelogram
+ * p    - coordinates of integration points
+ * w    - 17-point weights
+ * wl   - 5-point weights */
+  {
+  static const R4 gx[17][4] = {  /* ordinates & fine, coarse weights */
+     {0.50000000f, 0.50000000f, -0.19387289f, 0.25925926f },
+     {0.32071571f, 0.50000000f, 0.14936747f, 0.00000000f },
+     {0.67928429f, 0.50000000f, 0.14936747f, 0.00000000f },
+     {0.50000000f, 0.32071571f, 0.14936747f, 0.00000000f },
+     {0.50000000f, 0.67928429f, 0.14936747f, 0.00000000f },
+     {0.02565835f, 0.50000000f, 0.05182137f, 0.18518519f },
+     {0.97434165f, 0.50000000f, 0.05182137f, 0.18518519f },
+     {0.50000000f, 0.02565835f, 0.05182137f, 0.18518519f },
+     {0.50000000f, 0.97434165f, 0.05182137f, 0.18518519f },
+     {0.02565835f, 0.02565835f, 0.01016105f, 0.00000000f },
+     {0.97434165f, 0.02565835f, 0.01016105f, 0.00000000f },
+     {0.97434165f, 0.97434165f, 0.01016105f, 0.00000000f },
+     {0.02565835f, 0.97434165f, 0.01016105f, 0.00000000f },
+     {0.15587640f, 0.15587640f, 0.08711833f, 0.00000000f },
+     {0.84412360f, 0.15587640f, 0.08711833f, 0.00000000f },
+     {0.84412360f, 0.84412360f, 0.08711833f, 0.00000000f },
+     {0.15587640f, 0.84412360f, 0.08711833f, 0.00000000f }
+                             };  /* ordinates & weights */
+  VECTOR3D v0,  /* vector from v[0] to v[3] */
+           v1;  /* vector from v[1] to v[2] */
+  VERTEX3D pt0, pt1; /* points on v0 and v1 */
+  IX j;
+
+  VECTOR( (vp+0), (vp+3), (&v0) );
+  VECTOR( (vp+1), (vp+2), (&v1) );
+  for( j=0; j<17; j++,p++ )
+    {
+    pt0.x = vp[0].x + v0.x * gx[j][1];
+    pt0.y = vp[0].y + v0.y * gx[j][1];
+    pt0.z = vp[0].z + v0.z * gx[j][1];
+    pt1.x = vp[1].x + v1.x * gx[j][1];
+    pt1.y = vp[1].y + v1.y * gx[j][1];
+    pt1.z = vp[1].z + v1.z * gx[j][1];
+    p->x = pt0.x + (pt1.x - pt0.x) * gx[j][0];
+    p->y = pt0.y + (pt1.y - pt0.y) * gx[j][0];
+    p->z = pt0.z + (pt1.z - pt0.z) * gx[j][0];
+    w[j] = gx[j][2];       /* incorrect for a general quadrilateral */
+    wl[j] = gx[j][3];
+    }
+
+  return 17;
+
+  }  /* end GQParallelogramNested */
+
@@ -113,6 +113,10 @@ SOURCE=..\src\test3d.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\thread.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\v3main.c
 # End Source File
 # Begin Source File